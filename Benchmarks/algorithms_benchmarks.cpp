@@ -0,0 +1,119 @@
+#include "algorithms.h"
+#include "SortedIndex.h"
+#include "Jobs.h"
+#include "random.h"
+
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch/catch.hpp"
+
+#include <algorithm>
+
+using namespace Playground;
+
+TEST_CASE("sort keys with payload", "radix_sort_vs_std_sort")
+{
+    Rng rng;
+    JobSystem jobs;
+
+    constexpr i64 N = 1 << 20;
+    Array<u32> keys;
+    Array<i32> values;
+    for (i64 i = 0; i < N; i++) {
+        keys.PushBack(u32(rng.I32UniformInRange(0, 1 << 30)));
+        values.PushBack(As<i32>(i));
+    }
+
+    struct Pair {
+        u32 key;
+        i32 value;
+    };
+
+    Array<u32> sorted_keys;
+    Array<i32> sorted_values;
+    Array<Pair> pairs;
+
+    BENCHMARK_ADVANCED("std::sort")(Catch::Benchmark::Chronometer meter)
+    {
+        pairs.Clear();
+        for (i64 i = 0; i < N; i++) {
+            pairs.PushBack({ .key = keys[i], .value = values[i] });
+        }
+        meter.measure([&] {
+            std::sort(pairs.Data(), pairs.Data() + N, [](Pair const& l, Pair const& r) { return l.key < r.key; });
+        });
+    };
+
+    BENCHMARK_ADVANCED("RadixSort")(Catch::Benchmark::Chronometer meter)
+    {
+        sorted_keys = keys;
+        sorted_values = values;
+        meter.measure([&] {
+            RadixSort(Slice<u32> { .data = sorted_keys.Data(), .num = N }, Slice<i32> { .data = sorted_values.Data(), .num = N });
+        });
+    };
+
+    BENCHMARK_ADVANCED("RadixSort parallel")(Catch::Benchmark::Chronometer meter)
+    {
+        sorted_keys = keys;
+        sorted_values = values;
+        meter.measure([&] {
+            RadixSort(Slice<u32> { .data = sorted_keys.Data(), .num = N }, Slice<i32> { .data = sorted_values.Data(), .num = N }, jobs);
+        });
+    };
+}
+
+// 4KB of keys fit in L1, 128KB in L2, 4MB in the last level, 64MB only in DRAM
+TEST_CASE("search sorted keys", "lower_bound_variants")
+{
+    Rng rng;
+
+    constexpr i64 LOOKUPS = 100000;
+    for (i64 num : { i64(1) << 10, i64(1) << 15, i64(1) << 20, i64(1) << 24 }) {
+        Array<i32> keys;
+        keys.ResizeUninitialised(num);
+        for (i64 i = 0; i < num; i++) {
+            keys[i] = rng.I32UniformInRange(0, 1 << 30);
+        }
+        std::sort(keys.Data(), keys.Data() + num);
+
+        Array<i32> values;
+        for (i64 i = 0; i < LOOKUPS; i++) {
+            values.PushBack(rng.I32UniformInRange(0, 1 << 30));
+        }
+
+        SortedIndex<i32> index;
+        index.Build({ .data = keys.Data(), .num = num });
+
+        // summing the results keeps the lookups from being optimised out
+        auto run = [&](auto&& search) {
+            i64 sum = 0;
+            for (i64 i = 0; i < LOOKUPS; i++) {
+                sum += search(values[i]);
+            }
+            return sum;
+        };
+
+        DYNAMIC_SECTION(num << " keys")
+        {
+            BENCHMARK("LowerBound")
+            {
+                return run([&](i32 value) { return LowerBound(keys.Data(), num, value); });
+            };
+
+            BENCHMARK("LowerBoundBranchless")
+            {
+                return run([&](i32 value) { return LowerBoundBranchless(keys.Data(), num, value); });
+            };
+
+            BENCHMARK("LowerBoundSimd")
+            {
+                return run([&](i32 value) { return LowerBoundSimd(keys.Data(), num, value); });
+            };
+
+            BENCHMARK("SortedIndex")
+            {
+                return run([&](i32 value) { return index.LowerBound(value); });
+            };
+        }
+    }
+}
@@ -0,0 +1,434 @@
+#include "DynamicBvh.h"
+#include "WideBvh.h"
+#include "LinearBvh.h"
+#include "Jobs.h"
+#include "random.h"
+
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch/catch.hpp"
+
+using namespace Playground;
+
+namespace {
+
+void AddRandomBoxes(DynamicBvh& bvh, Rng& rng, i32 num, f32 extent)
+{
+    for (i32 i = 0; i < num; i++) {
+        Vector3 p { rng.F32UniformInRange(-extent, extent), rng.F32UniformInRange(-extent, extent), rng.F32UniformInRange(-extent, extent) };
+        bvh.Add(Aabb3D::From(p, p + Vector3 { rng.F32UniformInRange(0.5f, 2.f) }));
+    }
+}
+
+}
+
+TEST_CASE("coherent ray casts", "dynamic_bvh_single_vs_batched")
+{
+    Rng rng;
+    DynamicBvh bvh;
+    AddRandomBoxes(bvh, rng, 10000, 100.f);
+
+    // a 64x64 pinhole camera grid
+    Array<Vector3> origins;
+    Array<Vector3> directions;
+    for (i32 y = 0; y < 64; y++) {
+        for (i32 x = 0; x < 64; x++) {
+            origins.PushBack({ 0, 0, -150.f });
+            directions.PushBack(Vector3 { (x - 32) / 64.f, (y - 32) / 64.f, 1.f }.normalized());
+        }
+    }
+    i64 N = origins.Size();
+
+    Array<Optional<DynamicBvh::RayHit>> hits;
+    hits.Resize(N);
+
+    BENCHMARK("Single")
+    {
+        for (i64 i = 0; i < N; i++) {
+            hits[i] = bvh.RayCastClosest(origins[i], directions[i], 300.f);
+        }
+        return bool(hits[N - 1]);
+    };
+
+    BENCHMARK("Batched")
+    {
+        bvh.RayCastClosest({ .data = origins.Data(), .num = N }, { .data = directions.Data(), .num = N }, 300.f, { .data = hits.Data(), .num = N });
+        return bool(hits[N - 1]);
+    };
+}
+
+TEST_CASE("coherent point queries", "dynamic_bvh_single_vs_batched")
+{
+    Rng rng;
+    DynamicBvh bvh;
+    AddRandomBoxes(bvh, rng, 10000, 100.f);
+
+    // clustered points, as issued by agents standing close together
+    Array<Vector3> points;
+    for (i32 cluster = 0; cluster < 64; cluster++) {
+        Vector3 center { rng.F32UniformInRange(-100, 100), rng.F32UniformInRange(-100, 100), rng.F32UniformInRange(-100, 100) };
+        for (i32 i = 0; i < 64; i++) {
+            points.PushBack(center + Vector3 { rng.F32UniformInRange(-1, 1), rng.F32UniformInRange(-1, 1), rng.F32UniformInRange(-1, 1) });
+        }
+    }
+    i64 N = points.Size();
+
+    BENCHMARK("Single")
+    {
+        i64 hits = 0;
+        Array<DynamicBvh::Handle> out;
+        for (i64 i = 0; i < N; i++) {
+            out.Clear();
+            bvh.FindAllIntersecting(points[i], out);
+            hits += out.Size();
+        }
+        return hits;
+    };
+
+    BENCHMARK("Batched")
+    {
+        Array<DynamicBvh::PointHit> out;
+        bvh.FindAllIntersecting({ .data = points.Data(), .num = N }, out);
+        return out.Size();
+    };
+}
+
+TEST_CASE("queries after churn", "dynamic_bvh_compacted")
+{
+    Rng rng;
+    DynamicBvh bvh;
+
+    // interleaved adds and removes scatter the nodes across the array
+    Array<DynamicBvh::Handle> handles;
+    for (i32 i = 0; i < 40000; i++) {
+        Vector3 p { rng.F32UniformInRange(-100, 100), rng.F32UniformInRange(-100, 100), rng.F32UniformInRange(-100, 100) };
+        handles.PushBack(bvh.Add(Aabb3D::From(p, p + Vector3 { rng.F32UniformInRange(0.5f, 2.f) })));
+        if (i % 2) {
+            i32 index = rng.I32UniformInRange(0, As<i32>(handles.Size()) - 1);
+            bvh.Remove(handles[index]);
+            handles.RemoveAtAndSwapWithLast(index);
+        }
+    }
+
+    Array<Vector3> points;
+    for (i32 i = 0; i < 4096; i++) {
+        points.PushBack({ rng.F32UniformInRange(-100, 100), rng.F32UniformInRange(-100, 100), rng.F32UniformInRange(-100, 100) });
+    }
+
+    auto query = [&]() {
+        i64 hits = 0;
+        for (i64 i = 0; i < points.Size(); i++) {
+            bvh.QuerySphere({ .position = points[i], .radius = 4.f }, [&](DynamicBvh::Handle) {
+                hits++;
+                return true;
+            });
+        }
+        return hits;
+    };
+
+    BENCHMARK("Scattered")
+    {
+        return query();
+    };
+
+    bvh.Compact();
+
+    BENCHMARK("Compacted")
+    {
+        return query();
+    };
+}
+
+TEST_CASE("static scene queries", "dynamic_bvh_binary_vs_wide")
+{
+    Rng rng;
+    DynamicBvh bvh;
+    AddRandomBoxes(bvh, rng, 20000, 100.f);
+
+    Bvh4 bvh4;
+    bvh4.Build(bvh);
+    Bvh8 bvh8;
+    bvh8.Build(bvh);
+
+    Array<Vector3> points;
+    Array<Vector3> directions;
+    for (i32 i = 0; i < 2048; i++) {
+        points.PushBack({ rng.F32UniformInRange(-100, 100), rng.F32UniformInRange(-100, 100), rng.F32UniformInRange(-100, 100) });
+        directions.PushBack(Vector3 { rng.F32UniformInRange(-1, 1), rng.F32UniformInRange(-1, 1), rng.F32UniformInRange(-1, 1) }.normalized());
+    }
+
+    auto query = [&](auto const& tree) {
+        i64 hits = 0;
+        for (i64 i = 0; i < points.Size(); i++) {
+            tree.QuerySphere({ .position = points[i], .radius = 3.f }, [&](DynamicBvh::Handle) {
+                hits++;
+                return true;
+            });
+            hits += bool(tree.FindClosest(points[i], 10.f));
+            hits += bool(tree.RayCastClosest(points[i], directions[i], 50.f));
+        }
+        return hits;
+    };
+
+    BENCHMARK("Binary")
+    {
+        return query(bvh);
+    };
+
+    BENCHMARK("Bvh4")
+    {
+        return query(bvh4);
+    };
+
+    BENCHMARK("Bvh8")
+    {
+        return query(bvh8);
+    };
+}
+
+TEST_CASE("level load", "dynamic_bvh_build")
+{
+    Rng rng;
+    JobSystem jobs;
+
+    constexpr i64 N = 50000;
+    Array<Aabb3D> boxes;
+    for (i64 i = 0; i < N; i++) {
+        Vector3 p { rng.F32UniformInRange(-500, 500), rng.F32UniformInRange(-500, 500), rng.F32UniformInRange(-500, 500) };
+        boxes.PushBack(Aabb3D::From(p, p + Vector3 { rng.F32UniformInRange(0.5f, 2.f) }));
+    }
+    Array<DynamicBvh::Handle> handles;
+    handles.Resize(N);
+
+    BENCHMARK("Add")
+    {
+        DynamicBvh bvh;
+        for (i64 i = 0; i < N; i++) {
+            handles[i] = bvh.Add(boxes[i]);
+        }
+        return bvh.root_;
+    };
+
+    BENCHMARK("Build")
+    {
+        DynamicBvh bvh;
+        bvh.Build({ .data = boxes.Data(), .num = N }, { .data = handles.Data(), .num = N });
+        return bvh.root_;
+    };
+
+    BENCHMARK("Build parallel")
+    {
+        DynamicBvh bvh;
+        bvh.Build({ .data = boxes.Data(), .num = N }, { .data = handles.Data(), .num = N }, &jobs);
+        return bvh.root_;
+    };
+
+    Array<u8> image;
+    {
+        DynamicBvh bvh;
+        bvh.Build({ .data = boxes.Data(), .num = N }, { .data = handles.Data(), .num = N });
+        bvh.Save(image);
+    }
+
+    BENCHMARK("Load saved image")
+    {
+        DynamicBvh bvh;
+        bvh.Load({ .data = image.Data(), .num = image.Size() });
+        return bvh.root_;
+    };
+
+    // where a mapped file would be, on a cache line
+    struct alignas(64) Line {
+        u8 bytes[64];
+    };
+    Array<Line> mapped;
+    mapped.ResizeUninitialised((image.Size() + 63) / 64);
+    memcpy(mapped.Data(), image.Data(), image.Size());
+    Slice<u8 const> mapped_image { .data = reinterpret_cast<u8 const*>(mapped.Data()), .num = image.Size() };
+
+    BENCHMARK("View saved image")
+    {
+        DynamicBvhView view;
+        view.Open(mapped_image);
+        return view.root_;
+    };
+
+    BENCHMARK("View trusted image")
+    {
+        DynamicBvhView view;
+        view.Open(mapped_image, true);
+        return view.root_;
+    };
+}
+
+TEST_CASE("moving objects", "dynamic_bvh_modify_vs_batch")
+{
+    Rng rng;
+
+    constexpr i64 N = 10000;
+    Array<Aabb3D> boxes;
+    Array<Vector3> velocities;
+    for (i64 i = 0; i < N; i++) {
+        Vector3 p { rng.F32UniformInRange(-100, 100), rng.F32UniformInRange(-100, 100), rng.F32UniformInRange(-100, 100) };
+        boxes.PushBack(Aabb3D::From(p, p + Vector3 { 1.f }));
+        velocities.PushBack({ rng.F32UniformInRange(-20, 20), rng.F32UniformInRange(-20, 20), rng.F32UniformInRange(-20, 20) });
+    }
+
+    auto make_tree = [&](Array<DynamicBvh::Handle>& handles) {
+        DynamicBvh bvh;
+        for (i64 i = 0; i < N; i++) {
+            handles.PushBack(bvh.Add(boxes[i], DynamicBvh::Velocity));
+        }
+        return bvh;
+    };
+
+    // every benchmark run is one more frame of movement
+    auto step = [&]() {
+        for (i64 i = 0; i < N; i++) {
+            Vector3 offset = velocities[i] / 60.f;
+            boxes[i] = Aabb3D::From(boxes[i].vec_min + offset, boxes[i].vec_max + offset);
+        }
+    };
+
+    Array<DynamicBvh::Handle> single_handles;
+    DynamicBvh single = make_tree(single_handles);
+
+    BENCHMARK("Modify")
+    {
+        step();
+        for (i64 i = 0; i < N; i++) {
+            single.Modify(single_handles[i], boxes[i], velocities[i]);
+        }
+        return single.root_;
+    };
+
+    Array<DynamicBvh::Handle> batch_handles;
+    DynamicBvh batch = make_tree(batch_handles);
+
+    BENCHMARK("ModifyBatch")
+    {
+        step();
+        batch.ModifyBatch({ .data = batch_handles.Data(), .num = N }, { .data = boxes.Data(), .num = N }, { .data = velocities.Data(), .num = N });
+        return batch.root_;
+    };
+}
+
+TEST_CASE("broadphase pairs", "dynamic_bvh_pairs")
+{
+    Rng rng;
+    DynamicBvh bvh;
+    AddRandomBoxes(bvh, rng, 20000, 100.f);
+
+    Array<DynamicBvh::Handle> moved;
+    for (i32 i = 0; i < 20000; i += 10) {
+        moved.PushBack(DynamicBvh::Handle { i });
+    }
+
+    JobSystem jobs;
+    Array<DynamicBvh::Pair> pairs;
+
+    BENCHMARK("per leaf queries")
+    {
+        pairs.Clear();
+        for (i32 i = 0; i < 20000; i++) {
+            bvh.QueryAabb(bvh.GetBoundingBox(DynamicBvh::Handle { i }), [&](DynamicBvh::Handle other) {
+                if (i < other.index) {
+                    pairs.PushBack({ .a = DynamicBvh::Handle { i }, .b = other });
+                }
+                return true;
+            });
+        }
+        return pairs.Size();
+    };
+
+    BENCHMARK("self traversal")
+    {
+        pairs.Clear();
+        bvh.FindOverlappingPairs(pairs);
+        return pairs.Size();
+    };
+
+    BENCHMARK("self traversal on jobs")
+    {
+        pairs.Clear();
+        bvh.FindOverlappingPairs(pairs, jobs);
+        return pairs.Size();
+    };
+
+    BENCHMARK("10% moved")
+    {
+        pairs.Clear();
+        bvh.FindOverlappingPairs({ .data = moved.Data(), .num = moved.Size() }, pairs);
+        return pairs.Size();
+    };
+}
+
+TEST_CASE("static layer", "dynamic_bvh_vs_linear_bvh")
+{
+    Rng rng;
+    JobSystem jobs;
+
+    constexpr i64 N = 100000;
+    Array<Aabb3D> boxes;
+    for (i64 i = 0; i < N; i++) {
+        Vector3 p { rng.F32UniformInRange(-500, 500), rng.F32UniformInRange(-500, 500), rng.F32UniformInRange(-500, 500) };
+        boxes.PushBack(Aabb3D::From(p, p + Vector3 { rng.F32UniformInRange(0.5f, 2.f) }));
+    }
+    Array<DynamicBvh::Handle> handles;
+    handles.Resize(N);
+
+    BENCHMARK("DynamicBvh::Build")
+    {
+        DynamicBvh bvh;
+        bvh.Build({ .data = boxes.Data(), .num = N }, { .data = handles.Data(), .num = N });
+        return bvh.root_;
+    };
+
+    BENCHMARK("LinearBvh::Build")
+    {
+        LinearBvh bvh;
+        bvh.Build({ .data = boxes.Data(), .num = N });
+        return bvh.nodes_.Size();
+    };
+
+    BENCHMARK("LinearBvh::Build parallel")
+    {
+        LinearBvh bvh;
+        bvh.Build({ .data = boxes.Data(), .num = N }, &jobs);
+        return bvh.nodes_.Size();
+    };
+
+    DynamicBvh sah;
+    sah.Build({ .data = boxes.Data(), .num = N }, { .data = handles.Data(), .num = N });
+    LinearBvh linear;
+    linear.Build({ .data = boxes.Data(), .num = N });
+
+    Array<Vector3> points;
+    Array<Vector3> directions;
+    for (i32 i = 0; i < 2048; i++) {
+        points.PushBack({ rng.F32UniformInRange(-500, 500), rng.F32UniformInRange(-500, 500), rng.F32UniformInRange(-500, 500) });
+        directions.PushBack(Vector3 { rng.F32UniformInRange(-1, 1), rng.F32UniformInRange(-1, 1), rng.F32UniformInRange(-1, 1) }.normalized());
+    }
+
+    auto query = [&](auto const& tree) {
+        i64 hits = 0;
+        for (i64 i = 0; i < points.Size(); i++) {
+            tree.QuerySphere({ .position = points[i], .radius = 10.f }, [&](DynamicBvh::Handle) {
+                hits++;
+                return true;
+            });
+            hits += bool(tree.FindClosest(points[i], 20.f));
+            hits += bool(tree.RayCastClosest(points[i], directions[i], 100.f));
+        }
+        return hits;
+    };
+
+    BENCHMARK("DynamicBvh queries")
+    {
+        return query(sah);
+    };
+
+    BENCHMARK("LinearBvh queries")
+    {
+        return query(linear);
+    };
+}
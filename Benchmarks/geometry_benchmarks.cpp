@@ -0,0 +1,224 @@
+#include "Geometry.h"
+#include "Aabb3DPacket.h"
+#include "random.h"
+
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch/catch.hpp"
+
+using namespace Playground;
+
+TEST_CASE("transform points", "geometry_batched_vs_scalar")
+{
+    constexpr i64 N = 32768;
+
+    Rng rng;
+    Transform transform {
+        .translation = { 1, 2, 3 },
+        .rotation = Quaternion::rotation(Rad { 0.7f }, Vector3 { 1, 1, 0 }.normalized()),
+        .scale = Vector3 { 2 }
+    };
+
+    Array<Vector3> points;
+    for (i64 i = 0; i < N; i++) {
+        points.PushBack({ rng.F32Uniform(), rng.F32Uniform(), rng.F32Uniform() });
+    }
+    Array<Vector3> out;
+    out.Resize(N);
+
+    BENCHMARK("Scalar")
+    {
+        for (i64 i = 0; i < N; i++) {
+            out[i] = transform.TransformVector(points[i]);
+        }
+        return out[N - 1];
+    };
+
+    BENCHMARK("Batched")
+    {
+        TransformPoints(transform, { .data = points.Data(), .num = N }, { .data = out.Data(), .num = N });
+        return out[N - 1];
+    };
+}
+
+TEST_CASE("combine transforms", "geometry_batched_vs_scalar")
+{
+    constexpr i64 N = 32768;
+
+    Rng rng;
+    Array<Transform> parents, locals;
+    for (i64 i = 0; i < N; i++) {
+        parents.PushBack({ .translation = { rng.F32Uniform(), 0, 0 }, .rotation = Quaternion::rotation(Rad { rng.F32Uniform() }, Vector3::yAxis()) });
+        locals.PushBack({ .translation = { 0, rng.F32Uniform(), 0 }, .rotation = Quaternion::rotation(Rad { rng.F32Uniform() }, Vector3::xAxis()) });
+    }
+    Array<Transform> out;
+    out.Resize(N);
+    Array<Matrix4> matrices;
+    matrices.Resize(N);
+
+    BENCHMARK("Scalar")
+    {
+        for (i64 i = 0; i < N; i++) {
+            out[i] = parents[i].Combine(locals[i]);
+        }
+        return out[N - 1].translation;
+    };
+
+    BENCHMARK("Batched")
+    {
+        CombineTransforms({ .data = parents.Data(), .num = N }, { .data = locals.Data(), .num = N }, { .data = out.Data(), .num = N });
+        return out[N - 1].translation;
+    };
+
+    BENCHMARK("Scalar to matrix")
+    {
+        for (i64 i = 0; i < N; i++) {
+            matrices[i] = parents[i].ToMatrix();
+        }
+        return matrices[N - 1][3];
+    };
+
+    BENCHMARK("Batched to matrix")
+    {
+        TransformsToMatrices({ .data = parents.Data(), .num = N }, { .data = matrices.Data(), .num = N });
+        return matrices[N - 1][3];
+    };
+}
+
+TEST_CASE("frustum culling", "geometry_batched_vs_scalar")
+{
+    constexpr i64 N = 100000;
+
+    Rng rng;
+    Array<Obb3D> boxes;
+    for (i64 i = 0; i < N; i++) {
+        Obb3D box = Obb3D::UnitCube();
+        box.pos = { rng.F32UniformInRange(-500, 500), rng.F32UniformInRange(-500, 500), rng.F32UniformInRange(-500, 500) };
+        boxes.PushBack(box);
+    }
+    Matrix4 transform = Matrix4::rotationY(Rad { 0.3f });
+    Array<Aabb3D> bounds;
+    bounds.Resize(N);
+
+    ViewFrustum frustum = ViewFrustum::FromMatrix(PerspectiveFovLh(16.f / 9.f, 1.f, 0.1f, 1000.f) * LookAtLh({ 0, 0, 1 }, {}, { 0, 1, 0 }));
+    Bitarray visible;
+    visible.Resize(N);
+
+    BENCHMARK("Scalar obb bounds")
+    {
+        for (i64 i = 0; i < N; i++) {
+            bounds[i] = boxes[i].GetAabb(transform);
+        }
+        return bounds[N - 1].vec_min;
+    };
+
+    BENCHMARK("Batched obb bounds")
+    {
+        ComputeAabbs({ .data = boxes.Data(), .num = N }, transform, { .data = bounds.Data(), .num = N });
+        return bounds[N - 1].vec_min;
+    };
+
+    BENCHMARK("Scalar cull")
+    {
+        for (i64 i = 0; i < N; i++) {
+            visible.SetBit(i, frustum.Intersects(bounds[i]));
+        }
+        return visible.GetBit(N - 1);
+    };
+
+    BENCHMARK("Batched cull")
+    {
+        CullAabbs(frustum, { .data = bounds.Data(), .num = N }, visible);
+        return visible.GetBit(N - 1);
+    };
+}
+
+TEST_CASE("aabb overlap and distance", "geometry_batched_vs_scalar")
+{
+    constexpr i64 N = 8192;
+
+    Rng rng;
+    Array<Aabb3D> boxes;
+    for (i64 i = 0; i < N; i++) {
+        Vector3 p { rng.F32UniformInRange(-50, 50), rng.F32UniformInRange(-50, 50), rng.F32UniformInRange(-50, 50) };
+        boxes.PushBack(Aabb3D::From(p, p + Vector3 { rng.F32UniformInRange(0.1f, 5) }));
+    }
+
+    Array<Aabb3Dx4> packets4;
+    for (i64 i = 0; i < N; i += 4) {
+        packets4.PushBack(Aabb3Dx4::Load(boxes.Data() + i, 4));
+    }
+    Array<Aabb3Dx8> packets8;
+    for (i64 i = 0; i < N; i += 8) {
+        packets8.PushBack(Aabb3Dx8::Load(boxes.Data() + i, 8));
+    }
+
+    Aabb3D query = Aabb3D::From(Vector3 { -10 }, Vector3 { 10 });
+    Vector3 point { 1, 2, 3 };
+
+    BENCHMARK("Scalar overlap")
+    {
+        i64 overlapping = 0;
+        for (i64 i = 0; i < N; i++) {
+            overlapping += boxes[i].Overlaps(query);
+        }
+        return overlapping;
+    };
+
+    BENCHMARK("x4 overlap")
+    {
+        i64 overlapping = 0;
+        for (i64 i = 0; i < packets4.Size(); i++) {
+            overlapping += std::popcount(As<u32>(MoveMask(packets4[i].Overlaps(query))));
+        }
+        return overlapping;
+    };
+
+    BENCHMARK("x8 overlap")
+    {
+        i64 overlapping = 0;
+        for (i64 i = 0; i < packets8.Size(); i++) {
+            overlapping += std::popcount(As<u32>(MoveMask(packets8[i].Overlaps(query))));
+        }
+        return overlapping;
+    };
+
+    BENCHMARK("Scalar distance")
+    {
+        f32 closest = Math::Constants<f32>::inf();
+        for (i64 i = 0; i < N; i++) {
+            closest = Min(closest, boxes[i].Distance(point));
+        }
+        return closest;
+    };
+
+    BENCHMARK("x8 distance")
+    {
+        f32x8 closest = f32x8::Splat(Math::Constants<f32>::inf());
+        for (i64 i = 0; i < packets8.Size(); i++) {
+            closest = Min(closest, packets8[i].DistanceSquared(point));
+        }
+        f32 result = closest.Get(0);
+        for (i32 lane = 1; lane < 8; lane++) {
+            result = Min(result, closest.Get(lane));
+        }
+        return sqrtf(result);
+    };
+
+    BENCHMARK("Scalar area")
+    {
+        f32 total = 0.f;
+        for (i64 i = 0; i < N; i++) {
+            total += boxes[i].Area();
+        }
+        return total;
+    };
+
+    BENCHMARK("x8 area")
+    {
+        f32x8 total = f32x8::Splat(0.f);
+        for (i64 i = 0; i < packets8.Size(); i++) {
+            total = total + packets8[i].Area();
+        }
+        return total.Get(0);
+    };
+}
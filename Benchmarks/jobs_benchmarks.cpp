@@ -0,0 +1,33 @@
+#include "Jobs.h"
+
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch/catch.hpp"
+
+using namespace Playground;
+
+// jobs that do next to nothing, what's measured is pushing, popping and retiring them
+TEST_CASE("tiny jobs", "job_overhead")
+{
+    JobSystem jobs;
+
+    constexpr i64 N = 1 << 16;
+    std::atomic<i64> sum = 0;
+
+    BENCHMARK("ParallelFor grain 1")
+    {
+        jobs.ParallelFor(N, 1, [&sum](i64 begin, i64 end) {
+            sum.fetch_add(end - begin, std::memory_order_relaxed);
+        });
+        return sum.load();
+    };
+
+    BENCHMARK("nested ParallelFor")
+    {
+        jobs.ParallelFor(256, 1, [&](i64, i64) {
+            jobs.ParallelFor(256, 1, [&sum](i64 begin, i64 end) {
+                sum.fetch_add(end - begin, std::memory_order_relaxed);
+            });
+        });
+        return sum.load();
+    };
+}
@@ -0,0 +1,100 @@
+#include "SpatialHashGrid.h"
+#include "DynamicBvh.h"
+#include "random.h"
+
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch/catch.hpp"
+
+#include <string>
+
+using namespace Playground;
+
+// one frame of a crowd: a share of the objects moves, then every tenth object looks for neighbours
+// the grid is rebuilt from all objects, the tree only reinserts the moved ones
+TEST_CASE("crowd frames", "spatial_hash_grid_vs_dynamic_bvh")
+{
+    for (i32 num : { 1000, 10000, 50000 }) {
+        for (i32 moving_percent : { 10, 100 }) {
+            Rng rng;
+
+            // about one object per 8 units cubed whatever the count
+            f32 extent = Math::pow(f32(num) * 8.f, 1.f / 3.f) * 0.5f;
+            Array<Aabb3D> boxes;
+            Array<Vector3> velocities;
+            for (i32 i = 0; i < num; i++) {
+                Vector3 p { rng.F32UniformInRange(-extent, extent), rng.F32UniformInRange(-extent, extent), rng.F32UniformInRange(-extent, extent) };
+                boxes.PushBack(Aabb3D::From(p, p + Vector3 { 1.f }));
+                velocities.PushBack({ rng.F32UniformInRange(-5, 5), rng.F32UniformInRange(-5, 5), rng.F32UniformInRange(-5, 5) });
+            }
+
+            Array<i32> moving;
+            for (i32 i = 0; i < num; i++) {
+                if (rng.I32UniformInRange(0, 100) < moving_percent) {
+                    moving.PushBack(i);
+                }
+            }
+
+            auto step = [&]() {
+                for (i32 i : moving) {
+                    Vector3 offset = velocities[i] / 60.f;
+                    boxes[i] = Aabb3D::From(boxes[i].vec_min + offset, boxes[i].vec_max + offset);
+                }
+            };
+
+            std::string suffix = " " + std::to_string(num) + " objects " + std::to_string(moving_percent) + "% moving";
+
+            SpatialHashGrid grid;
+            // about the query diameter, a query probes 3x3x3 cells
+            grid.cell_size_ = 4.f;
+            grid.Rebuild({ .data = boxes.Data(), .num = boxes.Size() });
+
+            BENCHMARK("SpatialHashGrid" + suffix)
+            {
+                step();
+                grid.Rebuild({ .data = boxes.Data(), .num = boxes.Size() });
+
+                i64 neighbours = 0;
+                for (i32 i = 0; i < num; i += 10) {
+                    grid.QuerySphere({ .position = boxes[i].Center(), .radius = 3.f }, [&](SpatialHashGrid::Handle) {
+                        neighbours++;
+                        return true;
+                    });
+                }
+                return neighbours;
+            };
+
+            DynamicBvh bvh;
+            Array<DynamicBvh::Handle> handles;
+            handles.Resize(num);
+            bvh.Build({ .data = boxes.Data(), .num = boxes.Size() }, { .data = handles.Data(), .num = handles.Size() }, nullptr, DynamicBvh::Velocity);
+
+            Array<DynamicBvh::Handle> moved_handles;
+            Array<Aabb3D> moved_boxes;
+            Array<Vector3> moved_velocities;
+
+            BENCHMARK("DynamicBvh" + suffix)
+            {
+                step();
+                moved_handles.Clear();
+                moved_boxes.Clear();
+                moved_velocities.Clear();
+                for (i32 i : moving) {
+                    moved_handles.PushBack(handles[i]);
+                    moved_boxes.PushBack(boxes[i]);
+                    moved_velocities.PushBack(velocities[i]);
+                }
+                i64 moved = moved_handles.Size();
+                bvh.ModifyBatch({ .data = moved_handles.Data(), .num = moved }, { .data = moved_boxes.Data(), .num = moved }, { .data = moved_velocities.Data(), .num = moved });
+
+                i64 neighbours = 0;
+                for (i32 i = 0; i < num; i += 10) {
+                    bvh.QuerySphere({ .position = boxes[i].Center(), .radius = 3.f }, [&](DynamicBvh::Handle) {
+                        neighbours++;
+                        return true;
+                    });
+                }
+                return neighbours;
+            };
+        }
+    }
+}
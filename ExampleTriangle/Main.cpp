@@ -1,7 +1,9 @@
 #include "Pch.h"
 #include "Engine.h"
 #include "Gfx.h"
+#include "GfxTask.h"
 #include "ImGuiBackend.h"
+#include "Jobs.h"
 #include "Os.h"
 
 #define ImTextureID Playground::Gfx::DescriptorHandle
@@ -91,106 +93,143 @@ struct TriangleShader : public Gfx::Shader {
     }
 };
 
+const i32 MAX_FRAMES_IN_FLIGHT = 3;
+
+struct Vertex {
+    Vector2 position;
+    Color4ub colour;
+};
+
+// what the simulation of a frame hands over to its rendering
+struct TriangleFrame {
+    Vertex vertices[3];
+};
+
+// the part of a frame that doesn't touch the device or ImGui, it runs on a worker while the main thread
+// encodes and presents the frame before
+Task<TriangleFrame> Simulate(JobSystem& jobs)
+{
+    co_await SwitchTo(jobs);
+
+    TriangleFrame frame;
+    frame.vertices[0] = { .position = { -0.5f, -0.5f }, .colour = { 255, 0, 0, 0 } };
+    frame.vertices[1] = { .position = { 0.5f, -0.5f }, .colour = { 0, 255, 0, 0 } };
+    frame.vertices[2] = { .position = { 0.f, 0.5f }, .colour = { 0, 0, 255, 0 } };
+    co_return frame;
+}
+
+// runs on the main thread's TaskLoop, every co_await lets it help the workers, it only blocks on a fence when there's nothing to help with
+Task<void> FrameLoop(Device& device, Swapchain* swapchain, ImGuiRenderer& imgui_renderer, TriangleShader& shader, JobSystem& jobs)
+{
+    Os::Window* window = swapchain->window_;
+
+    Array<Gfx::Waitable> frame_waitables;
+
+    Task<TriangleFrame> next_frame = Simulate(jobs);
+    next_frame.Start();
+
+    while (window->PumpMessages()) {
+        if (frame_waitables.Size() >= MAX_FRAMES_IN_FLIGHT) {
+            co_await frame_waitables.RemoveAt(0);
+        }
+
+        TriangleFrame triangle = co_await next_frame;
+        // the next frame is simulated while this one is encoded and presented
+        next_frame = Simulate(jobs);
+        next_frame.Start();
+
+        Engine::FrameBegin();
+
+        {
+            ImGui::Text("Hello world!");
+        }
+
+        RenderTargetDesc backbuffer_rt = swapchain->GetCurrentBackbufferAsRenderTarget();
+        Gfx::Pass* clear_pass = device.graph_.AddSubsequentPass(Gfx::PassAttachments {}
+                                                                    .Attach({ .resource = *backbuffer_rt.resource->resource_ }, D3D12_RESOURCE_STATE_RENDER_TARGET));
+
+        Gfx::Pass* present_pass = device.graph_.AddSubsequentPass(Gfx::PassAttachments {}
+                                                                      .Attach({ .resource = *backbuffer_rt.resource->resource_ }, D3D12_RESOURCE_STATE_PRESENT));
+
+        Encoder encoder = device.CreateEncoder();
+        f32 clear_color[4] = { 0.2f, 0.1f, 0.2f, 0.f };
+        encoder.SetPass(clear_pass);
+        encoder.GetCmdList()->ClearRenderTargetView(device._GetSrcHandle(backbuffer_rt.rtv), clear_color, 0, nullptr);
+
+        {
+            Resource vertex_buffer = device.CreateBuffer(D3D12_HEAP_TYPE_UPLOAD, 3 * SizeOf<Vertex>(), DXGI_FORMAT_UNKNOWN, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ);
+            Vertex* vtx_dst = nullptr;
+            verify_hr(vertex_buffer.resource_->Map(0, nullptr, reinterpret_cast<void**>(&vtx_dst)));
+            memcpy(vtx_dst, triangle.vertices, sizeof(triangle.vertices));
+            vertex_buffer.resource_->Unmap(0, nullptr);
+
+            unsigned int stride = sizeof(Vertex);
+            unsigned int offset = 0;
+            D3D12_VERTEX_BUFFER_VIEW vbv;
+            memset(&vbv, 0, sizeof(D3D12_VERTEX_BUFFER_VIEW));
+            vbv.BufferLocation = vertex_buffer.resource_->GetGPUVirtualAddress();
+            vbv.SizeInBytes = 3 * stride;
+            vbv.StrideInBytes = stride;
+            encoder.GetCmdList()->IASetVertexBuffers(0, 1, &vbv);
+            encoder.GetCmdList()->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+            D3D12_CPU_DESCRIPTOR_HANDLE rtv_handle = device._GetSrcHandle(backbuffer_rt.rtv);
+            encoder.GetCmdList()->OMSetRenderTargets(1, &rtv_handle, false, nullptr);
+            D3D12_VIEWPORT vp;
+            memset(&vp, 0, sizeof(D3D12_VIEWPORT));
+            vp.Width = As<f32>(window->resolution_.x());
+            vp.Height = As<f32>(window->resolution_.y());
+            vp.MinDepth = 0.0f;
+            vp.MaxDepth = 1.0f;
+            vp.TopLeftX = vp.TopLeftY = 0.0f;
+            encoder.GetCmdList()->RSSetViewports(1, &vp);
+            const D3D12_RECT r = { 0, 0, window->resolution_.x(), window->resolution_.y() };
+            encoder.GetCmdList()->RSSetScissorRects(1, &r);
+            encoder.GetCmdList()->SetPipelineState(shader.pipeline_->GetPSO());
+            encoder.GetCmdList()->DrawInstanced(3, 1, 0, 0);
+
+            device.ReleaseWhenCurrentFrameIsDone(std::move(vertex_buffer));
+        }
+
+        ImGui::Render();
+        imgui_renderer.RenderDrawData(ImGui::GetDrawData(), &encoder, backbuffer_rt);
+
+        encoder.SetPass(present_pass);
+        encoder.Submit();
+
+        verify_hr(swapchain->swapchain_->Present(1, 0));
+        device.AdvanceFence();
+        device.RecycleResources();
+
+        Gfx::Waitable frame_end_fence = device.GetWaitable();
+        frame_waitables.PushBack(frame_end_fence);
+    }
+
+    // a started task has to finish before it's destroyed
+    co_await next_frame;
+    co_await device.GetWaitable();
+}
+
 int main(int argc, char** argv)
 {
     Engine::Start();
     {
+        JobSystem jobs;
+        TaskLoop loop { &jobs };
+
         Device device;
 
         const i32 BACKBUFFERS_NUM = 3;
-        const i32 MAX_FRAMES_IN_FLIGHT = 3;
 
         Swapchain* swapchain = CreateWindowAndSwapchain(&device, { 1920, 1080 }, BACKBUFFERS_NUM);
-        Os::Window* window = swapchain->window_;
 
         ImGuiRenderer imgui_renderer;
         imgui_renderer.Init(&device);
 
-        Array<Gfx::Waitable> frame_waitables;
-
         Box<TriangleShader> shader = MakeBox<TriangleShader>();
         shader->Init(&device);
 
-        while (window->PumpMessages()) {
-            if (frame_waitables.Size() >= MAX_FRAMES_IN_FLIGHT) {
-                frame_waitables.RemoveAt(0).Wait();
-            }
-
-            Engine::FrameBegin();
-
-            {
-                ImGui::Text("Hello world!");
-            }
-
-            RenderTargetDesc backbuffer_rt = swapchain->GetCurrentBackbufferAsRenderTarget();
-            Gfx::Pass* clear_pass = device.graph_.AddSubsequentPass(Gfx::PassAttachments {}
-                                                                        .Attach({ .resource = *backbuffer_rt.resource->resource_ }, D3D12_RESOURCE_STATE_RENDER_TARGET));
-
-            Gfx::Pass* present_pass = device.graph_.AddSubsequentPass(Gfx::PassAttachments {}
-                                                                          .Attach({ .resource = *backbuffer_rt.resource->resource_ }, D3D12_RESOURCE_STATE_PRESENT));
-
-            Encoder encoder = device.CreateEncoder();
-            f32 clear_color[4] = { 0.2f, 0.1f, 0.2f, 0.f };
-            encoder.SetPass(clear_pass);
-            encoder.GetCmdList()->ClearRenderTargetView(device._GetSrcHandle(backbuffer_rt.rtv), clear_color, 0, nullptr);
-
-            {
-                struct Vertex {
-                    Vector2 position;
-                    Color4ub colour;
-                };
-
-                Resource vertex_buffer = device.CreateBuffer(D3D12_HEAP_TYPE_UPLOAD, 3 * SizeOf<Vertex>(), DXGI_FORMAT_UNKNOWN, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ);
-                Vertex* vtx_dst = nullptr;
-                verify_hr(vertex_buffer.resource_->Map(0, nullptr, reinterpret_cast<void**>(&vtx_dst)));
-                vtx_dst[0] = { .position = { -0.5f, -0.5f }, .colour = { 255, 0, 0, 0 } };
-                vtx_dst[1] = { .position = { 0.5f, -0.5f }, .colour = { 0, 255, 0, 0 } };
-                vtx_dst[2] = { .position = { 0.f, 0.5f }, .colour = { 0, 0, 255, 0 } };
-                vertex_buffer.resource_->Unmap(0, nullptr);
-
-                unsigned int stride = sizeof(Vertex);
-                unsigned int offset = 0;
-                D3D12_VERTEX_BUFFER_VIEW vbv;
-                memset(&vbv, 0, sizeof(D3D12_VERTEX_BUFFER_VIEW));
-                vbv.BufferLocation = vertex_buffer.resource_->GetGPUVirtualAddress();
-                vbv.SizeInBytes = 3 * stride;
-                vbv.StrideInBytes = stride;
-                encoder.GetCmdList()->IASetVertexBuffers(0, 1, &vbv);
-                encoder.GetCmdList()->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
-                D3D12_CPU_DESCRIPTOR_HANDLE rtv_handle = device._GetSrcHandle(backbuffer_rt.rtv);
-                encoder.GetCmdList()->OMSetRenderTargets(1, &rtv_handle, false, nullptr);
-                D3D12_VIEWPORT vp;
-                memset(&vp, 0, sizeof(D3D12_VIEWPORT));
-                vp.Width = As<f32>(window->resolution_.x());
-                vp.Height = As<f32>(window->resolution_.y());
-                vp.MinDepth = 0.0f;
-                vp.MaxDepth = 1.0f;
-                vp.TopLeftX = vp.TopLeftY = 0.0f;
-                encoder.GetCmdList()->RSSetViewports(1, &vp);
-                const D3D12_RECT r = { 0, 0, window->resolution_.x(), window->resolution_.y() };
-                encoder.GetCmdList()->RSSetScissorRects(1, &r);
-                encoder.GetCmdList()->SetPipelineState(shader->pipeline_->GetPSO());
-                encoder.GetCmdList()->DrawInstanced(3, 1, 0, 0);
-
-                device.ReleaseWhenCurrentFrameIsDone(std::move(vertex_buffer));
-            }
-
-            ImGui::Render();
-            imgui_renderer.RenderDrawData(ImGui::GetDrawData(), &encoder, backbuffer_rt);
-
-            encoder.SetPass(present_pass);
-            encoder.Submit();
-
-            verify_hr(swapchain->swapchain_->Present(1, 0));
-            device.AdvanceFence();
-            device.RecycleResources();
-
-            Gfx::Waitable frame_end_fence = device.GetWaitable();
-            frame_waitables.PushBack(frame_end_fence);
-        }
-
-        device.GetWaitable().Wait();
+        loop.Run(FrameLoop(device, swapchain, imgui_renderer, *shader, jobs));
     }
     Engine::Shutdown();
-}
\ No newline at end of file
+}
@@ -1,5 +1,12 @@
 #include "Pch.h"
 #include "DynamicBvh.h"
+#include "Simd.h"
+#include "Heap.h"
+#include "Jobs.h"
+#include "bitarray.h"
+
+#include <algorithm>
+#include <bit>
 
 namespace Playground {
 	using Handle = DynamicBvh::Handle;
@@ -37,16 +44,38 @@ namespace Playground {
         return children[0];
     }
 
+    Aabb3D& DynamicBvh::_Bounds(i32 index) {
+        i32 parent = nodes_[index].parent;
+        if(parent == NULL_NODE) {
+            return root_bounds_;
+        }
+        return nodes_[parent].child_bounds[nodes_[parent].GetChildIndex(index)];
+    }
+
+    Aabb3D const& DynamicBvh::_Bounds(i32 index) const {
+        i32 parent = nodes_[index].parent;
+        if(parent == NULL_NODE) {
+            return root_bounds_;
+        }
+        return nodes_[parent].child_bounds[nodes_[parent].GetChildIndex(index)];
+    }
+
     i32 DynamicBvh::_Split(i32 index) {
         i32 split = nodes_freelist_.Allocate();
         nodes_.ExpandToIndex(split);
 
+        // the parent's slot for index now holds the split's bounds, refitted once the sibling is patched in
         nodes_[split] = {
-                .bounds = Aabb3D::Empty(),
+                .child_bounds = { _Bounds(index), Aabb3D::Empty() },
                 .parent = nodes_[index].parent,
-                .children = { index, NULL_NODE }
+                .children = { index, NULL_NODE },
+                .handle = -1
             };
 
+        i32 parent = nodes_[index].parent;
+        if (parent != NULL_NODE) {
+            nodes_[parent].children[nodes_[parent].GetChildIndex(index)] = split;
+        }
         nodes_[index].parent = split;
 
         if(root_ == index) {
@@ -59,60 +88,68 @@ namespace Playground {
     // branch & bound
     // https://box2d.org/files/ErinCatto_DynamicBVH_GDC2019.pdf
 
-    i32 DynamicBvh::_Add(Aabb3D inflated_bounds, Optional<i32> index) {
-        if(root_ == NULL_NODE) {
-            i32 node;
-            if(index) {
-                node = *index;
-            } else {
-                node = nodes_freelist_.Allocate();
-                nodes_.ExpandToIndex(node);
-            }
-
-            nodes_[node] = {
-                    .bounds = inflated_bounds,
-                    .parent = root_,
-                    .children = { NULL_NODE, NULL_NODE }
-                };
-            
-            root_ = node;
+    void DynamicBvh::_Add(i32 leaf, Aabb3D inflated_bounds) {
+        i32 parent = _Link(leaf, inflated_bounds);
+        if(parent != NULL_NODE) {
+            _Refit(parent);
+        }
+    }
 
-            return node;
-		}
+    i32 DynamicBvh::_Link(i32 leaf, Aabb3D inflated_bounds) {
+        if(root_ == NULL_NODE) {
+            nodes_[leaf].parent = NULL_NODE;
+            root_ = leaf;
+            root_bounds_ = inflated_bounds;
+            return NULL_NODE;
+        }
 
         i32 best_sibling = NULL_NODE;
         f32 best_cost = Math::Constants<f32>::inf();
         struct Frame {
             i32 index;
             f32 inherited_cost;
+            // cheapest this subtree could possibly be
+            f32 lower_bound;
+            Aabb3D bounds;
+
+            bool operator<(Frame const& other) const {
+                return lower_bound < other.lower_bound;
+            }
         };
-        // TODO: prio queue
-        Array<Frame> stack;
-        stack.PushBack({ .index = root_, .inherited_cost = 0.f });
+        // best first, the search is over once the cheapest candidate can't beat the best cost
+        Heap<Frame> queue;
+        queue.Push({ .index = root_, .inherited_cost = 0.f, .lower_bound = 0.f, .bounds = root_bounds_ });
 
         f32 leaf_cost = inflated_bounds.Area();
 
-        while(stack.Size()) {
-            auto [index, inherited_cost] = stack.PopBack();
+        while(queue.Size()) {
+            Frame frame = queue.Pop();
+
+            if(frame.lower_bound >= best_cost) {
+                break;
+            }
 
-            f32 direct_cost = nodes_[index].bounds.Union(inflated_bounds).Area();
-            f32 cost = direct_cost + inherited_cost;
+            f32 direct_cost = frame.bounds.Union(inflated_bounds).Area();
+            f32 cost = direct_cost + frame.inherited_cost;
 
             if(cost < best_cost) {
                 best_cost = cost;
-                best_sibling = index;
+                best_sibling = frame.index;
             }
 
-            if(nodes_[index].IsLeaf()) {
+            Node const& node = nodes_[frame.index];
+            if(node.IsLeaf()) {
                 continue;
             }
 
-            f32 subrees_inherited_cost = inherited_cost + nodes_[index].bounds.Area();
+            // ancestors grow by the enlargement, not by their whole area
+            f32 subrees_inherited_cost = frame.inherited_cost + direct_cost - frame.bounds.Area();
             f32 lower_bound = subrees_inherited_cost + leaf_cost;
 
             if(lower_bound < best_cost) {
-                stack.PushBack({ .index = nodes_[index].children[0], .inherited_cost = subrees_inherited_cost });
-                stack.PushBack({ .index = nodes_[index].children[1], .inherited_cost = subrees_inherited_cost });
+                for(i32 c = 0; c < 2; c++) {
+                    queue.Push({ .index = node.children[c], .inherited_cost = subrees_inherited_cost, .lower_bound = lower_bound, .bounds = node.child_bounds[c] });
+                }
             }
         }
 
@@ -120,45 +157,251 @@ namespace Playground {
 
         i32 parent = _Split(best_sibling);
 
-        i32 new_leaf;
-        if (index) {
-            new_leaf = *index;
-        } else {
-            new_leaf = nodes_freelist_.Allocate();
-            nodes_.ExpandToIndex(new_leaf);
-        }
+        nodes_[parent].children[1] = leaf;
+        nodes_[parent].child_bounds[1] = inflated_bounds;
+        nodes_[leaf].parent = parent;
+
+        return parent;
+    }
+
+    DynamicBvh::Handle DynamicBvh::Add(Aabb3D bounds, InflationPolicy inflation_policy) {
+        i32 handle = leaves_freelist_.Allocate();
+        leaves_.ExpandToIndex(handle);
+
+        i32 leaf = nodes_freelist_.Allocate();
+        nodes_.ExpandToIndex(leaf);
+
+        nodes_[leaf] = {
+            .child_bounds = { bounds, Aabb3D::Empty() },
+            .parent = NULL_NODE,
+            .children = { NULL_NODE, NULL_NODE },
+            .handle = handle
+        };
+        leaves_[handle] = { .node = leaf, .inflation_policy = inflation_policy };
+
+        _Add(leaf, _Inflate(bounds, inflation_policy));
+
+        return { handle };
+    }
 
-        nodes_[new_leaf] = {
-            .bounds = inflated_bounds,
-            .parent = parent,
-            .children = { NULL_NODE, NULL_NODE }
+    namespace {
+        constexpr i32 BUILD_BINS = 16;
+        // smaller subtrees aren't worth a job
+        constexpr i32 BUILD_PARALLEL_MIN = 4096;
+
+        struct BuildContext {
+            DynamicBvh* bvh;
+            JobSystem* jobs;
+            Slice<Aabb3D> bounds;
+            DynamicBvh::InflationPolicy inflation_policy;
+            Array<Aabb3D> inflated;
+            Array<Vector3> centers;
+            // permuted so every subtree's primitives are contiguous
+            Array<i32> primitives;
         };
 
-        nodes_[parent].children[1] = new_leaf;
+        struct BuildTask {
+            BuildContext* context;
+            i32 begin;
+            i32 end;
+            i32 node;
+            i32 parent;
+            // written by the task
+            Aabb3D bounds;
+        };
+
+        Aabb3D BuildSubtree(BuildContext& context, i32 begin, i32 end, i32 index, i32 parent);
+
+        void RunBuildTask(void* data, i64, i64) {
+            BuildTask& task = *static_cast<BuildTask*>(data);
+            task.bounds = BuildSubtree(*task.context, task.begin, task.end, task.node, task.parent);
+        }
+
+        // splits at the cheapest bin boundary along the widest axis of the centers, in the middle when that fails
+        i32 PartitionSah(BuildContext& context, i32 begin, i32 end) {
+            if (end - begin == 2) {
+                return begin + 1;
+            }
+
+            i32* primitives = context.primitives.Data();
+
+            Vector3 const* centers = context.centers.Data();
+            Aabb3D const* inflated = context.inflated.Data();
+
+            // the hot loops stick to inline vector min/max
+            Vector3 center_min { Math::Constants<f32>::inf() };
+            Vector3 center_max { -Math::Constants<f32>::inf() };
+            for (i32 i = begin; i < end; i++) {
+                Vector3 center = centers[primitives[i]];
+                center_min = Math::min(center_min, center);
+                center_max = Math::max(center_max, center);
+            }
+
+            Vector3 span = center_max - center_min;
+            i32 axis = span.x() > span.y() ? (span.x() > span.z() ? 0 : 2) : (span.y() > span.z() ? 1 : 2);
+
+            i32 mid = begin + (end - begin) / 2;
+            if (span[axis] <= 0.f) {
+                return mid;
+            }
+
+            f32 to_bin = BUILD_BINS * (1.f - 1e-5f) / span[axis];
+            f32 origin = center_min[axis];
+            auto get_bin = [=](i32 primitive) {
+                return Min(As<i32>((centers[primitive][axis] - origin) * to_bin), BUILD_BINS - 1);
+            };
+
+            i32 counts[BUILD_BINS] = {};
+            Aabb3D bins[BUILD_BINS];
+            for (Aabb3D& bin : bins) {
+                bin = Aabb3D::Empty();
+            }
+            for (i32 i = begin; i < end; i++) {
+                i32 bin = get_bin(primitives[i]);
+                counts[bin]++;
+                bins[bin].vec_min = Math::min(bins[bin].vec_min, inflated[primitives[i]].vec_min);
+                bins[bin].vec_max = Math::max(bins[bin].vec_max, inflated[primitives[i]].vec_max);
+            }
+
+            auto grow = [](Aabb3D& bounds, Aabb3D const& other) {
+                bounds.vec_min = Math::min(bounds.vec_min, other.vec_min);
+                bounds.vec_max = Math::max(bounds.vec_max, other.vec_max);
+            };
+            auto area = [](Aabb3D const& bounds) {
+                Vector3 span = bounds.vec_max - bounds.vec_min;
+                return 2.f * (span.x() * span.y() + span.y() * span.z() + span.z() * span.x());
+            };
+
+            // cost of the right side of every split, swept from the right
+            f32 right_costs[BUILD_BINS];
+            Aabb3D right = Aabb3D::Empty();
+            i32 right_count = 0;
+            for (i32 i = BUILD_BINS - 1; i > 0; i--) {
+                grow(right, bins[i]);
+                right_count += counts[i];
+                right_costs[i] = right_count ? right_count * area(right) : 0.f;
+            }
+
+            i32 best_split = -1;
+            f32 best_cost = Math::Constants<f32>::inf();
+            Aabb3D left = Aabb3D::Empty();
+            i32 left_count = 0;
+            for (i32 i = 0; i < BUILD_BINS - 1; i++) {
+                grow(left, bins[i]);
+                left_count += counts[i];
+                if (left_count == 0 || left_count == end - begin) {
+                    continue;
+                }
 
-        plgr_assert(new_leaf != NULL_NODE);
-        _Refit(nodes_[new_leaf].parent);
+                f32 cost = left_count * area(left) + right_costs[i + 1];
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_split = i;
+                }
+            }
+
+            if (best_split == -1) {
+                return mid;
+            }
 
-        return new_leaf;
+            return As<i32>(std::partition(primitives + begin, primitives + end, [&](i32 primitive) { return get_bin(primitive) <= best_split; }) - primitives);
+        }
+
+        // nodes go depth first from index, a subtree of n leaves takes 2n - 1 nodes
+        Aabb3D BuildSubtree(BuildContext& context, i32 begin, i32 end, i32 index, i32 parent) {
+            DynamicBvh& bvh = *context.bvh;
+
+            if (end - begin == 1) {
+                i32 primitive = context.primitives[begin];
+                bvh.nodes_[index] = {
+                    .child_bounds = { context.bounds[primitive], Aabb3D::Empty() },
+                    .parent = parent,
+                    .children = { DynamicBvh::NULL_NODE, DynamicBvh::NULL_NODE },
+                    .handle = primitive
+                };
+                bvh.leaves_[primitive] = { .node = index, .inflation_policy = context.inflation_policy };
+                return context.inflated[primitive];
+            }
+
+            i32 mid = PartitionSah(context, begin, end);
+            i32 left = index + 1;
+            i32 right = index + 2 * (mid - begin);
+
+            Aabb3D left_bounds;
+            Aabb3D right_bounds;
+            if (context.jobs && end - begin >= BUILD_PARALLEL_MIN) {
+                BuildTask task { .context = &context, .begin = mid, .end = end, .node = right, .parent = index };
+                JobCounter counter;
+                context.jobs->Submit({ .function = RunBuildTask, .data = &task }, counter);
+                left_bounds = BuildSubtree(context, begin, mid, left, index);
+                context.jobs->Wait(counter);
+                right_bounds = task.bounds;
+            } else {
+                left_bounds = BuildSubtree(context, begin, mid, left, index);
+                right_bounds = BuildSubtree(context, mid, end, right, index);
+            }
+
+            bvh.nodes_[index] = {
+                .child_bounds = { left_bounds, right_bounds },
+                .parent = parent,
+                .children = { left, right },
+                .handle = -1
+            };
+            return left_bounds.Union(right_bounds);
+        }
     }
 
-	Handle DynamicBvh::Add(Aabb3D bounds, InflationPolicy inflation_policy) {
-		i32 new_leaf = _Add(_Inflate(bounds, inflation_policy), NullOpt);
+    void DynamicBvh::Build(Slice<Aabb3D> bounds, Slice<Handle> out_handles, JobSystem* jobs, InflationPolicy inflation_policy) {
+        plgr_assert(root_ == NULL_NODE);
+        plgr_assert(bounds.num == out_handles.num);
 
-        leaves_.ExpandToIndex(new_leaf);
-        leaves_[new_leaf] = { .tight_bounds = bounds, .inflation_policy = inflation_policy };
+        // no live handles, the free lists can start over
+        nodes_.Clear();
+        leaves_.Clear();
+        nodes_freelist_ = {};
+        leaves_freelist_ = {};
 
-        return { new_leaf };
-	}
+        i32 num = As<i32>(bounds.num);
+        if (num == 0) {
+            return;
+        }
+
+        BuildContext context { .bvh = this, .jobs = jobs, .bounds = bounds, .inflation_policy = inflation_policy };
+        context.inflated.ResizeUninitialised(num);
+        context.centers.ResizeUninitialised(num);
+        context.primitives.ResizeUninitialised(num);
+
+        auto prepare = [&](i64 begin, i64 end) {
+            for (i64 i = begin; i < end; i++) {
+                context.inflated[i] = _Inflate(bounds[i], inflation_policy);
+                context.centers[i] = bounds[i].Center();
+                context.primitives[i] = As<i32>(i);
+                out_handles[i] = Handle { As<i32>(i) };
+            }
+        };
+        if (jobs) {
+            jobs->ParallelFor(num, BUILD_PARALLEL_MIN, prepare);
+        } else {
+            prepare(0, num);
+        }
+
+        nodes_.ResizeUninitialised(2 * num - 1);
+        leaves_.ResizeUninitialised(num);
+
+        root_bounds_ = BuildSubtree(context, 0, num, 0, NULL_NODE);
+        root_ = 0;
+        nodes_freelist_.next_ = As<i32>(nodes_.Size());
+        leaves_freelist_.next_ = num;
+    }
 
     f32 DynamicBvh::_GetMergeCost(i32 l, i32 r) const {
         plgr_assert(l != NULL_NODE && r != NULL_NODE);
-        return nodes_[l].bounds.Union(nodes_[r].bounds).Area();
+        return _Bounds(l).Union(_Bounds(r)).Area();
     }
 
     f32 DynamicBvh::_GetMergeCost(i32 i, i32 j, i32 k) const {
         plgr_assert(i != NULL_NODE && j != NULL_NODE && k != NULL_NODE);
-        return nodes_[i].bounds.Union(nodes_[j].bounds).Union(nodes_[k].bounds).Area();
+        return _Bounds(i).Union(_Bounds(j)).Union(_Bounds(k)).Area();
     }
 
     // https://hwrt.cs.utah.edu/papers/hwrt_rotations.pdf
@@ -170,7 +413,7 @@ namespace Playground {
         i32 c0 = nodes_[n].children[0];
         i32 c1 = nodes_[n].children[1];
 
-        f32 AB = nodes_[n].bounds.Area();
+        f32 AB = _Bounds(n).Area();
         f32 AC = _GetMergeCost(c0, l);
         f32 BC = _GetMergeCost(c1, l);
 
@@ -188,8 +431,8 @@ namespace Playground {
         i32 r0 = nodes_[r].children[0];
         i32 r1 = nodes_[r].children[1];
 
-        f32 AB = nodes_[l].bounds.Area();
-        f32 CD = nodes_[r].bounds.Area();
+        f32 AB = _Bounds(l).Area();
+        f32 CD = _Bounds(r).Area();
         f32 AC = _GetMergeCost(l0, r0);
         f32 AD = _GetMergeCost(l0, r1);
         f32 BC = _GetMergeCost(l1, r0);
@@ -252,10 +495,6 @@ namespace Playground {
         else if(children_l == 2 && children_r == 2) {
             _Rotate22(l, r);
         }
-
-        if(nodes_[index].parent != NULL_NODE) {
-            Rotate(nodes_[index].parent);
-        }
     }
 
     void DynamicBvh::_Rotate(i32 index0, i32 index1) {
@@ -267,68 +506,546 @@ namespace Playground {
         i32 child0 = nodes_[parent0].GetChildIndex(index0);
         i32 child1 = nodes_[parent1].GetChildIndex(index1);
 
-        // swap
+        // swap, the bounds live in the parents and move with the children
         nodes_[parent0].children[child0] = index1;
         nodes_[index1].parent = parent0;
         nodes_[parent1].children[child1] = index0;
         nodes_[index0].parent = parent1;
+        Swap(nodes_[parent0].child_bounds[child0], nodes_[parent1].child_bounds[child1]);
 
-        _Refit(parent0);
-        _Refit(parent1);
+        // rotations stay below the node being refitted, only the lower parent's leaves changed
+        // when the parents are siblings both changed and neither depends on the other
+        if (nodes_[parent1].parent == parent0) {
+            Swap(parent0, parent1);
+        }
+        _UpdateBounds(parent0);
+        _UpdateBounds(parent1);
     }
 
-    void DynamicBvh::_Refit(i32 index) {
+    void DynamicBvh::_UpdateBounds(i32 index) {
+        _Bounds(index) = nodes_[index].child_bounds[0].Union(nodes_[index].child_bounds[1]);
+    }
 
+    void DynamicBvh::_Refit(i32 index) {
+        // bounds have to be exact for the rotation costs to be meaningful, so always walk up to the root
         while (index != NULL_NODE) {
-            Aabb3D bounds = nodes_[nodes_[index].children[0]].bounds.Union(nodes_[nodes_[index].children[1]].bounds);
-            if (nodes_[index].bounds.Contains(bounds)) {
-                break;
-            }
-            nodes_[index].bounds = bounds;
-
+            _UpdateBounds(index);
             Rotate(index);
             index = nodes_[index].parent;
         }
     }
 
     void DynamicBvh::_Remove(i32 remove_index) {
+        i32 stale = _Unlink(remove_index);
+        if(stale != NULL_NODE) {
+            _Refit(stale);
+        }
+    }
+
+    i32 DynamicBvh::_Unlink(i32 remove_index) {
+        i32 stale = NULL_NODE;
         i32 parent = nodes_[remove_index].parent;
         if(parent == NULL_NODE) {
             root_ = NULL_NODE;
+            root_bounds_ = Aabb3D::Empty();
         } else {
             i32 parent_2 = nodes_[parent].parent;
-            i32 sibling = nodes_[parent].GetSibling(remove_index);
+            i32 sibling_child = 1 - nodes_[parent].GetChildIndex(remove_index);
+            i32 sibling = nodes_[parent].children[sibling_child];
+            Aabb3D sibling_bounds = nodes_[parent].child_bounds[sibling_child];
             if(parent_2 == NULL_NODE) {
                 root_ = sibling;
+                root_bounds_ = sibling_bounds;
                 nodes_[sibling].parent = NULL_NODE;
             } else {
+                i32 child = nodes_[parent_2].GetChildIndex(parent);
                 nodes_[sibling].parent = parent_2;
-                nodes_[parent_2].children[nodes_[parent_2].GetChildIndex(parent)] = sibling;
-                _Refit(parent_2);
+                nodes_[parent_2].children[child] = sibling;
+                nodes_[parent_2].child_bounds[child] = sibling_bounds;
+                stale = parent_2;
             }
             nodes_freelist_.Free(parent);
         }
+        return stale;
     }
 
     void DynamicBvh::Remove(Handle h) {
-        i32 remove_index = h.index;
+        i32 remove_index = leaves_[h.index].node;
         _Remove(remove_index);
         nodes_freelist_.Free(remove_index);
+        leaves_[h.index].node = NULL_NODE;
+        leaves_freelist_.Free(h.index);
     }
 
-    Aabb3D DynamicBvh::_Inflate(Aabb3D bounds, InflationPolicy) {
-        return bounds.Scaled(2.f);
+    Aabb3D DynamicBvh::_Inflate(Aabb3D bounds, InflationPolicy inflation_policy, Vector3 velocity) const {
+        switch(inflation_policy) {
+            case Default:
+                return bounds.Scaled(2.f);
+            case FixedMargin:
+                return Aabb3D::From(bounds.vec_min - Vector3 { inflation_margin_ }, bounds.vec_max + Vector3 { inflation_margin_ });
+            case Velocity: {
+                // only the side the leaf is moving towards is stretched
+                Vector3 displacement = velocity * velocity_prediction_time_;
+                return {
+                    .vec_min = bounds.vec_min - Vector3 { inflation_margin_ } + Math::min(displacement, Vector3 { 0.f }),
+                    .vec_max = bounds.vec_max + Vector3 { inflation_margin_ } + Math::max(displacement, Vector3 { 0.f })
+                };
+            }
+        }
+        plgr_assert(false);
+        return bounds;
     }
 
-    void DynamicBvh::Modify(Handle current, Aabb3D bounds) {
+    void DynamicBvh::Modify(Handle current, Aabb3D bounds, Vector3 velocity) {
         // remove & add while maintaining the handle alive
-        i32 index = current.index;
-        if(!nodes_[index].bounds.Contains(bounds)) {
+        i32 index = leaves_[current.index].node;
+        if(!_Bounds(index).Contains(bounds)) {
             //
             _Remove(index);
-            _Add(_Inflate(bounds, leaves_[index].inflation_policy), index);
+            _Add(index, _Inflate(bounds, leaves_[current.index].inflation_policy, velocity));
+        }
+        nodes_[index].child_bounds[0] = bounds;
+    }
+
+    void DynamicBvh::ModifyBatch(Slice<Handle> handles, Slice<Aabb3D> bounds, Slice<Vector3> velocities) {
+        plgr_assert(handles.num == bounds.num);
+        plgr_assert(velocities.num == 0 || velocities.num == handles.num);
+
+        // a leaf listed twice would be unlinked again after it's already out of the tree
+        Bitarray is_listed;
+        is_listed.Resize(leaves_.Size());
+        for(i64 i = 0; i < handles.num; i++) {
+            plgr_assert(handles[i].index >= 0 && handles[i].index < leaves_.Size() && leaves_[handles[i].index].node != NULL_NODE);
+            plgr_assert(!is_listed.GetBit(handles[i].index));
+            is_listed.SetBit(handles[i].index, true);
+        }
+
+        // nodes whose bounds may be loose or whose subtree changed, refitted in one pass at the end
+        Array<u8> dirty;
+        auto mark_dirty = [&](i32 index) {
+            // shared ancestors are walked once
+            for(; index != NULL_NODE; index = nodes_[index].parent) {
+                dirty.ExpandToIndex(index);
+                if(dirty[index]) {
+                    break;
+                }
+                dirty[index] = 1;
+            }
+        };
+
+        Array<i32> escaped;
+        for(i64 i = 0; i < handles.num; i++) {
+            i32 index = leaves_[handles[i].index].node;
+            nodes_[index].child_bounds[0] = bounds[i];
+            if(_Bounds(index).Contains(bounds[i])) {
+                continue;
+            }
+
+            escaped.PushBack(As<i32>(i));
+            // ancestors keep their old, too large bounds until the refit, that's still a valid tree
+            i32 parent = nodes_[index].parent;
+            mark_dirty(_Unlink(index));
+            if(parent != NULL_NODE) {
+                // freed, a split may reuse it
+                dirty.ExpandToIndex(parent);
+                dirty[parent] = 0;
+            }
+        }
+
+        if(escaped.Size() == 0) {
+            return;
+        }
+
+        for(i32 i : escaped) {
+            i32 index = leaves_[handles[i].index].node;
+            Aabb3D inflated = _Inflate(bounds[i], leaves_[handles[i].index].inflation_policy, velocities.num ? velocities[i] : Vector3 {});
+
+            // grow the ancestors just enough to hold the leaf, they're tightened by the refit
+            i32 parent = _Link(index, inflated);
+            for(i32 ancestor = parent; ancestor != NULL_NODE; ancestor = nodes_[ancestor].parent) {
+                Aabb3D& ancestor_bounds = _Bounds(ancestor);
+                if(ancestor_bounds.Contains(inflated)) {
+                    break;
+                }
+                ancestor_bounds = ancestor_bounds.Union(inflated);
+            }
+            mark_dirty(parent);
+        }
+
+        // bottom up, a node is refitted once all of its dirty children are
+        dirty.ExpandToIndex(nodes_.Size() - 1);
+        Array<i32> pending;
+        pending.Resize(dirty.Size());
+        Array<i32> ready;
+        for(i32 i = 0; i < dirty.Size(); i++) {
+            if(dirty[i] && nodes_[i].parent != NULL_NODE) {
+                pending[nodes_[i].parent]++;
+            }
+        }
+        for(i32 i = 0; i < dirty.Size(); i++) {
+            if(dirty[i] && pending[i] == 0) {
+                ready.PushBack(i);
+            }
+        }
+
+        while(ready.Size()) {
+            i32 index = ready.PopBack();
+            _UpdateBounds(index);
+            Rotate(index);
+
+            // rotations only rearrange nodes below index, its parent stays the same
+            i32 parent = nodes_[index].parent;
+            if(parent != NULL_NODE && --pending[parent] == 0) {
+                ready.PushBack(parent);
+            }
+        }
+    }
+
+    void DynamicBvh::Optimize(i32 budget_nodes) {
+        i32 handles_num = As<i32>(leaves_.Size());
+
+        // removed handles are skipped, each handle is looked at once per call at most
+        for(i32 visited = 0; visited < handles_num && budget_nodes > 0; visited++) {
+            if(optimize_cursor_ >= handles_num) {
+                optimize_cursor_ = 0;
+            }
+
+            i32 leaf = leaves_[optimize_cursor_++].node;
+            if(leaf == NULL_NODE || leaf == root_) {
+                continue;
+            }
+            budget_nodes--;
+
+            // the fat bounds are redone too, dropping a stretch predicted from a velocity that may be long gone
+            // a leaf still moving escapes on its next Modify and gets it back
+            _Remove(leaf);
+            _Add(leaf, _Inflate(nodes_[leaf].child_bounds[0], leaves_[nodes_[leaf].handle].inflation_policy));
+        }
+    }
+
+    f32 DynamicBvh::GetSahCost() const {
+        if(root_ == NULL_NODE) {
+            return 0.f;
+        }
+
+        f32 root_area = root_bounds_.Area();
+        if(root_area <= 0.f) {
+            return 0.f;
+        }
+
+        f32 area = root_area;
+        Array<i32> stack;
+        stack.PushBack(root_);
+        while(stack.Size()) {
+            Node const& node = nodes_[stack.PopBack()];
+            if(node.IsLeaf()) {
+                continue;
+            }
+
+            for(i32 c = 0; c < 2; c++) {
+                area += node.child_bounds[c].Area();
+                stack.PushBack(node.children[c]);
+            }
+        }
+
+        return area / root_area;
+    }
+
+    void DynamicBvh::Compact() {
+        if(root_ == NULL_NODE) {
+            nodes_.Clear();
+            nodes_freelist_ = {};
+            return;
+        }
+
+        struct Frame {
+            i32 node;
+            i32 parent;
+            i32 child;
+        };
+
+        Array<Node> compacted;
+        compacted.ResizeUninitialised(nodes_freelist_.next_ - nodes_freelist_.freelist_.Size());
+        i32 index = 0;
+
+        Array<Frame> stack;
+        stack.PushBack({ .node = root_, .parent = NULL_NODE, .child = 0 });
+
+        // preorder, the left child is pushed last so it's placed right after its parent
+        while(stack.Size()) {
+            Frame frame = stack.PopBack();
+
+            Node& node = compacted[index];
+            node = nodes_[frame.node];
+            node.parent = frame.parent;
+            if(frame.parent != NULL_NODE) {
+                compacted[frame.parent].children[frame.child] = index;
+            }
+
+            if(node.IsLeaf()) {
+                leaves_[node.handle].node = index;
+            } else {
+                stack.PushBack({ .node = node.children[1], .parent = index, .child = 1 });
+                stack.PushBack({ .node = node.children[0], .parent = index, .child = 0 });
+            }
+
+            index++;
+        }
+
+        plgr_assert(index == compacted.Size());
+        nodes_ = std::move(compacted);
+        nodes_freelist_ = { .next_ = As<i32>(nodes_.Size()) };
+        root_ = 0;
+    }
+
+    namespace {
+        // bump on any change to the header or to Node and Leaf
+        constexpr u32 IMAGE_MAGIC = 0x48564250; // "PBVH"
+        constexpr u32 IMAGE_VERSION = 1;
+        // a view reads the sections where they are, Node wants a cache line
+        constexpr i64 IMAGE_ALIGNMENT = 64;
+
+        static_assert(std::endian::native == std::endian::little, "images are written in memory order");
+        static_assert(std::is_trivially_copyable_v<DynamicBvh::Node> && std::is_trivially_copyable_v<DynamicBvh::Leaf>);
+        static_assert(alignof(DynamicBvh::Node) <= IMAGE_ALIGNMENT);
+
+        struct ImageSection {
+            i64 offset;
+            i64 num;
+        };
+
+        struct ImageHeader {
+            u32 magic;
+            u32 version;
+            u32 node_size;
+            u32 leaf_size;
+            i32 root;
+            i32 optimize_cursor;
+            f32 inflation_margin;
+            f32 velocity_prediction_time;
+            Aabb3D root_bounds;
+            i32 nodes_next;
+            i32 leaves_next;
+            ImageSection nodes;
+            ImageSection leaves;
+            ImageSection nodes_freelist;
+            ImageSection leaves_freelist;
+        };
+
+        template <typename T>
+        ImageSection AppendSection(Array<u8>& out, Array<T> const& array) {
+            ImageSection section { .offset = (out.Size() + IMAGE_ALIGNMENT - 1) / IMAGE_ALIGNMENT * IMAGE_ALIGNMENT, .num = array.Size() };
+            out.Resize(section.offset + section.num * As<i64>(sizeof(T)));
+            if (section.num) {
+                memcpy(out.Data() + section.offset, array.Data(), section.num * sizeof(T));
+            }
+            return section;
+        }
+
+        template <typename T>
+        bool SectionInImage(Slice<u8 const> image, ImageSection section) {
+            return section.offset >= 0 && section.num >= 0 && section.offset <= image.num
+                && section.num <= (image.num - section.offset) / As<i64>(sizeof(T));
+        }
+
+        // the header with the right magic, version and layout, NullOpt otherwise
+        Optional<ImageHeader> ReadHeader(Slice<u8 const> image) {
+            ImageHeader header;
+            if (image.num < As<i64>(sizeof(ImageHeader))) {
+                return NullOpt;
+            }
+            memcpy(&header, image.data, sizeof(ImageHeader));
+
+            if (header.magic != IMAGE_MAGIC || header.version != IMAGE_VERSION || header.node_size != sizeof(DynamicBvh::Node) || header.leaf_size != sizeof(DynamicBvh::Leaf)) {
+                return NullOpt;
+            }
+            return header;
+        }
+
+        template <typename T>
+        bool LoadSection(Slice<u8 const> image, ImageSection section, Array<T>& array) {
+            if (!SectionInImage<T>(image, section)) {
+                return false;
+            }
+            array.ResizeUninitialised(section.num);
+            if (section.num) {
+                memcpy(array.Data(), image.data + section.offset, section.num * sizeof(T));
+            }
+            return true;
+        }
+    }
+
+    namespace {
+        bool InRange(i32 index, i64 begin, i64 end) {
+            return begin <= index && index < end;
+        }
+
+        // every index the nodes and leaves hold points into them, one pass over each
+        // the links aren't checked to form a single tree
+        bool TreeIndicesInRange(Slice<DynamicBvh::Node const> nodes, Slice<DynamicBvh::Leaf const> leaves, i32 root) {
+            i64 nodes_num = nodes.num;
+            i64 leaves_num = leaves.num;
+
+            if (!InRange(root, DynamicBvh::NULL_NODE, nodes_num)) {
+                return false;
+            }
+
+            // free nodes keep the links they had, which were in range too
+            for (i64 i = 0; i < nodes_num; i++) {
+                DynamicBvh::Node const& node = nodes.data[i];
+                bool leaf = node.children[0] == DynamicBvh::NULL_NODE && node.children[1] == DynamicBvh::NULL_NODE;
+                bool inner = InRange(node.children[0], 0, nodes_num) && InRange(node.children[1], 0, nodes_num);
+                bool handle = leaf ? InRange(node.handle, 0, leaves_num) : InRange(node.handle, DynamicBvh::NULL_NODE, leaves_num);
+                if (!(leaf || inner) || !handle || !InRange(node.parent, DynamicBvh::NULL_NODE, nodes_num)) {
+                    return false;
+                }
+            }
+
+            for (i64 i = 0; i < leaves_num; i++) {
+                if (!InRange(leaves.data[i].node, DynamicBvh::NULL_NODE, nodes_num)) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        // TreeIndicesInRange and the free lists
+        bool IndicesInRange(DynamicBvh const& bvh, i32 root) {
+            DynamicBvhView view = bvh._View();
+            if (!TreeIndicesInRange(view.nodes_, view.leaves_, root)
+                || !InRange(bvh.nodes_freelist_.next_, 0, view.nodes_.num + 1)
+                || !InRange(bvh.leaves_freelist_.next_, 0, view.leaves_.num + 1)) {
+                return false;
+            }
+
+            for (i64 i = 0; i < bvh.nodes_freelist_.freelist_.Size(); i++) {
+                if (!InRange(bvh.nodes_freelist_.freelist_[i], 0, bvh.nodes_freelist_.next_)) {
+                    return false;
+                }
+            }
+
+            for (i64 i = 0; i < bvh.leaves_freelist_.freelist_.Size(); i++) {
+                if (!InRange(bvh.leaves_freelist_.freelist_[i], 0, bvh.leaves_freelist_.next_)) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+    }
+
+    void DynamicBvh::Save(Array<u8>& out) const {
+        plgr_assert(out.Size() == 0);
+
+        ImageHeader header {
+            .magic = IMAGE_MAGIC,
+            .version = IMAGE_VERSION,
+            .node_size = sizeof(Node),
+            .leaf_size = sizeof(Leaf),
+            .root = root_,
+            .optimize_cursor = optimize_cursor_,
+            .inflation_margin = inflation_margin_,
+            .velocity_prediction_time = velocity_prediction_time_,
+            .root_bounds = root_bounds_,
+            .nodes_next = nodes_freelist_.next_,
+            .leaves_next = leaves_freelist_.next_,
+        };
+
+        // the header is patched in once the section offsets are known
+        out.Resize(sizeof(ImageHeader));
+        header.nodes = AppendSection(out, nodes_);
+        header.leaves = AppendSection(out, leaves_);
+        header.nodes_freelist = AppendSection(out, nodes_freelist_.freelist_);
+        header.leaves_freelist = AppendSection(out, leaves_freelist_.freelist_);
+        memcpy(out.Data(), &header, sizeof(ImageHeader));
+    }
+
+    bool DynamicBvh::Load(Slice<u8 const> image) {
+        *this = DynamicBvh {};
+
+        Optional<ImageHeader> read = ReadHeader(image);
+        if (!read) {
+            return false;
+        }
+        ImageHeader header = *read;
+
+        bool loaded = LoadSection(image, header.nodes, nodes_)
+            && LoadSection(image, header.leaves, leaves_)
+            && LoadSection(image, header.nodes_freelist, nodes_freelist_.freelist_)
+            && LoadSection(image, header.leaves_freelist, leaves_freelist_.freelist_);
+        nodes_freelist_.next_ = header.nodes_next;
+        leaves_freelist_.next_ = header.leaves_next;
+        if (!loaded || !IndicesInRange(*this, header.root)) {
+            *this = DynamicBvh {};
+            return false;
+        }
+
+        root_ = header.root;
+        root_bounds_ = header.root_bounds;
+        optimize_cursor_ = header.optimize_cursor;
+        inflation_margin_ = header.inflation_margin;
+        velocity_prediction_time_ = header.velocity_prediction_time;
+        return true;
+    }
+
+    DynamicBvhView DynamicBvh::_View() const {
+        return {
+            .nodes_ = { .data = nodes_.Data(), .num = nodes_.Size() },
+            .leaves_ = { .data = leaves_.Data(), .num = leaves_.Size() },
+            .root_ = root_,
+            .root_bounds_ = root_bounds_,
+        };
+    }
+
+    namespace {
+        // section in place, NullOpt when it's out of the image or isn't aligned for T where the image is
+        template <typename T>
+        Optional<Slice<T const>> ViewSection(Slice<u8 const> image, ImageSection section) {
+            if (!SectionInImage<T>(image, section) || reinterpret_cast<uintptr_t>(image.data + section.offset) % alignof(T)) {
+                return NullOpt;
+            }
+            return Slice<T const> { .data = reinterpret_cast<T const*>(image.data + section.offset), .num = section.num };
         }
-        leaves_[index].tight_bounds = bounds;
+    }
+
+    bool DynamicBvhView::Open(Slice<u8 const> image, bool trusted) {
+        *this = DynamicBvhView {};
+
+        Optional<ImageHeader> header = ReadHeader(image);
+        if (!header) {
+            return false;
+        }
+
+        Optional<Slice<Node const>> nodes = ViewSection<Node>(image, header->nodes);
+        Optional<Slice<Leaf const>> leaves = ViewSection<Leaf>(image, header->leaves);
+        if (!nodes || !leaves) {
+            return false;
+        }
+        if (!trusted && !TreeIndicesInRange(*nodes, *leaves, header->root)) {
+            return false;
+        }
+
+        nodes_ = *nodes;
+        leaves_ = *leaves;
+        root_ = header->root;
+        root_bounds_ = header->root_bounds;
+        return true;
+    }
+
+    Aabb3D DynamicBvhView::GetBoundingBox(Handle h) const {
+        return nodes_.data[leaves_.data[h.index].node].child_bounds[0];
+    }
+
+    Optional<DynamicBvh::RayHit> DynamicBvhView::RayCastClosest(Vector3 origin, Vector3 direction, f32 max_t) const {
+        Optional<RayHit> closest;
+
+        RayCast(origin, direction, max_t, [&closest](Handle handle, f32 t) {
+            closest = RayHit { .handle = handle, .t = t };
+            return t;
+        });
+
+        return closest;
     }
 
     i32 DynamicBvh::GetDepth() const {
@@ -357,75 +1074,450 @@ namespace Playground {
     }
 
     Aabb3D DynamicBvh::GetBoundingBox(Handle h) const {
-        return leaves_[h.index].tight_bounds;
+        return nodes_[leaves_[h.index].node].child_bounds[0];
+    }
+
+    namespace {
+        struct NodeDistance {
+            i32 node;
+            f32 distance;
+
+            bool operator<(NodeDistance const& other) const {
+                return distance < other.distance;
+            }
+
+            bool operator>(NodeDistance const& other) const {
+                return distance > other.distance;
+            }
+        };
     }
 
     Optional<Handle> DynamicBvh::FindClosest(Vector3 point, f32 max_distance) const {
-        if(root_ == NULL_NODE) {
+        Array<Handle> closest;
+        FindKClosest(point, 1, max_distance, closest);
+
+        if(closest.Size() == 0) {
             return NullOpt;
         }
+        return closest[0];
+    }
 
-        i32 node = root_;
+    void DynamicBvh::FindKClosest(Vector3 point, i32 k, f32 max_distance, Array<Handle> & out) const {
+        plgr_assert(k > 0);
 
-        Array<i32> stack;
-        stack.PushBack(node);
+        if(root_ == NULL_NODE) {
+            return;
+        }
 
-        f32 best_distance = Math::Constants<f32>::inf();
-        Optional<Handle> best_option;
+        // nodes nearest first, results farthest first so the worst one can be replaced
+        Heap<NodeDistance> queue;
+        Heap<NodeDistance, std::greater<NodeDistance>> closest;
+        closest.Reserve(k + 1);
 
-        while(stack.Size()) {
-            i32 node = stack.PopBack();
+        f32 root_distance = root_bounds_.Distance(point);
+        if(root_distance <= max_distance) {
+            queue.Push({ .node = root_, .distance = root_distance });
+        }
 
-            f32 distance = nodes_[node].bounds.Distance(point);
+        while(queue.Size()) {
+            NodeDistance current = queue.Pop();
 
-            if(distance <= max_distance) {
-                if (nodes_[node].IsLeaf()) {
-                    distance = leaves_[node].tight_bounds.Distance(point);
+            // nothing left in the queue can be closer
+            if(closest.Size() == k && current.distance >= closest.Top().distance) {
+                break;
+            }
 
-                    if (distance < best_distance && distance <= max_distance) {
-                        best_distance = distance;
-                        best_option = Handle { node };
-                    }
-                    if (distance == 0.f) {
-                        return Handle { node };
-                    }
-                } else {
-                    stack.PushBack(nodes_[node].children[0]);
-                    stack.PushBack(nodes_[node].children[1]);
+            Node const& node = nodes_[current.node];
+            if(node.IsLeaf()) {
+                f32 distance = node.child_bounds[0].Distance(point);
+                if(distance > max_distance) {
+                    continue;
+                }
+
+                // results hold handles
+                if(closest.Size() < k) {
+                    closest.Push({ .node = node.handle, .distance = distance });
+                } else if(distance < closest.Top().distance) {
+                    closest.ReplaceTop({ .node = node.handle, .distance = distance });
+                }
+                continue;
+            }
+
+            for(i32 c = 0; c < 2; c++) {
+                f32 distance = node.child_bounds[c].Distance(point);
+                if(distance <= max_distance) {
+                    queue.Push({ .node = node.children[c], .distance = distance });
                 }
             }
         }
 
-        return best_option;
+        i64 first = out.Size();
+        out.ResizeUninitialised(first + closest.Size());
+        for(i64 i = out.Size() - 1; i >= first; i--) {
+            out[i] = Handle { closest.Pop().node };
+        }
     }
 
     bool DynamicBvh::FindAllIntersecting(Vector3 point, Array<Handle> & out) const {
         plgr_assert(out.Size() == 0);
 
-        if(root_ == NULL_NODE) {
+        if(root_ == NULL_NODE || !root_bounds_.Contains(point)) {
             return false;
         }
 
-        i32 node = root_;
-
         Array<i32> stack;
-        stack.PushBack(node);
+        stack.PushBack(root_);
 
         while(stack.Size()) {
-            i32 node = stack.PopBack();
+            Node const& node = nodes_[stack.PopBack()];
 
-            if (nodes_[node].bounds.Contains(point)) {
-                if (nodes_[node].IsLeaf()) {
-                    if (leaves_[node].tight_bounds.Contains(point)) {
-                        out.PushBack(Handle { node });
-                    }
-                } else {
-                    stack.PushBack(nodes_[node].children[0]);
-                    stack.PushBack(nodes_[node].children[1]);
+            if (node.IsLeaf()) {
+                if (node.child_bounds[0].Contains(point)) {
+                    out.PushBack(Handle { node.handle });
+                }
+                continue;
+            }
+
+            for (i32 c = 0; c < 2; c++) {
+                if (node.child_bounds[c].Contains(point)) {
+                    stack.PushBack(node.children[c]);
                 }
             }
         }
 
         return out.Size();
     }
-}
\ No newline at end of file
+
+    Optional<DynamicBvh::RayHit> DynamicBvh::RayCastClosest(Vector3 origin, Vector3 direction, f32 max_t) const {
+        return _View().RayCastClosest(origin, direction, max_t);
+    }
+
+    namespace {
+        constexpr i32 PACKET_WIDTH = f32xN::WIDTH;
+
+        struct PacketFrame {
+            i32 node;
+            i32 mask;
+        };
+
+        struct PointPacket {
+            f32xN x, y, z;
+
+            i32 Contains(Aabb3D const& bounds) const {
+                f32xN inside = And(And(CmpLe(f32xN::Splat(bounds.vec_min.x()), x), CmpLe(x, f32xN::Splat(bounds.vec_max.x()))),
+                                   And(CmpLe(f32xN::Splat(bounds.vec_min.y()), y), CmpLe(y, f32xN::Splat(bounds.vec_max.y()))));
+                inside = And(inside, And(CmpLe(f32xN::Splat(bounds.vec_min.z()), z), CmpLe(z, f32xN::Splat(bounds.vec_max.z()))));
+                return MoveMask(inside);
+            }
+        };
+
+        struct RayPacket {
+            f32xN origin_x, origin_y, origin_z;
+            f32xN inv_x, inv_y, inv_z;
+            // shrinks per lane as closer hits are found
+            f32xN max_t;
+
+            // same slab test as Aabb3D::RayIntersection
+            i32 Intersect(Aabb3D const& bounds, f32xN& t_enter) const {
+                f32xN tx0 = (f32xN::Splat(bounds.vec_min.x()) - origin_x) * inv_x;
+                f32xN tx1 = (f32xN::Splat(bounds.vec_max.x()) - origin_x) * inv_x;
+                f32xN ty0 = (f32xN::Splat(bounds.vec_min.y()) - origin_y) * inv_y;
+                f32xN ty1 = (f32xN::Splat(bounds.vec_max.y()) - origin_y) * inv_y;
+                f32xN tz0 = (f32xN::Splat(bounds.vec_min.z()) - origin_z) * inv_z;
+                f32xN tz1 = (f32xN::Splat(bounds.vec_max.z()) - origin_z) * inv_z;
+
+                t_enter = Max(Max(Max(Min(tx0, tx1), Min(ty0, ty1)), Min(tz0, tz1)), f32xN::Splat(0.f));
+                f32xN t_exit = Min(Min(Min(Max(tx0, tx1), Max(ty0, ty1)), Max(tz0, tz1)), max_t);
+                return MoveMask(CmpLe(t_enter, t_exit));
+            }
+        };
+
+        f32 MinLane(f32xN v, i32 mask) {
+            alignas(32) f32 lanes[PACKET_WIDTH];
+            v.Store(lanes);
+            f32 result = Math::Constants<f32>::inf();
+            for (i32 i = 0; i < PACKET_WIDTH; i++) {
+                if (mask & (1 << i)) {
+                    result = Min(result, lanes[i]);
+                }
+            }
+            return result;
+        }
+
+        // lanes past num repeat the last query and are masked out
+        void LoadLanes(Slice<Vector3> vectors, i64 begin, i64 num, f32xN& x, f32xN& y, f32xN& z) {
+            alignas(32) f32 scratch[3][PACKET_WIDTH];
+            for (i64 i = 0; i < PACKET_WIDTH; i++) {
+                Vector3 v = vectors[begin + Min(i, num - 1)];
+                scratch[0][i] = v.x();
+                scratch[1][i] = v.y();
+                scratch[2][i] = v.z();
+            }
+            x = f32xN::Load(scratch[0]);
+            y = f32xN::Load(scratch[1]);
+            z = f32xN::Load(scratch[2]);
+        }
+    }
+
+    void DynamicBvh::FindAllIntersecting(Slice<Vector3> points, Array<PointHit>& out) const {
+        if (root_ == NULL_NODE) {
+            return;
+        }
+
+        Array<PacketFrame> stack;
+
+        for (i64 begin = 0; begin < points.num; begin += PACKET_WIDTH) {
+            i64 num = Min(As<i64>(PACKET_WIDTH), points.num - begin);
+            i32 active = (1 << num) - 1;
+
+            PointPacket packet;
+            LoadLanes(points, begin, num, packet.x, packet.y, packet.z);
+
+            i32 root_mask = active & packet.Contains(root_bounds_);
+            if (root_mask) {
+                stack.PushBack({ .node = root_, .mask = root_mask });
+            }
+
+            // frames only hold lanes inside the node
+            while (stack.Size()) {
+                PacketFrame frame = stack.PopBack();
+                Node const& node = nodes_[frame.node];
+
+                if (node.IsLeaf()) {
+                    i32 mask = frame.mask & packet.Contains(node.child_bounds[0]);
+                    for (; mask; mask &= mask - 1) {
+                        i32 lane = std::countr_zero(As<u32>(mask));
+                        out.PushBack({ .query = As<i32>(begin + lane), .handle = Handle { node.handle } });
+                    }
+                    continue;
+                }
+
+                for (i32 c = 0; c < 2; c++) {
+                    i32 mask = frame.mask & packet.Contains(node.child_bounds[c]);
+                    if (mask) {
+                        stack.PushBack({ .node = node.children[c], .mask = mask });
+                    }
+                }
+            }
+        }
+    }
+
+    void DynamicBvh::RayCastClosest(Slice<Vector3> origins, Slice<Vector3> directions, f32 max_t, Slice<Optional<RayHit>> out) const {
+        plgr_assert(origins.num == directions.num && directions.num == out.num);
+
+        for (i64 i = 0; i < out.num; i++) {
+            out[i] = NullOpt;
+        }
+
+        if (root_ == NULL_NODE) {
+            return;
+        }
+
+        Array<PacketFrame> stack;
+
+        for (i64 begin = 0; begin < origins.num; begin += PACKET_WIDTH) {
+            i64 num = Min(As<i64>(PACKET_WIDTH), origins.num - begin);
+            i32 active = (1 << num) - 1;
+
+            RayPacket packet;
+            LoadLanes(origins, begin, num, packet.origin_x, packet.origin_y, packet.origin_z);
+            LoadLanes(directions, begin, num, packet.inv_x, packet.inv_y, packet.inv_z);
+            f32xN one = f32xN::Splat(1.f);
+            packet.inv_x = one / packet.inv_x;
+            packet.inv_y = one / packet.inv_y;
+            packet.inv_z = one / packet.inv_z;
+
+            alignas(32) f32 max_ts[PACKET_WIDTH];
+            for (i32 i = 0; i < PACKET_WIDTH; i++) {
+                max_ts[i] = max_t;
+            }
+            packet.max_t = f32xN::Load(max_ts);
+
+            f32xN t_enter;
+            i32 root_mask = active & packet.Intersect(root_bounds_, t_enter);
+            if (root_mask) {
+                stack.PushBack({ .node = root_, .mask = root_mask });
+            }
+
+            while (stack.Size()) {
+                PacketFrame frame = stack.PopBack();
+                Node const& node = nodes_[frame.node];
+
+                if (node.IsLeaf()) {
+                    i32 mask = frame.mask & packet.Intersect(node.child_bounds[0], t_enter);
+                    if (!mask) {
+                        continue;
+                    }
+
+                    alignas(32) f32 ts[PACKET_WIDTH];
+                    t_enter.Store(ts);
+                    for (; mask; mask &= mask - 1) {
+                        i32 lane = std::countr_zero(As<u32>(mask));
+                        out[begin + lane] = RayHit { .handle = Handle { node.handle }, .t = ts[lane] };
+                        max_ts[lane] = ts[lane];
+                    }
+                    packet.max_t = f32xN::Load(max_ts);
+                    continue;
+                }
+
+                f32xN t0, t1;
+                i32 mask0 = frame.mask & packet.Intersect(node.child_bounds[0], t0);
+                i32 mask1 = frame.mask & packet.Intersect(node.child_bounds[1], t1);
+
+                // the child the packet reaches first goes on top
+                PacketFrame first { .node = node.children[0], .mask = mask0 };
+                PacketFrame second { .node = node.children[1], .mask = mask1 };
+                if (mask0 && mask1 && MinLane(t1, mask1) < MinLane(t0, mask0)) {
+                    Swap(first, second);
+                }
+                if (second.mask) {
+                    stack.PushBack(second);
+                }
+                if (first.mask) {
+                    stack.PushBack(first);
+                }
+            }
+        }
+    }
+
+    namespace {
+        // two subtrees, or a subtree against itself when a == b
+        struct PairTask {
+            i32 a;
+            i32 b;
+        };
+
+        // the self traversal does little else, keep it inline
+        bool BoundsOverlap(Aabb3D const& l, Aabb3D const& r) {
+            return l.vec_min.x() <= r.vec_max.x() && r.vec_min.x() <= l.vec_max.x()
+                && l.vec_min.y() <= r.vec_max.y() && r.vec_min.y() <= l.vec_max.y()
+                && l.vec_min.z() <= r.vec_max.z() && r.vec_min.z() <= l.vec_max.z();
+        }
+
+        void EmitPair(Array<DynamicBvh::Pair>& out, i32 a, i32 b) {
+            out.PushBack(a < b ? DynamicBvh::Pair { .a = Handle { a }, .b = Handle { b } } : DynamicBvh::Pair { .a = Handle { b }, .b = Handle { a } });
+        }
+
+        // expands one task, the children it produces are pushed to tasks
+        void StepPairTask(DynamicBvh const& bvh, PairTask task, Array<PairTask>& tasks, Array<DynamicBvh::Pair>& out) {
+            DynamicBvh::Node const& a = bvh.nodes_[task.a];
+
+            if (task.a == task.b) {
+                if (a.IsLeaf()) {
+                    return;
+                }
+                tasks.PushBack({ .a = a.children[0], .b = a.children[0] });
+                tasks.PushBack({ .a = a.children[1], .b = a.children[1] });
+                if (BoundsOverlap(a.child_bounds[0], a.child_bounds[1])) {
+                    tasks.PushBack({ .a = a.children[0], .b = a.children[1] });
+                }
+                return;
+            }
+
+            DynamicBvh::Node const& b = bvh.nodes_[task.b];
+            if (a.IsLeaf() && b.IsLeaf()) {
+                if (BoundsOverlap(a.child_bounds[0], b.child_bounds[0])) {
+                    EmitPair(out, a.handle, b.handle);
+                }
+                return;
+            }
+
+            // descend into the larger side, the other one stays whole
+            Aabb3D const& a_bounds = bvh._Bounds(task.a);
+            Aabb3D const& b_bounds = bvh._Bounds(task.b);
+            if (b.IsLeaf() || (!a.IsLeaf() && a_bounds.Area() >= b_bounds.Area())) {
+                for (i32 c = 0; c < 2; c++) {
+                    if (BoundsOverlap(a.child_bounds[c], b_bounds)) {
+                        tasks.PushBack({ .a = a.children[c], .b = task.b });
+                    }
+                }
+            } else {
+                for (i32 c = 0; c < 2; c++) {
+                    if (BoundsOverlap(b.child_bounds[c], a_bounds)) {
+                        tasks.PushBack({ .a = task.a, .b = b.children[c] });
+                    }
+                }
+            }
+        }
+
+        void RunPairTasks(DynamicBvh const& bvh, Array<PairTask>& stack, Array<DynamicBvh::Pair>& out) {
+            while (stack.Size()) {
+                StepPairTask(bvh, stack.PopBack(), stack, out);
+            }
+        }
+    }
+
+    void DynamicBvh::FindOverlappingPairs(Array<Pair>& out) const {
+        if (root_ == NULL_NODE) {
+            return;
+        }
+
+        Array<PairTask> stack;
+        stack.PushBack({ .a = root_, .b = root_ });
+        RunPairTasks(*this, stack, out);
+    }
+
+    void DynamicBvh::FindOverlappingPairs(Array<Pair>& out, JobSystem& jobs) const {
+        if (root_ == NULL_NODE) {
+            return;
+        }
+
+        // breadth first until there are a few tasks per worker, pairs of leaves found on the way go straight to out
+        i64 target = 4 * jobs.WorkersNum();
+        Array<PairTask> tasks;
+        Array<PairTask> next;
+        tasks.PushBack({ .a = root_, .b = root_ });
+        while (tasks.Size() && tasks.Size() < target) {
+            next.Clear();
+            for (PairTask task : tasks) {
+                StepPairTask(*this, task, next, out);
+            }
+            Swap(tasks, next);
+        }
+
+        // one output per task, the order doesn't depend on the scheduling
+        Array<Array<Pair>> outputs;
+        outputs.Resize(tasks.Size());
+        jobs.ParallelFor(tasks.Size(), 1, [&](i64 begin, i64 end) {
+            Array<PairTask> stack;
+            for (i64 i = begin; i < end; i++) {
+                stack.PushBack(tasks[i]);
+                RunPairTasks(*this, stack, outputs[i]);
+            }
+        });
+
+        i64 total = out.Size();
+        for (Array<Pair>& output : outputs) {
+            total += output.Size();
+        }
+        out.Reserve(total);
+        for (Array<Pair>& output : outputs) {
+            out.Append(output.Data(), output.Size());
+        }
+    }
+
+    void DynamicBvh::FindOverlappingPairs(Slice<Handle> moved, Array<Pair>& out) const {
+        // a pair of two moved leaves is found from both sides, only the lower handle's query keeps it
+        // and a handle listed more than once is only queried for the first time
+        Bitarray is_moved;
+        is_moved.Resize(leaves_.Size());
+        Array<Handle> queried;
+        queried.Reserve(moved.num);
+        for (i64 i = 0; i < moved.num; i++) {
+            plgr_assert(moved[i].index >= 0 && moved[i].index < leaves_.Size() && leaves_[moved[i].index].node != NULL_NODE);
+            if (!is_moved.GetBit(moved[i].index)) {
+                is_moved.SetBit(moved[i].index, true);
+                queried.PushBack(moved[i]);
+            }
+        }
+
+        for (Handle h : queried) {
+            QueryAabb(GetBoundingBox(h), [&](Handle other) {
+                if (other.index != h.index && (!is_moved.GetBit(other.index) || h.index < other.index)) {
+                    EmitPair(out, h.index, other.index);
+                }
+                return true;
+            });
+        }
+    }
+}
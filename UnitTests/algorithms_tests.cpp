@@ -1,4 +1,7 @@
 #include "algorithms.h"
+#include "Jobs.h"
+#include "random.h"
+#include <algorithm>
 #include "catch/catch.hpp"
 
 using namespace Playground;
@@ -19,3 +22,140 @@ TEST_CASE("lowerbound can be found", "[lowerbound]")
     REQUIRE(LowerBound(test2, _countof(test2), 1) == 0);
     REQUIRE(LowerBound(test2, _countof(test2), 2) == 7);
 }
+
+TEMPLATE_TEST_CASE("lower and upper bound variants match std", "[lowerbound]", i32, u32, f32)
+{
+    Rng rng;
+
+    for (i32 num : { 0, 1, 2, 3, 7, 8, 9, 17, 33, 100, 1000, 4097 }) {
+        // duplicates and, for u32, keys on both sides of the sign bit
+        Array<TestType> keys;
+        for (i32 i = 0; i < num; i++) {
+            keys.PushBack(TestType(rng.I32UniformInRange(-num, num)));
+        }
+        std::sort(keys.Data(), keys.Data() + keys.Size());
+        TestType const* begin = keys.Data();
+        TestType const* end = keys.Data() + keys.Size();
+
+        for (i32 i = -num - 2; i <= num + 2; i++) {
+            TestType value = TestType(i);
+            i64 lower = std::lower_bound(begin, end, value) - begin;
+            i64 upper = std::upper_bound(begin, end, value) - begin;
+            REQUIRE(LowerBound(begin, num, value) == lower);
+            REQUIRE(LowerBoundBranchless(begin, num, value) == lower);
+            REQUIRE(LowerBoundSimd(begin, num, value) == lower);
+            REQUIRE(UpperBound(begin, num, value) == upper);
+            REQUIRE(UpperBoundBranchless(begin, num, value) == upper);
+        }
+    }
+}
+
+TEMPLATE_TEST_CASE("radix sort matches a stable sort", "[radix_sort]", u32, u64)
+{
+    Rng rng;
+    JobSystem jobs(3);
+
+    for (i32 num : { 0, 1, 2, 1000, 100000 }) {
+        // few distinct keys so the stability shows, some with only high bits set
+        Array<TestType> keys;
+        Array<i32> values;
+        for (i32 i = 0; i < num; i++) {
+            TestType key = TestType(rng.I32UniformInRange(0, 300));
+            if (i % 3 == 0) {
+                key <<= sizeof(TestType) * 8 - 9;
+            }
+            keys.PushBack(key);
+            values.PushBack(i);
+        }
+
+        struct Pair {
+            TestType key;
+            i32 value;
+        };
+        Array<Pair> expected;
+        for (i32 i = 0; i < num; i++) {
+            expected.PushBack({ .key = keys[i], .value = values[i] });
+        }
+        std::stable_sort(expected.Data(), expected.Data() + expected.Size(), [](Pair const& l, Pair const& r) { return l.key < r.key; });
+
+        auto require_sorted = [&](Array<TestType>& sorted_keys, Array<i32>& sorted_values) {
+            for (i32 i = 0; i < num; i++) {
+                REQUIRE(sorted_keys[i] == expected[i].key);
+                REQUIRE(sorted_values[i] == expected[i].value);
+            }
+        };
+
+        Array<TestType> single_keys = keys;
+        Array<i32> single_values = values;
+        RadixSort(Slice<TestType> { .data = single_keys.Data(), .num = num }, Slice<i32> { .data = single_values.Data(), .num = num });
+        require_sorted(single_keys, single_values);
+
+        Array<TestType> parallel_keys = keys;
+        Array<i32> parallel_values = values;
+        RadixSort(Slice<TestType> { .data = parallel_keys.Data(), .num = num }, Slice<i32> { .data = parallel_values.Data(), .num = num }, jobs);
+        require_sorted(parallel_keys, parallel_values);
+    }
+}
+
+TEST_CASE("radix sort by an extracted key", "[radix_sort]")
+{
+    Rng rng;
+    JobSystem jobs(3);
+
+    struct DrawCall {
+        u32 material;
+        f32 depth;
+        i32 order;
+    };
+
+    Array<DrawCall> draws;
+    for (i32 i = 0; i < 50000; i++) {
+        draws.PushBack({ .material = u32(rng.I32UniformInRange(0, 64)), .depth = rng.F32UniformInRange(0.f, 100.f), .order = i });
+    }
+    Array<DrawCall> parallel = draws;
+
+    auto by_material = [](DrawCall const& draw) { return draw.material; };
+    RadixSortBy(Slice<DrawCall> { .data = draws.Data(), .num = draws.Size() }, by_material);
+    RadixSortBy(Slice<DrawCall> { .data = parallel.Data(), .num = parallel.Size() }, by_material, jobs);
+
+    for (i64 i = 1; i < draws.Size(); i++) {
+        REQUIRE(draws[i - 1].material <= draws[i].material);
+        if (draws[i - 1].material == draws[i].material) {
+            REQUIRE(draws[i - 1].order < draws[i].order);
+        }
+        REQUIRE(parallel[i].order == draws[i].order);
+    }
+
+    SECTION("soa columns follow the key column")
+    {
+        struct Particles : public Soa<u32, f32, i32> {
+            enum Columns {
+                Cell,
+                Mass,
+                Id
+            };
+        };
+
+        Particles particles;
+        for (i32 i = 0; i < 1000; i++) {
+            particles.PushBackUninitialised();
+            particles.AtMut<Particles::Cell>(i) = u32(rng.I32UniformInRange(0, 50));
+            particles.AtMut<Particles::Mass>(i) = f32(i);
+            particles.AtMut<Particles::Id>(i) = i;
+        }
+
+        RadixSortBy<Particles::Cell>(particles, [](u32 cell) { return cell; }, jobs);
+
+        REQUIRE(particles.Size() == 1000);
+        for (i32 i = 0; i < 1000; i++) {
+            REQUIRE(particles.AtMut<Particles::Mass>(i) == f32(particles.AtMut<Particles::Id>(i)));
+            if (i > 0) {
+                u32 previous = particles.AtMut<Particles::Cell>(i - 1);
+                REQUIRE(previous <= particles.AtMut<Particles::Cell>(i));
+                if (previous == particles.AtMut<Particles::Cell>(i)) {
+                    REQUIRE(particles.AtMut<Particles::Id>(i - 1) < particles.AtMut<Particles::Id>(i));
+                }
+            }
+        }
+    }
+}
@@ -99,3 +99,24 @@ TEST_CASE("array can searched", "[array]")
     REQUIRE(a.Find(1) == 1);
     REQUIRE(a.Find(2) == NullOpt);
 }
+
+TEST_CASE("array respects over-aligned element types", "[array]")
+{
+    struct alignas(64) Aligned {
+        i32 value;
+    };
+
+    Array<Aligned> a;
+    for (i32 i = 0; i < 1000; i++) {
+        a.PushBack({ i });
+        REQUIRE(reinterpret_cast<uintptr_t>(a.Data()) % 64 == 0);
+    }
+
+    a.PopNum(500);
+    a.Shrink();
+    REQUIRE(reinterpret_cast<uintptr_t>(a.Data()) % 64 == 0);
+
+    for (i32 i = 0; i < 500; i++) {
+        REQUIRE(a[i].value == i);
+    }
+}
@@ -72,4 +72,52 @@ TEST_CASE("can create soa component", "[components]")
 	REQUIRE(test_components_.DataSlice<0>()[0].y == 2.f);
 	REQUIRE(test_components_.DataSlice<0>()[0].z == 3.f);
 	REQUIRE(test_components_.DataSlice<1>()[0].f == 7);
-}
\ No newline at end of file
+}
+
+TEST_CASE("tracked components report rows changed since a version", "[components]")
+{
+	struct TestComponent {
+		f32 x;
+	};
+	constexpr ComponentTypeId TestComponentTypeId = 0;
+	using TestComponentId = ComponentId<TestComponentTypeId>;
+
+	TrackedComponentArray<TestComponentId, TestComponent> test_components_;
+
+	Array<TestComponentId> ids;
+	for (i32 i = 0; i < 100; i++) {
+		ids.PushBack(test_components_.Add());
+	}
+
+	auto count_changed = [&](u32 version) {
+		i32 changed = 0;
+		test_components_.ForEachChanged(version, [&changed](i32) { changed++; });
+		return changed;
+	};
+
+	// freshly added rows count as written
+	REQUIRE(count_changed(0) == 100);
+
+	u32 seen = test_components_.GetVersion();
+	test_components_.AdvanceVersion();
+	REQUIRE(count_changed(seen) == 0);
+
+	test_components_.AtMut<0>(ids[10]).x = 1.f;
+	Slice<TestComponent> written = test_components_.DataSliceMut<0>(50, 60);
+	for (i64 i = 0; i < written.num; i++) {
+		written[i].x = 2.f;
+	}
+
+	Array<i32> changed;
+	test_components_.ForEachChanged(seen, [&changed](i32 flat_index) { changed.PushBack(flat_index); });
+	REQUIRE(changed.Size() == 11);
+	REQUIRE(changed[0] == 10);
+	REQUIRE(changed[1] == 50);
+
+	// removing swaps the last row in, its version moves with it
+	test_components_.AtMut<0>(ids[99]).x = 3.f;
+	test_components_.Remove(ids[0]);
+	REQUIRE(test_components_.ChangedSince(0, seen));
+	REQUIRE(test_components_.DataSlice<0>()[0].x == 3.f);
+	REQUIRE(count_changed(seen) == 12);
+}
@@ -1,4 +1,7 @@
 #include "DynamicBvh.h"
+#include "Jobs.h"
+#include "random.h"
+#include <algorithm>
 #include "catch/catch.hpp"
 
 using namespace Playground;
@@ -149,4 +152,846 @@ TEST_CASE("sorted insertion into dynamic bvh", "[dynamic_bvh]")
 
     REQUIRE(depth >= As<i32>(ceilf(log2f(As<f32>(boxes)))));
     REQUIRE(depth <= boxes);
-}
\ No newline at end of file
+}
+namespace {
+
+Array<Aabb3D> RandomBoxes(Rng& rng, i32 num, f32 extent)
+{
+    Array<Aabb3D> boxes;
+    for (i32 i = 0; i < num; i++) {
+        Vector3 p { rng.F32UniformInRange(-extent, extent), rng.F32UniformInRange(-extent, extent), rng.F32UniformInRange(-extent, extent) };
+        boxes.PushBack(Aabb3D::From(p, p + Vector3 { rng.F32UniformInRange(0.1f, 2.f), rng.F32UniformInRange(0.1f, 2.f), rng.F32UniformInRange(0.1f, 2.f) }));
+    }
+    return boxes;
+}
+
+// every slot contains what's below it and links agree both ways, returns the number of leaves
+i64 RequireValidTree(DynamicBvh const& bvh)
+{
+    if (bvh.root_ == DynamicBvh::NULL_NODE) {
+        return 0;
+    }
+
+    REQUIRE(bvh.nodes_[bvh.root_].parent == DynamicBvh::NULL_NODE);
+
+    i64 leaves = 0;
+    Array<i32> stack;
+    stack.PushBack(bvh.root_);
+    while (stack.Size()) {
+        i32 index = stack.PopBack();
+        DynamicBvh::Node const& node = bvh.nodes_[index];
+        Aabb3D const& bounds = bvh._Bounds(index);
+
+        if (node.IsLeaf()) {
+            REQUIRE(bounds.Contains(node.child_bounds[0]));
+            REQUIRE(bvh.leaves_[node.handle].node == index);
+            leaves++;
+            continue;
+        }
+
+        for (i32 c = 0; c < 2; c++) {
+            REQUIRE(bounds.Contains(node.child_bounds[c]));
+            REQUIRE(bvh.nodes_[node.children[c]].parent == index);
+            stack.PushBack(node.children[c]);
+        }
+    }
+    return leaves;
+}
+
+}
+
+TEST_CASE("dynamic bvh ray casts find the closest hit", "[dynamic_bvh]")
+{
+    Rng rng;
+    DynamicBvh bvh;
+
+    Array<Aabb3D> boxes = RandomBoxes(rng, 500, 20.f);
+    for (i32 i = 0; i < boxes.Size(); i++) {
+        bvh.Add(boxes[i]);
+    }
+
+    for (i32 ray = 0; ray < 200; ray++) {
+        Vector3 origin { rng.F32UniformInRange(-30, 30), rng.F32UniformInRange(-30, 30), rng.F32UniformInRange(-30, 30) };
+        Vector3 direction = Vector3 { rng.F32UniformInRange(-1, 1), rng.F32UniformInRange(-1, 1), rng.F32UniformInRange(-1, 1) }.normalized();
+        f32 max_t = 40.f;
+
+        f32 expected_t = Math::Constants<f32>::inf();
+        i32 all_hits = 0;
+        for (i32 i = 0; i < boxes.Size(); i++) {
+            if (Optional<f32> t = boxes[i].RayIntersection(origin, 1.f / direction, max_t)) {
+                expected_t = Min(expected_t, *t);
+                all_hits++;
+            }
+        }
+
+        Optional<DynamicBvh::RayHit> hit = bvh.RayCastClosest(origin, direction, max_t);
+        REQUIRE(bool(hit) == (all_hits > 0));
+        if (hit) {
+            REQUIRE(hit->t == Approx(expected_t));
+            Optional<f32> t = bvh.GetBoundingBox(hit->handle).RayIntersection(origin, 1.f / direction, max_t);
+            REQUIRE(t);
+            REQUIRE(*t == Approx(hit->t));
+        }
+
+        i32 visited = 0;
+        bvh.RayCast(origin, direction, max_t, [&](DynamicBvh::Handle, f32) {
+            visited++;
+            return max_t;
+        });
+        REQUIRE(visited == all_hits);
+
+        i32 first_only = 0;
+        bvh.RayCast(origin, direction, max_t, [&](DynamicBvh::Handle, f32) {
+            first_only++;
+            return 0.f;
+        });
+        REQUIRE(first_only == Min(all_hits, 1));
+    }
+}
+
+TEST_CASE("dynamic bvh box and sphere queries match brute force", "[dynamic_bvh]")
+{
+    Rng rng;
+    DynamicBvh bvh;
+
+    Array<Aabb3D> boxes = RandomBoxes(rng, 500, 20.f);
+    for (i32 i = 0; i < boxes.Size(); i++) {
+        bvh.Add(boxes[i]);
+    }
+
+    for (i32 query = 0; query < 100; query++) {
+        Vector3 p { rng.F32UniformInRange(-20, 20), rng.F32UniformInRange(-20, 20), rng.F32UniformInRange(-20, 20) };
+        Aabb3D bounds = Aabb3D::From(p, p + Vector3 { rng.F32UniformInRange(0.5f, 8.f) });
+        Sphere3D sphere { .position = p, .radius = rng.F32UniformInRange(0.5f, 8.f) };
+
+        i32 expected_overlapping = 0;
+        i32 expected_in_sphere = 0;
+        for (i32 i = 0; i < boxes.Size(); i++) {
+            expected_overlapping += boxes[i].Overlaps(bounds);
+            expected_in_sphere += boxes[i].Distance(sphere.position) <= sphere.radius;
+        }
+
+        i32 overlapping = 0;
+        bvh.QueryAabb(bounds, [&](DynamicBvh::Handle h) {
+            REQUIRE(bvh.GetBoundingBox(h).Overlaps(bounds));
+            overlapping++;
+            return true;
+        });
+        REQUIRE(overlapping == expected_overlapping);
+
+        i32 in_sphere = 0;
+        bvh.QuerySphere(sphere, [&](DynamicBvh::Handle) {
+            in_sphere++;
+            return true;
+        });
+        REQUIRE(in_sphere == expected_in_sphere);
+
+        i32 stopped = 0;
+        bvh.QueryAabb(bounds, [&](DynamicBvh::Handle) {
+            stopped++;
+            return false;
+        });
+        REQUIRE(stopped == Min(expected_overlapping, 1));
+    }
+}
+
+TEST_CASE("dynamic bvh batched queries match single queries", "[dynamic_bvh]")
+{
+    Rng rng;
+    DynamicBvh bvh;
+
+    Array<Aabb3D> boxes = RandomBoxes(rng, 300, 10.f);
+    for (i32 i = 0; i < boxes.Size(); i++) {
+        bvh.Add(boxes[i]);
+    }
+
+    // not a multiple of the packet width
+    constexpr i64 N = 203;
+
+    Array<Vector3> points;
+    Array<Vector3> origins;
+    Array<Vector3> directions;
+    for (i64 i = 0; i < N; i++) {
+        points.PushBack({ rng.F32UniformInRange(-10, 10), rng.F32UniformInRange(-10, 10), rng.F32UniformInRange(-10, 10) });
+        origins.PushBack({ rng.F32UniformInRange(-15, 15), rng.F32UniformInRange(-15, 15), -15.f });
+        directions.PushBack(Vector3 { rng.F32UniformInRange(-0.5f, 0.5f), rng.F32UniformInRange(-0.5f, 0.5f), 1.f }.normalized());
+    }
+
+    Array<DynamicBvh::PointHit> point_hits;
+    bvh.FindAllIntersecting({ .data = points.Data(), .num = N }, point_hits);
+
+    i64 expected_point_hits = 0;
+    for (i64 i = 0; i < N; i++) {
+        Array<DynamicBvh::Handle> single;
+        bvh.FindAllIntersecting(points[i], single);
+        expected_point_hits += single.Size();
+    }
+    REQUIRE(point_hits.Size() == expected_point_hits);
+    for (i64 i = 0; i < point_hits.Size(); i++) {
+        REQUIRE(bvh.GetBoundingBox(point_hits[i].handle).Contains(points[point_hits[i].query]));
+    }
+
+    Array<Optional<DynamicBvh::RayHit>> ray_hits;
+    ray_hits.Resize(N);
+    bvh.RayCastClosest({ .data = origins.Data(), .num = N }, { .data = directions.Data(), .num = N }, 50.f, { .data = ray_hits.Data(), .num = N });
+
+    for (i64 i = 0; i < N; i++) {
+        Optional<DynamicBvh::RayHit> expected = bvh.RayCastClosest(origins[i], directions[i], 50.f);
+        REQUIRE(bool(ray_hits[i]) == bool(expected));
+        if (expected) {
+            REQUIRE(ray_hits[i]->t == Approx(expected->t));
+        }
+    }
+}
+
+TEST_CASE("dynamic bvh finds the k closest leaves", "[dynamic_bvh]")
+{
+    Rng rng;
+    DynamicBvh bvh;
+
+    Array<Aabb3D> boxes = RandomBoxes(rng, 400, 20.f);
+    for (i32 i = 0; i < boxes.Size(); i++) {
+        bvh.Add(boxes[i]);
+    }
+
+    for (i32 query = 0; query < 100; query++) {
+        Vector3 point { rng.F32UniformInRange(-25, 25), rng.F32UniformInRange(-25, 25), rng.F32UniformInRange(-25, 25) };
+        i32 k = rng.I32UniformInRange(1, 16);
+        f32 max_distance = rng.F32UniformInRange(1.f, 10.f);
+
+        Array<f32> distances;
+        for (i32 i = 0; i < boxes.Size(); i++) {
+            f32 distance = boxes[i].Distance(point);
+            if (distance <= max_distance) {
+                distances.PushBack(distance);
+            }
+        }
+        std::sort(distances.Data(), distances.Data() + distances.Size());
+
+        Array<DynamicBvh::Handle> closest;
+        bvh.FindKClosest(point, k, max_distance, closest);
+
+        REQUIRE(closest.Size() == Min(As<i64>(k), distances.Size()));
+        for (i64 i = 0; i < closest.Size(); i++) {
+            REQUIRE(bvh.GetBoundingBox(closest[i]).Distance(point) == Approx(distances[i]));
+        }
+
+        Optional<DynamicBvh::Handle> single = bvh.FindClosest(point, max_distance);
+        REQUIRE(bool(single) == (distances.Size() > 0));
+    }
+}
+
+TEST_CASE("compacted dynamic bvh keeps handles and query results", "[dynamic_bvh]")
+{
+    Rng rng;
+    DynamicBvh bvh;
+
+    Array<Aabb3D> boxes = RandomBoxes(rng, 400, 20.f);
+    Array<DynamicBvh::Handle> handles;
+    for (i32 i = 0; i < boxes.Size(); i++) {
+        handles.PushBack(bvh.Add(boxes[i]));
+    }
+
+    // churn so the node array has holes and no particular order
+    for (i32 i = 0; i < 300; i++) {
+        i32 index = rng.I32UniformInRange(0, As<i32>(boxes.Size()) - 1);
+        Vector3 offset { rng.F32UniformInRange(-3, 3), rng.F32UniformInRange(-3, 3), rng.F32UniformInRange(-3, 3) };
+        boxes[index] = Aabb3D::From(boxes[index].vec_min + offset, boxes[index].vec_max + offset);
+        bvh.Modify(handles[index], boxes[index]);
+    }
+    for (i32 i = 0; i < 100; i++) {
+        i32 index = rng.I32UniformInRange(0, As<i32>(boxes.Size()) - 1);
+        bvh.Remove(handles[index]);
+        boxes.RemoveAtAndSwapWithLast(index);
+        handles.RemoveAtAndSwapWithLast(index);
+    }
+
+    i32 depth = bvh.GetDepth();
+    bvh.Compact();
+
+    REQUIRE(bvh.GetDepth() == depth);
+    REQUIRE(bvh.nodes_.Size() == 2 * boxes.Size() - 1);
+    REQUIRE(bvh.root_ == 0);
+    for (i32 i = 0; i < bvh.nodes_.Size(); i++) {
+        DynamicBvh::Node const& node = bvh.nodes_[i];
+        if (!node.IsLeaf()) {
+            // depth first, the left child follows its parent
+            REQUIRE(node.children[0] == i + 1);
+            REQUIRE(node.children[1] > i + 1);
+            REQUIRE(bvh.nodes_[node.children[0]].parent == i);
+            REQUIRE(bvh.nodes_[node.children[1]].parent == i);
+        }
+    }
+
+    for (i32 i = 0; i < boxes.Size(); i++) {
+        REQUIRE(bvh.GetBoundingBox(handles[i]).vec_min == boxes[i].vec_min);
+        REQUIRE(bvh.GetBoundingBox(handles[i]).vec_max == boxes[i].vec_max);
+    }
+
+    for (i32 query = 0; query < 100; query++) {
+        Vector3 p { rng.F32UniformInRange(-20, 20), rng.F32UniformInRange(-20, 20), rng.F32UniformInRange(-20, 20) };
+        Aabb3D bounds = Aabb3D::From(p, p + Vector3 { rng.F32UniformInRange(0.5f, 8.f) });
+
+        i32 expected_overlapping = 0;
+        for (i32 i = 0; i < boxes.Size(); i++) {
+            expected_overlapping += boxes[i].Overlaps(bounds);
+        }
+
+        i32 overlapping = 0;
+        bvh.QueryAabb(bounds, [&](DynamicBvh::Handle) {
+            overlapping++;
+            return true;
+        });
+        REQUIRE(overlapping == expected_overlapping);
+    }
+
+    // the tree keeps working after compaction
+    for (i32 i = 0; i < 50; i++) {
+        bvh.Modify(handles[i], Aabb3D::From(Vector3 { 100.f + i }, Vector3 { 101.f + i }));
+    }
+    REQUIRE(bvh.FindClosest(Vector3 { 125.5f }, 0.f));
+    handles.PushBack(bvh.Add(Aabb3D::From(Vector3 { -100.f }, Vector3 { -99.f })));
+    REQUIRE(bvh.FindClosest(Vector3 { -99.5f }, 0.f));
+
+    DynamicBvh empty;
+    empty.Compact();
+    REQUIRE(empty.nodes_.Size() == 0);
+}
+
+TEST_CASE("bulk built dynamic bvh matches brute force and stays mutable", "[dynamic_bvh]")
+{
+    Rng rng;
+    JobSystem jobs { 3 };
+
+    // large enough for subtrees to be built as jobs
+    i32 num = GENERATE(1, 2, 7, 20000);
+    bool parallel = GENERATE(false, true);
+
+    Array<Aabb3D> boxes = RandomBoxes(rng, num, 50.f);
+    Array<DynamicBvh::Handle> handles;
+    handles.Resize(num);
+
+    DynamicBvh bvh;
+    bvh.Build({ .data = boxes.Data(), .num = num }, { .data = handles.Data(), .num = num }, parallel ? &jobs : nullptr);
+
+    REQUIRE(RequireValidTree(bvh) == num);
+    REQUIRE(bvh.nodes_.Size() == 2 * num - 1);
+    for (i32 i = 0; i < num; i++) {
+        REQUIRE(bvh.GetBoundingBox(handles[i]).vec_min == boxes[i].vec_min);
+        REQUIRE(bvh.GetBoundingBox(handles[i]).vec_max == boxes[i].vec_max);
+    }
+    // SAH keeps the depth in the same range as incremental insertion
+    REQUIRE(bvh.GetDepth() <= 4 * As<i32>(ceilf(log2f(As<f32>(num)))) + 1);
+
+    auto require_queries_match = [&]() {
+        for (i32 query = 0; query < 50; query++) {
+            Vector3 p { rng.F32UniformInRange(-50, 50), rng.F32UniformInRange(-50, 50), rng.F32UniformInRange(-50, 50) };
+            Aabb3D bounds = Aabb3D::From(p, p + Vector3 { rng.F32UniformInRange(0.5f, 10.f) });
+
+            i32 expected_overlapping = 0;
+            for (i32 i = 0; i < boxes.Size(); i++) {
+                expected_overlapping += boxes[i].Overlaps(bounds);
+            }
+
+            i32 overlapping = 0;
+            bvh.QueryAabb(bounds, [&](DynamicBvh::Handle) {
+                overlapping++;
+                return true;
+            });
+            REQUIRE(overlapping == expected_overlapping);
+        }
+    };
+    require_queries_match();
+
+    for (i32 i = 0; i < Min(num, 200); i++) {
+        i32 index = rng.I32UniformInRange(0, num);
+        Vector3 offset { rng.F32UniformInRange(-5, 5), rng.F32UniformInRange(-5, 5), rng.F32UniformInRange(-5, 5) };
+        boxes[index] = Aabb3D::From(boxes[index].vec_min + offset, boxes[index].vec_max + offset);
+        bvh.Modify(handles[index], boxes[index]);
+    }
+    for (i32 i = 0; i < num / 2; i++) {
+        i32 index = rng.I32UniformInRange(0, As<i32>(boxes.Size()));
+        bvh.Remove(handles[index]);
+        boxes.RemoveAtAndSwapWithLast(index);
+        handles.RemoveAtAndSwapWithLast(index);
+    }
+    boxes.PushBack(Aabb3D::From(Vector3 { 60.f }, Vector3 { 61.f }));
+    handles.PushBack(bvh.Add(boxes[boxes.Size() - 1]));
+
+    REQUIRE(RequireValidTree(bvh) == boxes.Size());
+    require_queries_match();
+}
+
+TEST_CASE("dynamic bvh inflation policies", "[dynamic_bvh]")
+{
+    DynamicBvh bvh;
+    bvh.inflation_margin_ = 0.5f;
+    bvh.velocity_prediction_time_ = 1.f;
+
+    Aabb3D box = Aabb3D::From(Vector3 { 0.f }, Vector3 { 1.f });
+    DynamicBvh::Handle fixed = bvh.Add(box, DynamicBvh::FixedMargin);
+    DynamicBvh::Handle predicted = bvh.Add(box.Scaled(0.5f), DynamicBvh::Velocity);
+
+    i32 fixed_node = bvh.leaves_[fixed.index].node;
+    REQUIRE(bvh._Bounds(fixed_node).vec_min == Vector3 { -0.5f });
+    REQUIRE(bvh._Bounds(fixed_node).vec_max == Vector3 { 1.5f });
+
+    // escapes, the new node is stretched along +x only
+    Vector3 velocity { 4.f, 0.f, 0.f };
+    Aabb3D moved = Aabb3D::From(Vector3 { 5.f, 0.f, 0.f }, Vector3 { 6.f, 1.f, 1.f });
+    bvh.Modify(predicted, moved, velocity);
+
+    i32 predicted_node = bvh.leaves_[predicted.index].node;
+    Aabb3D inflated = bvh._Bounds(predicted_node);
+    REQUIRE(inflated.vec_min == Vector3 { 4.5f, -0.5f, -0.5f });
+    REQUIRE(inflated.vec_max == Vector3 { 10.5f, 1.5f, 1.5f });
+
+    // moving on at the predicted speed stays inside without reinsertion
+    for (i32 frame = 1; frame <= 4; frame++) {
+        Vector3 offset = velocity * (frame / 4.f);
+        bvh.Modify(predicted, Aabb3D::From(moved.vec_min + offset, moved.vec_max + offset), velocity);
+        REQUIRE(bvh._Bounds(predicted_node).vec_min == inflated.vec_min);
+        REQUIRE(bvh._Bounds(predicted_node).vec_max == inflated.vec_max);
+    }
+    REQUIRE(bvh.GetBoundingBox(predicted).vec_min == moved.vec_min + velocity);
+}
+
+TEST_CASE("batched dynamic bvh modify matches brute force", "[dynamic_bvh]")
+{
+    Rng rng;
+    DynamicBvh bvh;
+
+    Array<Aabb3D> boxes = RandomBoxes(rng, 2000, 40.f);
+    Array<DynamicBvh::Handle> handles;
+    Array<Vector3> velocities;
+    for (i32 i = 0; i < boxes.Size(); i++) {
+        DynamicBvh::InflationPolicy policy = i % 3 == 0 ? DynamicBvh::Default : (i % 3 == 1 ? DynamicBvh::FixedMargin : DynamicBvh::Velocity);
+        handles.PushBack(bvh.Add(boxes[i], policy));
+        velocities.PushBack({ rng.F32UniformInRange(-20, 20), rng.F32UniformInRange(-20, 20), rng.F32UniformInRange(-20, 20) });
+    }
+
+    Array<DynamicBvh::Handle> moved_handles;
+    Array<Aabb3D> moved_boxes;
+    Array<Vector3> moved_velocities;
+
+    for (i32 frame = 0; frame < 20; frame++) {
+        moved_handles.Clear();
+        moved_boxes.Clear();
+        moved_velocities.Clear();
+
+        for (i32 i = 0; i < boxes.Size(); i++) {
+            // some leaves stay, a few jump far away
+            if (rng.I32UniformInRange(0, 3) == 0) {
+                continue;
+            }
+            Vector3 offset = rng.I32UniformInRange(0, 50) == 0 ? Vector3 { rng.F32UniformInRange(-40, 40), 0.f, 0.f } : velocities[i] / 60.f;
+            boxes[i] = Aabb3D::From(boxes[i].vec_min + offset, boxes[i].vec_max + offset);
+
+            moved_handles.PushBack(handles[i]);
+            moved_boxes.PushBack(boxes[i]);
+            moved_velocities.PushBack(velocities[i]);
+        }
+
+        i64 num = moved_handles.Size();
+        bvh.ModifyBatch({ .data = moved_handles.Data(), .num = num }, { .data = moved_boxes.Data(), .num = num }, { .data = moved_velocities.Data(), .num = frame % 2 ? num : 0 });
+
+        REQUIRE(RequireValidTree(bvh) == boxes.Size());
+    }
+
+    for (i32 i = 0; i < boxes.Size(); i++) {
+        REQUIRE(bvh.GetBoundingBox(handles[i]).vec_min == boxes[i].vec_min);
+    }
+
+    for (i32 query = 0; query < 100; query++) {
+        Vector3 p { rng.F32UniformInRange(-40, 40), rng.F32UniformInRange(-40, 40), rng.F32UniformInRange(-40, 40) };
+        Aabb3D bounds = Aabb3D::From(p, p + Vector3 { rng.F32UniformInRange(0.5f, 8.f) });
+
+        i32 expected_overlapping = 0;
+        for (i32 i = 0; i < boxes.Size(); i++) {
+            expected_overlapping += boxes[i].Overlaps(bounds);
+        }
+
+        i32 overlapping = 0;
+        bvh.QueryAabb(bounds, [&](DynamicBvh::Handle) {
+            overlapping++;
+            return true;
+        });
+        REQUIRE(overlapping == expected_overlapping);
+    }
+
+    // the batched refit keeps the tree about as shallow as one by one modification
+    REQUIRE(bvh.GetDepth() < 40);
+}
+
+TEST_CASE("dynamic bvh optimize recovers tree quality", "[dynamic_bvh]")
+{
+    Rng rng;
+    DynamicBvh bvh;
+
+    Array<Aabb3D> boxes = RandomBoxes(rng, 2000, 100.f);
+    Array<DynamicBvh::Handle> handles;
+    for (i32 i = 0; i < boxes.Size(); i++) {
+        handles.PushBack(bvh.Add(boxes[i], DynamicBvh::Velocity));
+    }
+    bvh.Remove(handles.PopBack());
+    boxes.PopBack();
+
+    // fast erratic movement leaves long stretched fat bounds behind
+    for (i32 frame = 0; frame < 20; frame++) {
+        for (i32 i = 0; i < boxes.Size(); i++) {
+            Vector3 velocity { rng.F32UniformInRange(-60, 60), rng.F32UniformInRange(-60, 60), rng.F32UniformInRange(-60, 60) };
+            boxes[i] = Aabb3D::From(boxes[i].vec_min + velocity / 60.f, boxes[i].vec_max + velocity / 60.f);
+            bvh.Modify(handles[i], boxes[i], velocity);
+        }
+    }
+
+    f32 degraded = bvh.GetSahCost();
+    bvh.Optimize(0);
+    REQUIRE(bvh.GetSahCost() == degraded);
+
+    // one full cycle over the leaves
+    for (i32 frame = 0; frame < 4; frame++) {
+        bvh.Optimize(500);
+    }
+    f32 optimized = bvh.GetSahCost();
+    REQUIRE(optimized < 0.95f * degraded);
+
+    DynamicBvh built;
+    Array<DynamicBvh::Handle> built_handles;
+    built_handles.Resize(boxes.Size());
+    built.Build({ .data = boxes.Data(), .num = boxes.Size() }, { .data = built_handles.Data(), .num = built_handles.Size() }, nullptr, DynamicBvh::Velocity);
+    REQUIRE(optimized < 1.1f * built.GetSahCost());
+
+    REQUIRE(RequireValidTree(bvh) == boxes.Size());
+    for (i32 i = 0; i < boxes.Size(); i++) {
+        REQUIRE(bvh.GetBoundingBox(handles[i]).vec_min == boxes[i].vec_min);
+    }
+    for (i32 query = 0; query < 50; query++) {
+        Vector3 p { rng.F32UniformInRange(-100, 100), rng.F32UniformInRange(-100, 100), rng.F32UniformInRange(-100, 100) };
+        Aabb3D bounds = Aabb3D::From(p, p + Vector3 { rng.F32UniformInRange(1.f, 20.f) });
+
+        i32 expected_overlapping = 0;
+        for (i32 i = 0; i < boxes.Size(); i++) {
+            expected_overlapping += boxes[i].Overlaps(bounds);
+        }
+
+        i32 overlapping = 0;
+        bvh.QueryAabb(bounds, [&](DynamicBvh::Handle) {
+            overlapping++;
+            return true;
+        });
+        REQUIRE(overlapping == expected_overlapping);
+    }
+}
+
+TEST_CASE("dynamic bvh overlapping pairs match brute force", "[dynamic_bvh]")
+{
+    Rng rng;
+    DynamicBvh bvh;
+
+    Array<Aabb3D> boxes = RandomBoxes(rng, 1500, 30.f);
+    Array<DynamicBvh::Handle> handles;
+    for (Aabb3D bounds : boxes) {
+        handles.PushBack(bvh.Add(bounds));
+    }
+    // a few exact duplicates and touching faces
+    handles.PushBack(bvh.Add(boxes[0]));
+    boxes.PushBack(boxes[0]);
+    handles.PushBack(bvh.Add(Aabb3D::From(boxes[1].vec_max, boxes[1].vec_max + Vector3 { 1.f })));
+    boxes.PushBack(Aabb3D::From(boxes[1].vec_max, boxes[1].vec_max + Vector3 { 1.f }));
+
+    i64 num = boxes.Size();
+    auto key = [num](DynamicBvh::Pair pair) {
+        return pair.a.index * num + pair.b.index;
+    };
+    auto sorted_keys = [&](Array<DynamicBvh::Pair>& pairs) {
+        Array<i64> keys;
+        for (DynamicBvh::Pair pair : pairs) {
+            REQUIRE(pair.a.index < pair.b.index);
+            keys.PushBack(key(pair));
+        }
+        std::sort(keys.Data(), keys.Data() + keys.Size());
+        return keys;
+    };
+
+    Array<i64> expected;
+    for (i32 i = 0; i < num; i++) {
+        for (i32 j = i + 1; j < num; j++) {
+            if (boxes[i].Overlaps(boxes[j])) {
+                i32 a = Min(handles[i].index, handles[j].index);
+                i32 b = Max(handles[i].index, handles[j].index);
+                expected.PushBack(a * num + b);
+            }
+        }
+    }
+    std::sort(expected.Data(), expected.Data() + expected.Size());
+
+    SECTION("whole tree")
+    {
+        Array<DynamicBvh::Pair> pairs;
+        bvh.FindOverlappingPairs(pairs);
+
+        Array<i64> keys = sorted_keys(pairs);
+        REQUIRE(keys.Size() == expected.Size());
+        REQUIRE(std::equal(keys.Data(), keys.Data() + keys.Size(), expected.Data()));
+    }
+
+    SECTION("parallel matches serial")
+    {
+        JobSystem jobs(3);
+
+        Array<DynamicBvh::Pair> serial;
+        bvh.FindOverlappingPairs(serial);
+        Array<DynamicBvh::Pair> parallel;
+        bvh.FindOverlappingPairs(parallel, jobs);
+
+        Array<i64> serial_keys = sorted_keys(serial);
+        Array<i64> parallel_keys = sorted_keys(parallel);
+        REQUIRE(parallel_keys.Size() == serial_keys.Size());
+        REQUIRE(std::equal(parallel_keys.Data(), parallel_keys.Data() + parallel_keys.Size(), serial_keys.Data()));
+    }
+
+    SECTION("only moved leaves")
+    {
+        Array<DynamicBvh::Handle> moved;
+        Bitarray is_moved;
+        is_moved.Resize(num);
+        for (i32 i = 0; i < num; i++) {
+            if (rng.I32UniformInRange(0, 10) == 0) {
+                moved.PushBack(handles[i]);
+                is_moved.SetBit(handles[i].index, true);
+            }
+        }
+
+        Array<DynamicBvh::Pair> pairs;
+        bvh.FindOverlappingPairs({ .data = moved.Data(), .num = moved.Size() }, pairs);
+
+        Array<i64> expected_moved;
+        for (i64 k : expected) {
+            if (is_moved.GetBit(k / num) || is_moved.GetBit(k % num)) {
+                expected_moved.PushBack(k);
+            }
+        }
+
+        Array<i64> keys = sorted_keys(pairs);
+        REQUIRE(keys.Size() == expected_moved.Size());
+        REQUIRE(std::equal(keys.Data(), keys.Data() + keys.Size(), expected_moved.Data()));
+
+        // listing the leaves again doesn't report their pairs twice
+        Array<DynamicBvh::Handle> repeated = moved;
+        for (i64 i = moved.Size() - 1; i >= 0; i--) {
+            repeated.PushBack(moved[i]);
+        }
+
+        Array<DynamicBvh::Pair> repeated_pairs;
+        bvh.FindOverlappingPairs({ .data = repeated.Data(), .num = repeated.Size() }, repeated_pairs);
+
+        Array<i64> repeated_keys = sorted_keys(repeated_pairs);
+        REQUIRE(repeated_keys.Size() == expected_moved.Size());
+        REQUIRE(std::equal(repeated_keys.Data(), repeated_keys.Data() + repeated_keys.Size(), expected_moved.Data()));
+    }
+
+    SECTION("empty and single leaf trees have no pairs")
+    {
+        DynamicBvh empty;
+        Array<DynamicBvh::Pair> pairs;
+        empty.FindOverlappingPairs(pairs);
+        REQUIRE(pairs.Size() == 0);
+
+        DynamicBvh single;
+        single.Add(boxes[0]);
+        single.FindOverlappingPairs(pairs);
+        REQUIRE(pairs.Size() == 0);
+    }
+}
+
+TEST_CASE("dynamic bvh saved image loads into the same tree", "[dynamic_bvh]")
+{
+    Rng rng;
+    DynamicBvh bvh;
+
+    Array<Aabb3D> boxes = RandomBoxes(rng, 1000, 30.f);
+    Array<DynamicBvh::Handle> handles;
+    for (Aabb3D bounds : boxes) {
+        handles.PushBack(bvh.Add(bounds, DynamicBvh::FixedMargin));
+    }
+    // holes in both free lists
+    for (i32 i = 0; i < 100; i++) {
+        bvh.Remove(handles[i * 7]);
+    }
+
+    Array<u8> image;
+    bvh.Save(image);
+
+    DynamicBvh loaded;
+    REQUIRE(loaded.Load({ .data = image.Data(), .num = image.Size() }));
+    REQUIRE(RequireValidTree(loaded) == 900);
+    REQUIRE(loaded.root_ == bvh.root_);
+    REQUIRE(loaded.GetDepth() == bvh.GetDepth());
+    REQUIRE(loaded.GetSahCost() == bvh.GetSahCost());
+
+    for (i32 query = 0; query < 50; query++) {
+        Vector3 p { rng.F32UniformInRange(-30, 30), rng.F32UniformInRange(-30, 30), rng.F32UniformInRange(-30, 30) };
+        Aabb3D bounds = Aabb3D::From(p, p + Vector3 { 5.f });
+
+        Array<i32> expected;
+        bvh.QueryAabb(bounds, [&](DynamicBvh::Handle h) {
+            expected.PushBack(h.index);
+            return true;
+        });
+        Array<i32> found;
+        loaded.QueryAabb(bounds, [&](DynamicBvh::Handle h) {
+            found.PushBack(h.index);
+            return true;
+        });
+        REQUIRE(found.Size() == expected.Size());
+        REQUIRE(std::equal(found.Data(), found.Data() + found.Size(), expected.Data()));
+    }
+
+    // the free lists came along, both trees hand out the same handles and stay mutable
+    for (i32 i = 0; i < 20; i++) {
+        Aabb3D bounds = boxes[i * 7];
+        REQUIRE(loaded.Add(bounds).index == bvh.Add(bounds).index);
+    }
+    loaded.Modify(handles[1], Aabb3D::From(Vector3 { 100.f }, Vector3 { 101.f }));
+    REQUIRE(RequireValidTree(loaded) == 920);
+
+    SECTION("bad images are rejected")
+    {
+        DynamicBvh rejected;
+
+        REQUIRE_FALSE(rejected.Load({ .data = image.Data(), .num = image.Size() / 2 }));
+        REQUIRE(rejected.root_ == DynamicBvh::NULL_NODE);
+
+        Array<u8> newer = image;
+        newer[4]++;
+        REQUIRE_FALSE(rejected.Load({ .data = newer.Data(), .num = newer.Size() }));
+        REQUIRE(rejected.nodes_.Size() == 0);
+
+        // right sizes, indices pointing outside of the arrays
+        auto require_rejected = [&](auto&& damage) {
+            DynamicBvh damaged = bvh;
+            damage(damaged);
+            Array<u8> damaged_image;
+            damaged.Save(damaged_image);
+            REQUIRE_FALSE(rejected.Load({ .data = damaged_image.Data(), .num = damaged_image.Size() }));
+            REQUIRE(rejected.nodes_.Size() == 0);
+        };
+        require_rejected([](DynamicBvh& damaged) { damaged.nodes_[damaged.root_].children[1] = As<i32>(damaged.nodes_.Size()); });
+        require_rejected([](DynamicBvh& damaged) { damaged.nodes_[damaged.root_].parent = -2; });
+        require_rejected([](DynamicBvh& damaged) { damaged.nodes_[damaged.leaves_[1].node].handle = As<i32>(damaged.leaves_.Size()); });
+        require_rejected([](DynamicBvh& damaged) { damaged.leaves_[1].node = As<i32>(damaged.nodes_.Size()); });
+        require_rejected([](DynamicBvh& damaged) { damaged.nodes_freelist_.freelist_[0] = damaged.nodes_freelist_.next_; });
+        require_rejected([](DynamicBvh& damaged) { damaged.leaves_freelist_.next_ = As<i32>(damaged.leaves_.Size() + 1); });
+    }
+
+    SECTION("empty tree")
+    {
+        DynamicBvh empty;
+        Array<u8> empty_image;
+        empty.Save(empty_image);
+
+        REQUIRE(loaded.Load({ .data = empty_image.Data(), .num = empty_image.Size() }));
+        REQUIRE(loaded.root_ == DynamicBvh::NULL_NODE);
+        REQUIRE(loaded.Add(boxes[0]).index == 0);
+    }
+}
+
+TEST_CASE("dynamic bvh view queries a saved image in place", "[dynamic_bvh]")
+{
+    Rng rng;
+    DynamicBvh bvh;
+
+    Array<Aabb3D> boxes = RandomBoxes(rng, 1000, 30.f);
+    Array<DynamicBvh::Handle> handles;
+    for (Aabb3D bounds : boxes) {
+        handles.PushBack(bvh.Add(bounds));
+    }
+    for (i32 i = 0; i < 100; i++) {
+        bvh.Remove(handles[i * 7]);
+    }
+
+    // a mapped file starts on a page, a cache line is all the view needs
+    struct alignas(64) Line {
+        u8 bytes[64];
+    };
+    auto save_aligned = [](DynamicBvh const& tree, Array<Line>& lines) {
+        Array<u8> saved;
+        tree.Save(saved);
+        lines.ResizeUninitialised((saved.Size() + 63) / 64);
+        memcpy(lines.Data(), saved.Data(), saved.Size());
+        return Slice<u8 const> { .data = reinterpret_cast<u8 const*>(lines.Data()), .num = saved.Size() };
+    };
+
+    Array<Line> lines;
+    Slice<u8 const> image = save_aligned(bvh, lines);
+
+    for (bool trusted : { false, true }) {
+        DynamicBvhView view;
+        REQUIRE(view.Open(image, trusted));
+        REQUIRE(view.root_ == bvh.root_);
+        // the nodes are read where they are in the image
+        REQUIRE(reinterpret_cast<u8 const*>(view.nodes_.data) > image.data);
+        REQUIRE(reinterpret_cast<u8 const*>(view.nodes_.data + view.nodes_.num) <= image.data + image.num);
+
+        for (i32 i = 0; i < 100; i++) {
+            Aabb3D expected = bvh.GetBoundingBox(handles[i * 7 + 1]);
+            Aabb3D found = view.GetBoundingBox(handles[i * 7 + 1]);
+            REQUIRE((found.vec_min == expected.vec_min && found.vec_max == expected.vec_max));
+        }
+
+        for (i32 query = 0; query < 50; query++) {
+            Vector3 p { rng.F32UniformInRange(-30, 30), rng.F32UniformInRange(-30, 30), rng.F32UniformInRange(-30, 30) };
+
+            Array<i32> expected;
+            Array<i32> found;
+            auto collect = [](Array<i32>& out) {
+                return [&out](DynamicBvh::Handle h) {
+                    out.PushBack(h.index);
+                    return true;
+                };
+            };
+
+            Aabb3D bounds = Aabb3D::From(p, p + Vector3 { 5.f });
+            bvh.QueryAabb(bounds, collect(expected));
+            view.QueryAabb(bounds, collect(found));
+            Sphere3D sphere { .position = p, .radius = 4.f };
+            bvh.QuerySphere(sphere, collect(expected));
+            view.QuerySphere(sphere, collect(found));
+            REQUIRE(found.Size() == expected.Size());
+            REQUIRE(std::equal(found.Data(), found.Data() + found.Size(), expected.Data()));
+
+            Vector3 direction { rng.F32UniformInRange(-1, 1), rng.F32UniformInRange(-1, 1), rng.F32UniformInRange(-1, 1) };
+            Optional<DynamicBvh::RayHit> expected_hit = bvh.RayCastClosest(p, direction, 100.f);
+            Optional<DynamicBvh::RayHit> hit = view.RayCastClosest(p, direction, 100.f);
+            REQUIRE(bool(hit) == bool(expected_hit));
+            if (hit) {
+                REQUIRE(hit->handle.index == expected_hit->handle.index);
+                REQUIRE(hit->t == expected_hit->t);
+            }
+        }
+    }
+
+    SECTION("bad images are rejected")
+    {
+        DynamicBvhView view;
+        REQUIRE_FALSE(view.Open({ .data = image.data, .num = image.num / 2 }));
+        REQUIRE(view.root_ == DynamicBvh::NULL_NODE);
+
+        // the same bytes off the cache line
+        Array<Line> shifted;
+        shifted.ResizeUninitialised(lines.Size() + 1);
+        u8* shifted_image = reinterpret_cast<u8*>(shifted.Data()) + 4;
+        memcpy(shifted_image, image.data, image.num);
+        REQUIRE_FALSE(view.Open({ .data = shifted_image, .num = image.num }));
+        REQUIRE(view.nodes_.num == 0);
+
+        // indices outside of the arrays are only looked for when the image isn't trusted
+        DynamicBvh damaged = bvh;
+        damaged.nodes_[damaged.root_].children[1] = As<i32>(damaged.nodes_.Size());
+        Array<Line> damaged_lines;
+        Slice<u8 const> damaged_image = save_aligned(damaged, damaged_lines);
+        REQUIRE_FALSE(view.Open(damaged_image));
+        REQUIRE(view.Open(damaged_image, true));
+    }
+}
@@ -97,4 +97,63 @@ TEST_CASE("components can be queried by type", "[ecs]")
     REQUIRE(entities.GetAnyComponentOfType(e2, TB::ComponentTypeId) == TB::Make(2, 1));
     REQUIRE(entities.GetAnyComponentOfType(e2, TC::ComponentTypeId) == TC::Make(2, 1));
     REQUIRE(!entities.GetAnyComponentOfType(e2, TD::ComponentTypeId));
-}
\ No newline at end of file
+}
+
+TEST_CASE("destroying an entity releases its components", "[ecs]")
+{
+    Entities entities;
+
+    using T0 = ComponentId<1>;
+    using TMany = ComponentId<1000>;
+
+    EntityId e0 = entities.Spawn();
+    entities.AttachComponent(e0, T0::Make(0, 1));
+    for (i32 i = 0; i < 20; i++) {
+        entities.AttachComponent(e0, TMany::Make(i, 1));
+    }
+
+    i32 components = 0;
+    entities.ForEachComponent(e0, [&components](TypedComponentId) { components++; });
+    REQUIRE(components == 21);
+
+    entities.Destroy(e0);
+
+    REQUIRE(!entities.GetOwner(T0::Make(0, 1)));
+    for (i32 i = 0; i < 20; i++) {
+        REQUIRE(!entities.GetOwner(TMany::Make(i, 1)));
+    }
+    REQUIRE(entities.component_list_nodes_.free_slots_.Size() == entities.component_list_nodes_.next_);
+
+    // recycled nodes start empty
+    EntityId e1 = entities.Spawn();
+    entities.AttachComponent(e1, TMany::Make(100, 1));
+
+    components = 0;
+    entities.ForEachComponent(e1, [&components](TypedComponentId c) {
+        REQUIRE(c == TypedComponentId(TMany::Make(100, 1)));
+        components++;
+    });
+    REQUIRE(components == 1);
+}
+
+TEST_CASE("owner lookup rejects stale component handles", "[ecs]")
+{
+    Entities entities;
+
+    using T = ComponentId<5>;
+
+    EntityId e0 = entities.Spawn();
+    EntityId e1 = entities.Spawn();
+
+    entities.AttachComponent(e0, T::Make(3, 1));
+    REQUIRE(entities.GetOwner(T::Make(3, 1)) == e0);
+    REQUIRE(!entities.GetOwner(T::Make(3, 2)));
+    REQUIRE(!entities.GetOwner(T::Make(2, 1)));
+    REQUIRE(!entities.GetOwner(ComponentId<6>::Make(3, 1)));
+
+    // the container recycled the slot with a new generation
+    entities.DetachComponent(e0, T::Make(3, 1));
+    entities.AttachComponent(e1, T::Make(3, 2));
+    REQUIRE(!entities.GetOwner(T::Make(3, 1)));
+    REQUIRE(entities.GetOwner(T::Make(3, 2)) == e1);
+}
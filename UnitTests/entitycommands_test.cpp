@@ -0,0 +1,148 @@
+#include "EntityCommands.h"
+#include "Jobs.h"
+#include "Systems.h"
+#include "catch/catch.hpp"
+
+using namespace Playground;
+
+TEST_CASE("recorded commands are applied on playback", "[ecs]")
+{
+    Entities entities;
+    EntityCommands commands;
+
+    using TA = ComponentId<100>;
+    using TB = ComponentId<101>;
+
+    EntityId e0 = entities.Spawn();
+    entities.AttachComponent(e0, TA::Make(0, 1));
+
+    EntityCommandBuffer& buffer = commands.Local();
+    DeferredEntityId e1 = buffer.Spawn();
+    buffer.AttachComponent(e1, TA::Make(1, 1));
+    buffer.AttachComponent(e1, TB::Make(1, 1));
+    buffer.DetachComponent(e0, TA::Make(0, 1));
+    buffer.AttachComponent(e0, TB::Make(0, 1));
+
+    // nothing happens until playback
+    REQUIRE(entities.entities_.Size() == 1);
+    REQUIRE(entities.GetOwner(TA::Make(0, 1)) == e0);
+
+    commands.Playback(entities);
+
+    REQUIRE(buffer.Empty());
+    REQUIRE(entities.entities_.Size() == 2);
+
+    EntityId e1_id = commands.Resolve(e1);
+    REQUIRE(entities.GetOwner(TA::Make(1, 1)) == e1_id);
+    REQUIRE(entities.GetOwner(TB::Make(1, 1)) == e1_id);
+    REQUIRE(!entities.GetOwner(TA::Make(0, 1)));
+    REQUIRE(entities.GetOwner(TB::Make(0, 1)) == e0);
+}
+
+TEST_CASE("workers record commands without locks", "[ecs]")
+{
+    Entities entities;
+    JobSystem jobs { 3 };
+    EntityCommands commands { jobs.WorkersNum() };
+
+    using T = ComponentId<100>;
+
+    jobs.ParallelFor(1000, 10, [&commands](i64 begin, i64 end) {
+        EntityCommandBuffer& buffer = commands.Local();
+        for (i64 i = begin; i < end; i++) {
+            DeferredEntityId e = buffer.Spawn();
+            buffer.AttachComponent(e, T::Make(As<i32>(i), 1));
+        }
+    });
+
+    commands.Playback(entities);
+
+    REQUIRE(entities.entities_.Size() == 1000);
+    for (i32 i = 0; i < 1000; i++) {
+        Optional<EntityId> owner = entities.GetOwner(T::Make(i, 1));
+        REQUIRE(owner);
+        REQUIRE(entities.GetAnyComponentOfType(*owner, T::ComponentTypeId) == T::Make(i, 1));
+    }
+}
+
+TEST_CASE("detaches are played back before attaches", "[ecs]")
+{
+    Entities entities;
+    EntityCommands commands;
+
+    using T = ComponentId<100>;
+
+    EntityId e0 = entities.Spawn();
+    EntityId e1 = entities.Spawn();
+    entities.AttachComponent(e0, T::Make(0, 1));
+
+    // moving a component works whatever order it's recorded in
+    EntityCommandBuffer& buffer = commands.Local();
+    buffer.AttachComponent(e1, T::Make(0, 1));
+    buffer.DetachComponent(e0, T::Make(0, 1));
+
+    commands.Playback(entities);
+
+    REQUIRE(entities.GetOwner(T::Make(0, 1)) == e1);
+    REQUIRE(!entities.GetAnyComponentOfType(e0, T::ComponentTypeId));
+}
+
+namespace {
+using SpawnedId = ComponentId<100>;
+
+// owners of SpawnedId::Make(i, 1) after one frame of systems spawning entities from ParallelFor chunks
+Array<EntityId> SpawnFrame(JobSystem* jobs, i32 workers_num)
+{
+    Entities entities;
+    EntityCommands commands { workers_num };
+
+    // recycled ids come from the free list, so the spawn order shows in them
+    for (i32 i = 0; i < 100; i++) {
+        EntityId e = entities.Spawn();
+        if (i % 3 == 0) {
+            entities.Destroy(e);
+        }
+    }
+
+    SystemScheduler scheduler;
+    scheduler.commands_ = &commands;
+
+    for (i32 s = 0; s < 2; s++) {
+        scheduler.AddSystem("spawn", SystemAccess {}, [s](SystemContext& context) {
+            i32 first = s * 1002;
+            context.Commands().AttachComponent(context.Commands().Spawn(), SpawnedId::Make(first, 1));
+            context.ParallelFor(1000, 10, [&context, first](i64 begin, i64 end) {
+                EntityCommandBuffer& buffer = context.Commands();
+                for (i64 i = begin; i < end; i++) {
+                    buffer.AttachComponent(buffer.Spawn(), SpawnedId::Make(first + 1 + As<i32>(i), 1));
+                }
+            });
+            context.Commands().AttachComponent(context.Commands().Spawn(), SpawnedId::Make(first + 1001, 1));
+        });
+    }
+
+    scheduler.Run(jobs);
+    commands.Playback(entities);
+
+    Array<EntityId> owners;
+    for (i32 i = 0; i < 2004; i++) {
+        Optional<EntityId> owner = entities.GetOwner(SpawnedId::Make(i, 1));
+        owners.PushBack(owner ? *owner : EntityId {});
+    }
+    return owners;
+}
+}
+
+TEST_CASE("spawned ids don't depend on which worker recorded them", "[ecs]")
+{
+    JobSystem jobs { 3 };
+    Array<EntityId> serial = SpawnFrame(nullptr, jobs.WorkersNum());
+
+    for (i32 run = 0; run < 5; run++) {
+        Array<EntityId> parallel = SpawnFrame(&jobs, jobs.WorkersNum());
+        REQUIRE(parallel.Size() == serial.Size());
+        for (i64 i = 0; i < serial.Size(); i++) {
+            REQUIRE(parallel[i] == serial[i]);
+        }
+    }
+}
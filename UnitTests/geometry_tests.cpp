@@ -0,0 +1,211 @@
+#include "Geometry.h"
+#include "Aabb3DPacket.h"
+#include "random.h"
+#include "catch/catch.hpp"
+
+using namespace Playground;
+
+namespace {
+
+Transform RandomTransform(Rng& rng, bool uniform_scale)
+{
+    Vector3 axis = Vector3 { rng.F32UniformInRange(-1, 1), rng.F32UniformInRange(-1, 1), rng.F32UniformInRange(0.1f, 1) }.normalized();
+    f32 scale = rng.F32UniformInRange(0.5f, 2.f);
+
+    return {
+        .translation = { rng.F32UniformInRange(-10, 10), rng.F32UniformInRange(-10, 10), rng.F32UniformInRange(-10, 10) },
+        .rotation = Quaternion::rotation(Rad { rng.F32UniformInRange(-3, 3) }, axis),
+        .scale = uniform_scale ? Vector3 { scale } : Vector3 { scale, rng.F32UniformInRange(0.5f, 2.f), rng.F32UniformInRange(0.5f, 2.f) }
+    };
+}
+
+bool IsClose(Vector3 a, Vector3 b)
+{
+    return (a - b).length() < 0.001f;
+}
+
+}
+
+TEST_CASE("batched transform kernels match the scalar versions", "[geometry]")
+{
+    Rng rng;
+
+    // not a multiple of any lane count
+    constexpr i64 N = 103;
+
+    Transform transform = RandomTransform(rng, false);
+
+    Array<Vector3> points;
+    Array<f32> xs, ys, zs;
+    for (i64 i = 0; i < N; i++) {
+        points.PushBack({ rng.F32UniformInRange(-5, 5), rng.F32UniformInRange(-5, 5), rng.F32UniformInRange(-5, 5) });
+        xs.PushBack(points[i].x());
+        ys.PushBack(points[i].y());
+        zs.PushBack(points[i].z());
+    }
+
+    Array<Vector3> transformed;
+    transformed.Resize(N);
+    TransformPoints(transform, { .data = points.Data(), .num = N }, { .data = transformed.Data(), .num = N });
+    TransformPoints(transform, { .data = xs.Data(), .num = N }, { .data = ys.Data(), .num = N }, { .data = zs.Data(), .num = N });
+
+    for (i64 i = 0; i < N; i++) {
+        Vector3 expected = transform.TransformVector(points[i]);
+        REQUIRE(IsClose(transformed[i], expected));
+        REQUIRE(IsClose({ xs[i], ys[i], zs[i] }, expected));
+    }
+
+    Array<Transform> parents, locals;
+    for (i64 i = 0; i < N; i++) {
+        parents.PushBack(RandomTransform(rng, true));
+        locals.PushBack(RandomTransform(rng, true));
+    }
+
+    Array<Transform> combined;
+    combined.Resize(N);
+    CombineTransforms({ .data = parents.Data(), .num = N }, { .data = locals.Data(), .num = N }, { .data = combined.Data(), .num = N });
+
+    Array<Matrix4> matrices;
+    matrices.Resize(N);
+    TransformsToMatrices({ .data = parents.Data(), .num = N }, { .data = matrices.Data(), .num = N });
+
+    for (i64 i = 0; i < N; i++) {
+        Transform expected = parents[i].Combine(locals[i]);
+        REQUIRE(IsClose(combined[i].translation, expected.translation));
+        REQUIRE(IsClose(combined[i].rotation.vector(), expected.rotation.vector()));
+        REQUIRE(combined[i].rotation.scalar() == Approx(expected.rotation.scalar()).margin(0.001f));
+        REQUIRE(IsClose(combined[i].scale, expected.scale));
+
+        Matrix4 expected_matrix = parents[i].ToMatrix();
+        for (i32 c = 0; c < 4; c++) {
+            REQUIRE((matrices[i][c] - expected_matrix[c]).length() < 0.001f);
+        }
+    }
+}
+
+TEST_CASE("batched obb bounds match Obb3D::GetAabb", "[geometry]")
+{
+    Rng rng;
+    constexpr i64 N = 37;
+
+    Matrix4 transform = RandomTransform(rng, false).ToMatrix();
+
+    Array<Obb3D> boxes;
+    for (i64 i = 0; i < N; i++) {
+        Transform orientation = RandomTransform(rng, true);
+        boxes.PushBack({
+            .pos = orientation.translation,
+            .axis100 = orientation.rotation.transformVector(Vector3::xAxis()),
+            .axis010 = orientation.rotation.transformVector(Vector3::yAxis()),
+            .axis001 = orientation.rotation.transformVector(Vector3::zAxis()),
+            .half_size = { rng.F32UniformInRange(0.1f, 3), rng.F32UniformInRange(0.1f, 3), rng.F32UniformInRange(0.1f, 3) } });
+    }
+
+    Array<Aabb3D> bounds;
+    bounds.Resize(N);
+    ComputeAabbs({ .data = boxes.Data(), .num = N }, transform, { .data = bounds.Data(), .num = N });
+
+    for (i64 i = 0; i < N; i++) {
+        Aabb3D expected = boxes[i].GetAabb(transform);
+        REQUIRE(IsClose(bounds[i].vec_min, expected.vec_min));
+        REQUIRE(IsClose(bounds[i].vec_max, expected.vec_max));
+    }
+}
+
+TEST_CASE("frustum culling keeps boxes in view", "[geometry]")
+{
+    Matrix4 view = LookAtLh({ 0, 0, 1 }, {}, { 0, 1, 0 });
+    Matrix4 projection = PerspectiveFovLh(1.f, Math::Constants<f32>::piHalf(), 0.1f, 100.f);
+    ViewFrustum frustum = ViewFrustum::FromMatrix(projection * view);
+
+    REQUIRE(frustum.Intersects(Aabb3D::From({ -1, -1, 5 }, { 1, 1, 6 })));
+    REQUIRE(!frustum.Intersects(Aabb3D::From({ -1, -1, -6 }, { 1, 1, -5 })));
+    REQUIRE(!frustum.Intersects(Aabb3D::From({ -1, -1, 200 }, { 1, 1, 201 })));
+    REQUIRE(!frustum.Intersects(Aabb3D::From({ 20, -1, 5 }, { 21, 1, 6 })));
+    // straddling the right plane
+    REQUIRE(frustum.Intersects(Aabb3D::From({ 4, -1, 5 }, { 6, 1, 6 })));
+
+    Rng rng;
+    constexpr i64 N = 1000;
+    Array<Aabb3D> boxes;
+    for (i64 i = 0; i < N; i++) {
+        Vector3 p { rng.F32UniformInRange(-50, 50), rng.F32UniformInRange(-50, 50), rng.F32UniformInRange(-50, 150) };
+        boxes.PushBack(Aabb3D::From(p, p + Vector3 { rng.F32UniformInRange(0.1f, 5) }));
+    }
+
+    Bitarray visible;
+    CullAabbs(frustum, { .data = boxes.Data(), .num = N }, visible);
+
+    i64 visible_num = 0;
+    for (i64 i = 0; i < N; i++) {
+        REQUIRE(visible.GetBit(i) == frustum.Intersects(boxes[i]));
+        visible_num += visible.GetBit(i);
+    }
+    REQUIRE(visible_num > 0);
+    REQUIRE(visible_num < N);
+}
+
+TEMPLATE_TEST_CASE("aabb packets match scalar aabb queries", "[geometry]", Aabb3Dx4, Aabb3Dx8)
+{
+    Rng rng;
+
+    auto random_box = [&rng]() {
+        Vector3 p { rng.F32UniformInRange(-5, 5), rng.F32UniformInRange(-5, 5), rng.F32UniformInRange(-5, 5) };
+        return Aabb3D::From(p, p + Vector3 { rng.F32UniformInRange(0.1f, 4), rng.F32UniformInRange(0.1f, 4), rng.F32UniformInRange(0.1f, 4) });
+    };
+
+    for (i32 iteration = 0; iteration < 100; iteration++) {
+        // partially filled packets leave empty lanes
+        Aabb3D boxes[TestType::WIDTH];
+        i64 num = rng.I32UniformInRange(1, TestType::WIDTH);
+        for (i64 i = 0; i < num; i++) {
+            boxes[i] = random_box();
+        }
+
+        TestType packet = TestType::Load(boxes, num);
+        Aabb3D other = random_box();
+        Vector3 point { rng.F32UniformInRange(-6, 6), rng.F32UniformInRange(-6, 6), rng.F32UniformInRange(-6, 6) };
+
+        i32 contains_point = MoveMask(packet.Contains(point));
+        i32 contains_box = MoveMask(packet.Contains(other));
+        i32 overlaps = MoveMask(packet.Overlaps(other));
+        TestType united = packet.Union(other);
+
+        Vector3 origin { rng.F32UniformInRange(-8, 8), rng.F32UniformInRange(-8, 8), -8.f };
+        Vector3 inv_direction = 1.f / Vector3 { rng.F32UniformInRange(-0.5f, 0.5f), rng.F32UniformInRange(-0.5f, 0.5f), 1.f }.normalized();
+        decltype(packet.min_x) t_enter;
+        i32 hits = MoveMask(packet.RayIntersection(origin, inv_direction, decltype(packet.min_x)::Splat(20.f), t_enter));
+
+        Aabb3D bounds = Aabb3D::Empty();
+        for (i64 i = 0; i < num; i++) {
+            bounds = bounds.Union(boxes[i]);
+        }
+        REQUIRE(packet.Bounds() == bounds);
+
+        for (i32 i = 0; i < TestType::WIDTH; i++) {
+            if (i >= num) {
+                REQUIRE(!(contains_point & (1 << i)));
+                REQUIRE(!(overlaps & (1 << i)));
+                REQUIRE(!(hits & (1 << i)));
+                continue;
+            }
+
+            REQUIRE(packet.Get(i) == boxes[i]);
+            REQUIRE(bool(contains_point & (1 << i)) == boxes[i].Contains(point));
+            REQUIRE(bool(contains_box & (1 << i)) == boxes[i].Contains(other));
+            REQUIRE(bool(overlaps & (1 << i)) == boxes[i].Overlaps(other));
+            REQUIRE(united.Get(i) == boxes[i].Union(other));
+            Optional<f32> t = boxes[i].RayIntersection(origin, inv_direction, 20.f);
+            REQUIRE(bool(hits & (1 << i)) == bool(t));
+            if (t) {
+                REQUIRE(t_enter.Get(i) == Approx(*t));
+            }
+            REQUIRE(packet.Distance(point).Get(i) == Approx(boxes[i].Distance(point)).margin(0.0001f));
+            REQUIRE(packet.Area().Get(i) == Approx(boxes[i].Area()));
+            REQUIRE(packet.Volume().Get(i) == Approx(boxes[i].Volume()));
+        }
+
+        packet.Set(0, other);
+        REQUIRE(packet.Get(0) == other);
+    }
+}
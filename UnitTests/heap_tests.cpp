@@ -0,0 +1,51 @@
+#include "Heap.h"
+#include "random.h"
+#include "catch/catch.hpp"
+
+using namespace Playground;
+
+TEST_CASE("heap pops elements in order", "[heap]")
+{
+    Rng rng;
+    Heap<i32> min_heap;
+    Heap<i32, std::greater<i32>> max_heap;
+
+    Array<i32> values;
+    for (i32 i = 0; i < 1000; i++) {
+        i32 v = rng.I32UniformInRange(-100, 100);
+        values.PushBack(v);
+        min_heap.Push(v);
+        max_heap.Push(v);
+    }
+
+    REQUIRE(min_heap.Size() == 1000);
+
+    i32 previous_min = min_heap.Pop();
+    i32 previous_max = max_heap.Pop();
+    while (!min_heap.Empty()) {
+        i32 next_min = min_heap.Pop();
+        i32 next_max = max_heap.Pop();
+        REQUIRE(previous_min <= next_min);
+        REQUIRE(previous_max >= next_max);
+        previous_min = next_min;
+        previous_max = next_max;
+    }
+    REQUIRE(max_heap.Empty());
+}
+
+TEST_CASE("heap top can be replaced", "[heap]")
+{
+    Heap<i32> heap;
+    for (i32 i = 0; i < 10; i++) {
+        heap.Push(i);
+    }
+
+    heap.ReplaceTop(100);
+    REQUIRE(heap.Top() == 1);
+    REQUIRE(heap.Size() == 10);
+
+    for (i32 i = 1; i < 10; i++) {
+        REQUIRE(heap.Pop() == i);
+    }
+    REQUIRE(heap.Pop() == 100);
+}
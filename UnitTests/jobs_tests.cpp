@@ -0,0 +1,190 @@
+#include "Jobs.h"
+#include "catch/catch.hpp"
+
+using namespace Playground;
+
+TEST_CASE("parallel for visits every index once", "[jobs]")
+{
+    JobSystem jobs { 3 };
+
+    Array<i32> visited;
+    visited.Resize(10000);
+
+    jobs.ParallelFor(visited.Size(), 64, [&visited](i64 begin, i64 end) {
+        for (i64 i = begin; i < end; i++) {
+            visited[i]++;
+        }
+    });
+
+    for (i64 i = 0; i < visited.Size(); i++) {
+        REQUIRE(visited[i] == 1);
+    }
+}
+
+TEST_CASE("nested parallel for doesn't deadlock", "[jobs]")
+{
+    JobSystem jobs { 2 };
+
+    std::atomic<i64> sum = 0;
+
+    jobs.ParallelFor(16, 1, [&jobs, &sum](i64 begin, i64 end) {
+        jobs.ParallelFor(100, 10, [&sum](i64 begin, i64 end) {
+            sum += end - begin;
+        });
+    });
+
+    REQUIRE(sum == 1600);
+}
+
+TEST_CASE("job system without threads runs on the caller", "[jobs]")
+{
+    JobSystem jobs { 0 };
+    REQUIRE(jobs.WorkersNum() == 1);
+
+    i64 sum = 0;
+    jobs.ParallelFor(1000, 7, [&sum](i64 begin, i64 end) {
+        sum += end - begin;
+    });
+
+    REQUIRE(sum == 1000);
+}
+
+TEST_CASE("deque hands every job out once under stealing", "[jobs]")
+{
+    // small ring so it grows while thieves read it
+    JobDeque deque { 4 };
+
+    constexpr i64 N = 200000;
+    Array<i32> taken;
+    taken.Resize(N);
+    std::atomic<i64> taken_num = 0;
+    std::atomic<bool> done = false;
+
+    auto take = [&](Job const& job) {
+        std::atomic_ref<i32>(taken[job.begin]).fetch_add(1, std::memory_order_relaxed);
+        taken_num.fetch_add(1, std::memory_order_relaxed);
+    };
+
+    Array<Box<std::thread>> thieves;
+    for (i32 i = 0; i < 3; i++) {
+        thieves.PushBackRvalueRef(Box<std::thread> { new std::thread { [&]() {
+            while (!done.load(std::memory_order_acquire)) {
+                if (Optional<Job> job = deque.Steal()) {
+                    take(*job);
+                }
+            }
+        } } });
+    }
+
+    for (i64 i = 0; i < N; i++) {
+        deque.Push({ .begin = i });
+        // keeps the deque short now and then so the owner and thieves race for the last job
+        if (i % 3 == 0) {
+            if (Optional<Job> job = deque.Pop()) {
+                take(*job);
+            }
+        }
+    }
+    while (Optional<Job> job = deque.Pop()) {
+        take(*job);
+    }
+    while (taken_num.load(std::memory_order_acquire) < N) {
+        std::this_thread::yield();
+    }
+    done.store(true, std::memory_order_release);
+    for (Box<std::thread>& thief : thieves) {
+        thief->join();
+    }
+
+    REQUIRE(taken_num == N);
+    for (i64 i = 0; i < N; i++) {
+        REQUIRE(taken[i] == 1);
+    }
+}
+
+TEST_CASE("jobs submitted after a counter wait for it", "[jobs]")
+{
+    JobSystem jobs { 3 };
+
+    struct Stages {
+        std::atomic<i32> first_done = 0;
+        std::atomic<i32> second_saw_all = 0;
+    } stages;
+
+    JobFunction first = [](void* data, i64, i64) {
+        std::this_thread::yield();
+        static_cast<Stages*>(data)->first_done.fetch_add(1);
+    };
+    JobFunction second = [](void* data, i64, i64) {
+        Stages& stages = *static_cast<Stages*>(data);
+        stages.second_saw_all.fetch_add(stages.first_done.load() == 64);
+    };
+
+    for (i32 frame = 0; frame < 20; frame++) {
+        stages.first_done = 0;
+        stages.second_saw_all = 0;
+
+        JobCounter first_counter;
+        JobCounter second_counter;
+        Array<Job> batch;
+        for (i32 i = 0; i < 64; i++) {
+            batch.PushBack({ .function = first, .data = &stages });
+        }
+        jobs.Submit({ .data = batch.Data(), .num = batch.Size() }, first_counter);
+        for (i32 i = 0; i < 16; i++) {
+            jobs.SubmitAfter({ .function = second, .data = &stages }, second_counter, first_counter);
+        }
+
+        jobs.Wait(second_counter);
+        REQUIRE(first_counter.IsDone());
+        REQUIRE(stages.second_saw_all == 16);
+    }
+
+    // a finished dependency doesn't hold the job
+    JobCounter done;
+    JobCounter counter;
+    jobs.SubmitAfter({ .function = second, .data = &stages }, counter, done);
+    jobs.Wait(counter);
+    REQUIRE(stages.second_saw_all == 17);
+}
+
+TEST_CASE("parallel for over an array passes chunks", "[jobs]")
+{
+    JobSystem jobs { 2 };
+
+    Array<i32> values;
+    for (i32 i = 0; i < 1000; i++) {
+        values.PushBack(i);
+    }
+
+    std::atomic<i64> chunks = 0;
+    std::atomic<i64> short_chunks = 0;
+    jobs.ParallelFor(values, 100, [&](Slice<i32> chunk) {
+        short_chunks += chunk.num != 100;
+        for (i64 i = 0; i < chunk.num; i++) {
+            chunk[i] *= 2;
+        }
+        chunks++;
+    });
+
+    REQUIRE(chunks == 10);
+    REQUIRE(short_chunks == 0);
+    for (i32 i = 0; i < 1000; i++) {
+        REQUIRE(values[i] == 2 * i);
+    }
+}
+
+TEST_CASE("threads outside of the pool can submit and wait", "[jobs]")
+{
+    JobSystem jobs { 2 };
+
+    std::atomic<i64> sum = 0;
+    std::thread outside { [&]() {
+        jobs.ParallelFor(1000, 10, [&sum](i64 begin, i64 end) {
+            sum += end - begin;
+        });
+    } };
+    outside.join();
+
+    REQUIRE(sum == 1000);
+}
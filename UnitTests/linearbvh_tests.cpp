@@ -0,0 +1,189 @@
+#include "LinearBvh.h"
+#include "Jobs.h"
+#include "random.h"
+#include <algorithm>
+#include "catch/catch.hpp"
+
+using namespace Playground;
+
+namespace {
+
+Array<Aabb3D> RandomBoxes(Rng& rng, i32 num, f32 extent)
+{
+    Array<Aabb3D> boxes;
+    for (i32 i = 0; i < num; i++) {
+        Vector3 p { rng.F32UniformInRange(-extent, extent), rng.F32UniformInRange(-extent, extent), rng.F32UniformInRange(-extent, extent) };
+        boxes.PushBack(Aabb3D::From(p, p + Vector3 { rng.F32UniformInRange(0.1f, 2.f), rng.F32UniformInRange(0.1f, 2.f), rng.F32UniformInRange(0.1f, 2.f) }));
+    }
+    return boxes;
+}
+
+// every node contains its subtree, skips line up with the subtree sizes and every box is a leaf once
+void RequireValidTree(LinearBvh const& bvh, Array<Aabb3D>& boxes)
+{
+    REQUIRE(bvh.nodes_.Size() == 2 * boxes.Size() - 1);
+
+    Bitarray seen;
+    seen.Resize(boxes.Size());
+    for (i32 index = 0; index < bvh.nodes_.Size(); index++) {
+        LinearBvh::Node const& node = bvh.nodes_[index];
+        if (node.IsLeaf()) {
+            REQUIRE(node.skip == index + 1);
+            REQUIRE(node.bounds == boxes[node.handle]);
+            REQUIRE_FALSE(seen.GetBit(node.handle));
+            seen.SetBit(node.handle, true);
+            continue;
+        }
+
+        i32 left = index + 1;
+        i32 right = bvh.nodes_[left].skip;
+        REQUIRE(right < node.skip);
+        REQUIRE(bvh.nodes_[right].skip == node.skip);
+        REQUIRE(node.bounds.Contains(bvh.nodes_[left].bounds));
+        REQUIRE(node.bounds.Contains(bvh.nodes_[right].bounds));
+    }
+    REQUIRE(bvh.nodes_[0].skip == bvh.nodes_.Size());
+}
+
+void RequireBruteForceResults(LinearBvh const& bvh, Array<Aabb3D>& boxes, Rng& rng, f32 extent)
+{
+    for (i32 query = 0; query < 100; query++) {
+        Vector3 point { rng.F32UniformInRange(-extent, extent), rng.F32UniformInRange(-extent, extent), rng.F32UniformInRange(-extent, extent) };
+
+        i64 expected_inside = 0;
+        for (Aabb3D box : boxes) {
+            expected_inside += box.Contains(point);
+        }
+        Array<LinearBvh::Handle> inside;
+        bvh.FindAllIntersecting(point, inside);
+        REQUIRE(inside.Size() == expected_inside);
+
+        Aabb3D bounds = Aabb3D::From(point, point + Vector3 { rng.F32UniformInRange(0.5f, 6.f) });
+        Sphere3D sphere { .position = point, .radius = rng.F32UniformInRange(0.5f, 6.f) };
+        i64 expected_overlapping = 0;
+        i64 expected_in_sphere = 0;
+        for (Aabb3D box : boxes) {
+            expected_overlapping += box.Overlaps(bounds);
+            expected_in_sphere += box.Distance(sphere.position) <= sphere.radius;
+        }
+        i64 overlapping = 0;
+        bvh.QueryAabb(bounds, [&](LinearBvh::Handle h) {
+            REQUIRE(boxes[h.index].Overlaps(bounds));
+            overlapping++;
+            return true;
+        });
+        REQUIRE(overlapping == expected_overlapping);
+        i64 in_sphere = 0;
+        bvh.QuerySphere(sphere, [&](LinearBvh::Handle) {
+            in_sphere++;
+            return true;
+        });
+        REQUIRE(in_sphere == expected_in_sphere);
+
+        i32 k = rng.I32UniformInRange(1, 12);
+        f32 max_distance = rng.F32UniformInRange(1.f, 8.f);
+        Array<f32> expected_distances;
+        for (Aabb3D box : boxes) {
+            if (box.Distance(point) <= max_distance) {
+                expected_distances.PushBack(box.Distance(point));
+            }
+        }
+        std::sort(expected_distances.Data(), expected_distances.Data() + expected_distances.Size());
+        Array<LinearBvh::Handle> closest;
+        bvh.FindKClosest(point, k, max_distance, closest);
+        REQUIRE(closest.Size() == Min<i64>(k, expected_distances.Size()));
+        for (i64 i = 0; i < closest.Size(); i++) {
+            REQUIRE(boxes[closest[i].index].Distance(point) == expected_distances[i]);
+        }
+
+        Vector3 direction = Vector3 { rng.F32UniformInRange(-1, 1), rng.F32UniformInRange(-1, 1), rng.F32UniformInRange(-1, 1) }.normalized();
+        Vector3 inv_direction = 1.f / direction;
+        Optional<f32> expected_t;
+        for (Aabb3D box : boxes) {
+            if (Optional<f32> t = box.RayIntersection(point, inv_direction, 30.f); t && (!expected_t || *t < *expected_t)) {
+                expected_t = t;
+            }
+        }
+        Optional<LinearBvh::RayHit> hit = bvh.RayCastClosest(point, direction, 30.f);
+        REQUIRE(bool(hit) == bool(expected_t));
+        if (hit) {
+            REQUIRE(hit->t == *expected_t);
+        }
+    }
+}
+
+}
+
+TEST_CASE("linear bvh queries match brute force", "[linear_bvh]")
+{
+    Rng rng;
+    Array<Aabb3D> boxes = RandomBoxes(rng, 3000, 20.f);
+
+    LinearBvh bvh;
+    bvh.Build({ .data = boxes.Data(), .num = boxes.Size() });
+
+    RequireValidTree(bvh, boxes);
+    RequireBruteForceResults(bvh, boxes, rng, 22.f);
+    // Morton splits halve the space, the depth stays around log2(n) plus the grid's 30 bits at most
+    REQUIRE(bvh.GetDepth() < 40);
+}
+
+TEST_CASE("parallel linear bvh build matches the serial one", "[linear_bvh]")
+{
+    Rng rng;
+    JobSystem jobs(3);
+    Array<Aabb3D> boxes = RandomBoxes(rng, 50000, 100.f);
+
+    LinearBvh serial;
+    serial.Build({ .data = boxes.Data(), .num = boxes.Size() });
+    LinearBvh parallel;
+    parallel.Build({ .data = boxes.Data(), .num = boxes.Size() }, &jobs);
+
+    REQUIRE(parallel.nodes_.Size() == serial.nodes_.Size());
+    for (i64 i = 0; i < serial.nodes_.Size(); i++) {
+        REQUIRE(parallel.nodes_[i].skip == serial.nodes_[i].skip);
+        REQUIRE(parallel.nodes_[i].handle == serial.nodes_[i].handle);
+        REQUIRE(parallel.nodes_[i].bounds == serial.nodes_[i].bounds);
+    }
+    RequireValidTree(parallel, boxes);
+}
+
+TEST_CASE("linear bvh handles degenerate inputs", "[linear_bvh]")
+{
+    Rng rng;
+    LinearBvh bvh;
+
+    bvh.Build({ .data = nullptr, .num = 0 });
+    REQUIRE(bvh.Empty());
+    REQUIRE(bvh.GetDepth() == 0);
+    Array<LinearBvh::Handle> out;
+    REQUIRE_FALSE(bvh.FindAllIntersecting(Vector3 { 0.f }, out));
+    REQUIRE_FALSE(bvh.RayCastClosest(Vector3 { 0.f }, Vector3 { 1.f, 0.f, 0.f }, 10.f));
+
+    // every centre in one spot, the Morton codes are all equal
+    Array<Aabb3D> stacked;
+    for (i32 i = 0; i < 100; i++) {
+        f32 size = rng.F32UniformInRange(0.1f, 2.f);
+        stacked.PushBack(Aabb3D::From(Vector3 { -size }, Vector3 { size }));
+    }
+    bvh.Build({ .data = stacked.Data(), .num = stacked.Size() });
+    RequireValidTree(bvh, stacked);
+    REQUIRE(bvh.GetDepth() <= 8);
+    RequireBruteForceResults(bvh, stacked, rng, 3.f);
+
+    // a flat layer of tiles
+    Array<Aabb3D> tiles;
+    for (i32 x = 0; x < 40; x++) {
+        for (i32 z = 0; z < 40; z++) {
+            tiles.PushBack(Aabb3D::From(Vector3 { f32(x), 0.f, f32(z) }, Vector3 { x + 1.f, 0.f, z + 1.f }));
+        }
+    }
+    bvh.Build({ .data = tiles.Data(), .num = tiles.Size() });
+    RequireValidTree(bvh, tiles);
+    RequireBruteForceResults(bvh, tiles, rng, 40.f);
+
+    Array<Aabb3D> single = RandomBoxes(rng, 1, 5.f);
+    bvh.Build({ .data = single.Data(), .num = 1 });
+    RequireValidTree(bvh, single);
+    REQUIRE(bvh.GetDepth() == 1);
+}
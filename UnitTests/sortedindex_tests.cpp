@@ -0,0 +1,60 @@
+#include "SortedIndex.h"
+#include "random.h"
+#include <algorithm>
+#include "catch/catch.hpp"
+
+using namespace Playground;
+
+TEMPLATE_TEST_CASE("sorted index lookups match lower bound", "[sorted_index]", i32, u64, f32)
+{
+    Rng rng;
+
+    // sizes around full levels of the implicit tree
+    for (i32 num : { 0, 1, 2, 3, 7, 15, 16, 17, 100, 1023, 1024, 1025, 50000 }) {
+        Array<TestType> keys;
+        for (i32 i = 0; i < num; i++) {
+            keys.PushBack(TestType(rng.I32UniformInRange(0, 2 * num)));
+        }
+        std::sort(keys.Data(), keys.Data() + keys.Size());
+        TestType const* begin = keys.Data();
+        TestType const* end = keys.Data() + keys.Size();
+
+        SortedIndex<TestType> index;
+        index.Build({ .data = begin, .num = keys.Size() });
+        REQUIRE(index.Size() == num);
+        REQUIRE(reinterpret_cast<uintptr_t>(index._Keys()) % SortedIndex<TestType>::CACHE_LINE == 0);
+
+        for (i32 i = 0; i < 2000; i++) {
+            TestType value = TestType(rng.I32UniformInRange(-1, 2 * num + 2));
+            i64 expected = std::lower_bound(begin, end, value) - begin;
+            REQUIRE(index.LowerBound(value) == expected);
+
+            Optional<i64> found = index.Find(value);
+            REQUIRE(bool(found) == std::binary_search(begin, end, value));
+            if (found) {
+                REQUIRE(keys[*found] == value);
+            }
+        }
+    }
+}
+
+TEST_CASE("sorted index copies keep their keys on a cache line", "[sorted_index]")
+{
+    Array<i32> keys;
+    for (i32 i = 0; i < 1000; i++) {
+        keys.PushBack(3 * i);
+    }
+
+    SortedIndex<i32> index;
+    index.Build({ .data = keys.Data(), .num = keys.Size() });
+
+    SortedIndex<i32> copy = index;
+    SortedIndex<i32> moved = std::move(index);
+    for (SortedIndex<i32>* other : { &copy, &moved }) {
+        REQUIRE(reinterpret_cast<uintptr_t>(other->_Keys()) % SortedIndex<i32>::CACHE_LINE == 0);
+        for (i32 i = 0; i < 1000; i++) {
+            REQUIRE(other->LowerBound(3 * i - 1) == i);
+            REQUIRE(other->Find(3 * i) == Optional<i64> { i });
+        }
+    }
+}
@@ -0,0 +1,150 @@
+#include "SpatialHashGrid.h"
+#include "random.h"
+#include <algorithm>
+#include "catch/catch.hpp"
+
+using namespace Playground;
+
+namespace {
+
+Array<Aabb3D> RandomBoxes(Rng& rng, i32 num, f32 extent, f32 max_size)
+{
+    Array<Aabb3D> boxes;
+    for (i32 i = 0; i < num; i++) {
+        Vector3 p { rng.F32UniformInRange(-extent, extent), rng.F32UniformInRange(-extent, extent), rng.F32UniformInRange(-extent, extent) };
+        boxes.PushBack(Aabb3D::From(p, p + Vector3 { rng.F32UniformInRange(0.1f, max_size), rng.F32UniformInRange(0.1f, max_size), rng.F32UniformInRange(0.1f, max_size) }));
+    }
+    return boxes;
+}
+
+void RequireBruteForceResults(SpatialHashGrid const& grid, Array<Aabb3D>& boxes, Rng& rng, f32 extent)
+{
+    for (i32 query = 0; query < 200; query++) {
+        Vector3 point { rng.F32UniformInRange(-extent, extent), rng.F32UniformInRange(-extent, extent), rng.F32UniformInRange(-extent, extent) };
+
+        i64 expected_inside = 0;
+        for (Aabb3D box : boxes) {
+            expected_inside += box.Contains(point);
+        }
+        Array<SpatialHashGrid::Handle> inside;
+        grid.FindAllIntersecting(point, inside);
+        REQUIRE(inside.Size() == expected_inside);
+        for (i64 i = 0; i < inside.Size(); i++) {
+            REQUIRE(boxes[inside[i].index].Contains(point));
+        }
+
+        Aabb3D bounds = Aabb3D::From(point, point + Vector3 { rng.F32UniformInRange(0.5f, 10.f) });
+        Sphere3D sphere { .position = point, .radius = rng.F32UniformInRange(0.5f, 10.f) };
+        i64 expected_overlapping = 0;
+        i64 expected_in_sphere = 0;
+        for (Aabb3D box : boxes) {
+            expected_overlapping += box.Overlaps(bounds);
+            expected_in_sphere += box.Distance(sphere.position) <= sphere.radius;
+        }
+
+        i64 overlapping = 0;
+        grid.QueryAabb(bounds, [&](SpatialHashGrid::Handle h) {
+            REQUIRE(boxes[h.index].Overlaps(bounds));
+            overlapping++;
+            return true;
+        });
+        REQUIRE(overlapping == expected_overlapping);
+
+        i64 in_sphere = 0;
+        grid.QuerySphere(sphere, [&](SpatialHashGrid::Handle) {
+            in_sphere++;
+            return true;
+        });
+        REQUIRE(in_sphere == expected_in_sphere);
+
+        i32 k = rng.I32UniformInRange(1, 12);
+        f32 max_distance = rng.F32UniformInRange(1.f, 2.f * extent);
+        Array<f32> expected_distances;
+        for (Aabb3D box : boxes) {
+            if (box.Distance(point) <= max_distance) {
+                expected_distances.PushBack(box.Distance(point));
+            }
+        }
+        std::sort(expected_distances.Data(), expected_distances.Data() + expected_distances.Size());
+
+        Array<SpatialHashGrid::Handle> closest;
+        grid.FindKClosest(point, k, max_distance, closest);
+        REQUIRE(closest.Size() == Min<i64>(k, expected_distances.Size()));
+        for (i64 i = 0; i < closest.Size(); i++) {
+            REQUIRE(boxes[closest[i].index].Distance(point) == expected_distances[i]);
+        }
+        REQUIRE(bool(grid.FindClosest(point, max_distance)) == (expected_distances.Size() > 0));
+    }
+}
+
+}
+
+TEST_CASE("spatial hash grid queries match brute force", "[spatial_hash_grid]")
+{
+    Rng rng;
+    SpatialHashGrid grid;
+    grid.cell_size_ = 2.f;
+
+    Array<Aabb3D> boxes = RandomBoxes(rng, 2000, 30.f, 2.f);
+    grid.Rebuild({ .data = boxes.Data(), .num = boxes.Size() });
+    REQUIRE(grid.sorted_handles_.Size() == boxes.Size());
+
+    RequireBruteForceResults(grid, boxes, rng, 35.f);
+
+    SECTION("rebuilt after moving")
+    {
+        for (i32 frame = 0; frame < 5; frame++) {
+            for (Aabb3D& box : boxes) {
+                box = box + Vector3 { rng.F32UniformInRange(-3, 3), rng.F32UniformInRange(-3, 3), rng.F32UniformInRange(-3, 3) };
+            }
+            grid.Rebuild({ .data = boxes.Data(), .num = boxes.Size() });
+        }
+        RequireBruteForceResults(grid, boxes, rng, 35.f);
+    }
+
+    SECTION("a few objects larger than the cells")
+    {
+        boxes.PushBack(Aabb3D::From(Vector3 { -20.f }, Vector3 { 5.f }));
+        boxes.PushBack(Aabb3D::From(Vector3 { 10.f, -40.f, 0.f }, Vector3 { 12.f, 40.f, 2.f }));
+        grid.Rebuild({ .data = boxes.Data(), .num = boxes.Size() });
+        RequireBruteForceResults(grid, boxes, rng, 35.f);
+    }
+
+    SECTION("sparse objects far apart")
+    {
+        Array<Aabb3D> sparse = RandomBoxes(rng, 50, 1000.f, 2.f);
+        grid.Rebuild({ .data = sparse.Data(), .num = sparse.Size() });
+        RequireBruteForceResults(grid, sparse, rng, 1000.f);
+    }
+}
+
+TEST_CASE("spatial hash grid cells are contiguous", "[spatial_hash_grid]")
+{
+    Rng rng;
+    SpatialHashGrid grid;
+    grid.cell_size_ = 4.f;
+
+    Array<Aabb3D> boxes = RandomBoxes(rng, 500, 20.f, 1.f);
+    grid.Rebuild({ .data = boxes.Data(), .num = boxes.Size() });
+
+    i32 next = 0;
+    for (SpatialHashGrid::Cell cell : grid.cells_) {
+        REQUIRE(cell.begin == next);
+        REQUIRE(cell.num > 0);
+        next += cell.num;
+
+        Vector3i cell_index = grid._CellOf(grid.sorted_bounds_[cell.begin].Center());
+        for (i32 i = cell.begin; i < cell.begin + cell.num; i++) {
+            REQUIRE(grid._CellOf(grid.sorted_bounds_[i].Center()) == cell_index);
+            REQUIRE(grid.sorted_bounds_[i] == boxes[grid.sorted_handles_[i]]);
+        }
+    }
+    REQUIRE(next == boxes.Size());
+    REQUIRE(grid.cell_ids_.Size() == grid.cells_.Size());
+
+    SpatialHashGrid empty;
+    empty.Rebuild({ .data = nullptr, .num = 0 });
+    Array<SpatialHashGrid::Handle> out;
+    REQUIRE_FALSE(empty.FindAllIntersecting(Vector3 { 0.f }, out));
+    REQUIRE_FALSE(empty.FindClosest(Vector3 { 0.f }, 100.f));
+}
@@ -0,0 +1,95 @@
+#include "Systems.h"
+#include "Components.h"
+#include "catch/catch.hpp"
+
+using namespace Playground;
+
+namespace {
+struct Position {
+    f32 x;
+};
+
+struct Velocity {
+    f32 x;
+};
+
+using PositionId = ComponentId<10>;
+using VelocityId = ComponentId<11>;
+}
+
+TEST_CASE("systems conflict only on writes", "[systems]")
+{
+    SystemAccess read_a = SystemAccess {}.Read<PositionId>();
+    SystemAccess read_a_2 = SystemAccess {}.Read<PositionId>();
+    SystemAccess write_a = SystemAccess {}.Write<PositionId>();
+    SystemAccess write_b = SystemAccess {}.Write<VelocityId>();
+    SystemAccess exclusive = SystemAccess {}.Exclusive();
+
+    REQUIRE(!read_a.ConflictsWith(read_a_2));
+    REQUIRE(read_a.ConflictsWith(write_a));
+    REQUIRE(write_a.ConflictsWith(read_a));
+    REQUIRE(!write_a.ConflictsWith(write_b));
+    REQUIRE(exclusive.ConflictsWith(read_a));
+}
+
+TEST_CASE("scheduler orders conflicting systems by registration", "[systems]")
+{
+    SystemScheduler scheduler;
+
+    scheduler.AddSystem("a", SystemAccess {}.Write<PositionId>(), [](SystemContext&) {});
+    scheduler.AddSystem("b", SystemAccess {}.Write<VelocityId>(), [](SystemContext&) {});
+    scheduler.AddSystem("c", SystemAccess {}.Read<PositionId>().Read<VelocityId>(), [](SystemContext&) {});
+    scheduler.AddSystem("d", SystemAccess {}.Read<PositionId>(), [](SystemContext&) {});
+
+    scheduler.BuildGraph();
+
+    REQUIRE(scheduler.nodes_[0]->dependencies_num == 0);
+    REQUIRE(scheduler.nodes_[1]->dependencies_num == 0);
+    REQUIRE(scheduler.nodes_[2]->dependencies_num == 2);
+    REQUIRE(scheduler.nodes_[3]->dependencies_num == 1);
+    REQUIRE(scheduler.nodes_[0]->dependents.Contains(2));
+    REQUIRE(scheduler.nodes_[0]->dependents.Contains(3));
+    REQUIRE(scheduler.nodes_[1]->dependents.Contains(2));
+}
+
+TEST_CASE("parallel frame matches serial frame", "[systems]")
+{
+    DenseComponentArray<PositionId, Position> positions;
+    DenseComponentArray<VelocityId, Velocity> velocities;
+
+    for (i32 i = 0; i < 5000; i++) {
+        positions.AtMut<0>(positions.Add()) = { .x = As<f32>(i) };
+        velocities.AtMut<0>(velocities.Add()) = { .x = 1.f };
+    }
+
+    SystemScheduler scheduler;
+
+    scheduler.AddSystem("accelerate", SystemAccess {}.Write<VelocityId>(), [&velocities](SystemContext& context) {
+        context.ForEachChunk(velocities, 256, [&velocities](i64 begin, i64 end) {
+            Slice<Velocity> v = velocities.DataSlice<0>();
+            for (i64 i = begin; i < end; i++) {
+                v[i].x *= 2.f;
+            }
+        });
+    });
+
+    scheduler.AddSystem("integrate", SystemAccess {}.Read<VelocityId>().Write<PositionId>(), [&positions, &velocities](SystemContext& context) {
+        context.ForEachChunk(positions, 256, [&positions, &velocities](i64 begin, i64 end) {
+            Slice<Position> p = positions.DataSlice<0>();
+            Slice<Velocity> v = velocities.DataSlice<0>();
+            for (i64 i = begin; i < end; i++) {
+                p[i].x += v[i].x;
+            }
+        });
+    });
+
+    JobSystem jobs { 3 };
+    scheduler.Run(&jobs);
+    scheduler.Run(nullptr);
+
+    // two frames, velocity doubled before each integration
+    Slice<Position> p = positions.DataSlice<0>();
+    for (i64 i = 0; i < p.num; i++) {
+        REQUIRE(p[i].x == As<f32>(i) + 2.f + 4.f);
+    }
+}
@@ -0,0 +1,175 @@
+#include "Task.h"
+#include "catch/catch.hpp"
+
+using namespace Playground;
+
+namespace {
+Task<i32> Add(i32 a, i32 b)
+{
+    co_return a + b;
+}
+
+Task<i32> SumOfAdds()
+{
+    i32 first = co_await Add(1, 2);
+    i32 second = co_await Add(3, 4);
+    co_return first + second;
+}
+
+Task<i64> SumOnWorker(JobSystem& jobs, i64 num)
+{
+    co_await SwitchTo(jobs);
+
+    i64 sum = 0;
+    for (i64 i = 0; i < num; i++) {
+        sum += i;
+    }
+    co_return sum;
+}
+
+Task<i64> SumOfStartedTasks(JobSystem& jobs, std::atomic<i32>& off_loop)
+{
+    std::thread::id loop_thread = std::this_thread::get_id();
+
+    Array<Box<Task<i64>>> tasks;
+    for (i32 i = 0; i < 200; i++) {
+        tasks.PushBackRvalueRef(Box<Task<i64>> { new Task<i64> { SumOnWorker(jobs, i) } });
+        tasks[i]->Start();
+    }
+
+    i64 sum = 0;
+    for (Box<Task<i64>>& task : tasks) {
+        sum += co_await *task;
+        if (std::this_thread::get_id() != loop_thread) {
+            off_loop++;
+        }
+    }
+    co_return sum;
+}
+
+Task<void> WaitForFlag(std::atomic<bool>& flag, std::atomic<i32>& off_loop)
+{
+    std::thread::id loop_thread = std::this_thread::get_id();
+    co_await PollUntil([&flag]() { return flag.load(); });
+    if (std::this_thread::get_id() != loop_thread) {
+        off_loop++;
+    }
+}
+
+Task<void> WaitForFlagBlocking(std::atomic<bool>& flag, std::atomic<i32>& waits)
+{
+    co_await PollUntil([&flag]() { return flag.load(); }, [&flag, &waits]() {
+        waits++;
+        flag.wait(false);
+    });
+}
+
+Task<i32> HopBackToLoop(JobSystem& jobs, TaskLoop& loop, std::atomic<i32>& on_loop)
+{
+    co_await SwitchTo(jobs);
+    co_await loop.Schedule();
+    if (TaskLoop::Current() == &loop) {
+        on_loop++;
+    }
+    co_return 5;
+}
+
+Task<i64> AwaitOnWorker(JobSystem& jobs)
+{
+    co_await SwitchTo(jobs);
+
+    Task<i64> inner = SumOnWorker(jobs, 100);
+    inner.Start();
+    Task<i64> other = SumOnWorker(jobs, 10);
+    co_return co_await inner + co_await other;
+}
+}
+
+TEST_CASE("awaiting tasks that haven't started runs them in place", "[tasks]")
+{
+    TaskLoop loop;
+    REQUIRE(loop.Run(SumOfAdds()) == 10);
+    REQUIRE(TaskLoop::Current() == nullptr);
+}
+
+TEST_CASE("started tasks finish on workers and resume the awaiter on its loop", "[tasks]")
+{
+    JobSystem jobs { 3 };
+    TaskLoop loop { &jobs };
+
+    std::atomic<i32> off_loop = 0;
+    i64 expected = 0;
+    for (i64 i = 0; i < 200; i++) {
+        expected += i * (i - 1) / 2;
+    }
+
+    for (i32 run = 0; run < 20; run++) {
+        REQUIRE(loop.Run(SumOfStartedTasks(jobs, off_loop)) == expected);
+    }
+    REQUIRE(off_loop == 0);
+}
+
+TEST_CASE("tasks awaited on workers continue there", "[tasks]")
+{
+    JobSystem jobs { 2 };
+    TaskLoop loop { &jobs };
+
+    for (i32 run = 0; run < 100; run++) {
+        REQUIRE(loop.Run(AwaitOnWorker(jobs)) == 4950 + 45);
+    }
+}
+
+TEST_CASE("polled awaits resume on the loop", "[tasks]")
+{
+    JobSystem jobs { 2 };
+    TaskLoop loop { &jobs };
+
+    std::atomic<bool> flag = false;
+    std::atomic<i32> off_loop = 0;
+
+    JobCounter counter;
+    jobs.Submit({ .function = [](void* data, i64, i64) { static_cast<std::atomic<bool>*>(data)->store(true); }, .data = &flag }, counter);
+    loop.Run(WaitForFlag(flag, off_loop));
+    jobs.Wait(counter);
+
+    REQUIRE(off_loop == 0);
+}
+
+TEST_CASE("a loop with nothing else to do blocks in the wait of its poll", "[tasks]")
+{
+    JobSystem jobs { 1 };
+    TaskLoop loop { &jobs };
+
+    std::atomic<bool> flag = false;
+    std::atomic<i32> waits = 0;
+
+    std::thread setter([&flag]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        flag = true;
+        flag.notify_all();
+    });
+    loop.Run(WaitForFlagBlocking(flag, waits));
+    setter.join();
+
+    REQUIRE(waits == 1);
+}
+
+TEST_CASE("scheduling returns from a worker to the loop", "[tasks]")
+{
+    JobSystem jobs { 2 };
+    TaskLoop loop { &jobs };
+
+    std::atomic<i32> on_loop = 0;
+    REQUIRE(loop.Run(HopBackToLoop(jobs, loop, on_loop)) == 5);
+    REQUIRE(on_loop == 1);
+}
+
+TEST_CASE("tasks run without worker threads", "[tasks]")
+{
+    JobSystem jobs { 0 };
+    TaskLoop loop { &jobs };
+
+    std::atomic<i32> off_loop = 0;
+    REQUIRE(loop.Run(SumOfStartedTasks(jobs, off_loop)) == 1313400);
+    REQUIRE(off_loop == 0);
+}
@@ -0,0 +1,173 @@
+#include "TransformHierarchy.h"
+#include "catch/catch.hpp"
+
+using namespace Playground;
+
+namespace {
+
+bool IsClose(Vector3 a, Vector3 b)
+{
+    return (a - b).length() < 0.0001f;
+}
+
+// every node is in the child list of its parent and in no other
+void RequireLinksMatchParents(TransformHierarchy& hierarchy)
+{
+    i32 N = As<i32>(hierarchy.Size());
+    Array<i32> listed;
+    listed.Resize(N);
+    for (i32 parent = 0; parent < N; parent++) {
+        i32 prev = -1;
+        for (i32 child = hierarchy.first_child_[parent]; child != -1; child = hierarchy.next_sibling_[child]) {
+            REQUIRE(hierarchy.parents_[child] == parent);
+            REQUIRE(hierarchy.prev_sibling_[child] == prev);
+            listed[child]++;
+            prev = child;
+        }
+    }
+    for (i32 i = 0; i < N; i++) {
+        REQUIRE(listed[i] == (hierarchy.parents_[i] == TransformHierarchy::NO_PARENT ? 0 : 1));
+    }
+}
+
+// a random forest of nodes translated by 1 along x, parents created first
+Array<TransformId> RandomForest(TransformHierarchy& hierarchy, i32 num)
+{
+    u32 state = 12345;
+    Array<TransformId> ids;
+    for (i32 i = 0; i < num; i++) {
+        state = state * 1664525u + 1013904223u;
+        TransformId parent = i && (state >> 8) % 5 ? ids[(state >> 12) % i] : TransformId {};
+        ids.PushBack(hierarchy.Add(Transform::Translation({ 1, 0, 0 }), parent));
+    }
+    return ids;
+}
+
+}
+
+TEST_CASE("transform hierarchy propagates world transforms", "[ecs]")
+{
+    TransformHierarchy hierarchy;
+
+    TransformId root = hierarchy.Add(Transform::Translation({ 1, 0, 0 }));
+    TransformId child = hierarchy.Add(Transform::Translation({ 0, 1, 0 }), root);
+    TransformId grandchild = hierarchy.Add(Transform::Translation({ 0, 0, 1 }), child);
+
+    hierarchy.Propagate();
+
+    REQUIRE(IsClose(hierarchy.GetWorld(root).translation, { 1, 0, 0 }));
+    REQUIRE(IsClose(hierarchy.GetWorld(child).translation, { 1, 1, 0 }));
+    REQUIRE(IsClose(hierarchy.GetWorld(grandchild).translation, { 1, 1, 1 }));
+    REQUIRE(hierarchy.GetParent(grandchild) == child);
+    REQUIRE(!hierarchy.GetParent(root));
+
+    hierarchy.SetLocal(root, Transform::Translation({ 2, 0, 0 }));
+    hierarchy.Propagate();
+
+    REQUIRE(IsClose(hierarchy.GetWorld(grandchild).translation, { 2, 1, 1 }));
+}
+
+TEST_CASE("transform hierarchy only recomputes dirty subtrees", "[ecs]")
+{
+    TransformHierarchy hierarchy;
+
+    TransformId a = hierarchy.Add({});
+    TransformId a_child = hierarchy.Add({}, a);
+    TransformId b = hierarchy.Add({});
+    TransformId b_child = hierarchy.Add({}, b);
+
+    hierarchy.Propagate();
+
+    hierarchy.SetLocal(b, Transform::Translation({ 0, 5, 0 }));
+    hierarchy.Propagate();
+
+    Array<TransformId> changed;
+    hierarchy.ForEachChangedWorld([&](i32 flat_index) { changed.PushBack(hierarchy.GetIdFromFlatIndex(flat_index)); });
+
+    REQUIRE(changed.Size() == 2);
+    REQUIRE(changed.Contains(b));
+    REQUIRE(changed.Contains(b_child));
+    REQUIRE(!changed.Contains(a));
+    REQUIRE(!changed.Contains(a_child));
+
+    hierarchy.Propagate();
+    i32 changed_num = 0;
+    hierarchy.ForEachChangedWorld([&](i32) { changed_num++; });
+    REQUIRE(changed_num == 0);
+}
+
+TEST_CASE("transform hierarchy keeps parents in front after reparenting and removal", "[ecs]")
+{
+    TransformHierarchy hierarchy;
+
+    Array<TransformId> ids;
+    for (i32 i = 0; i < 64; i++) {
+        ids.PushBack(hierarchy.Add(Transform::Translation({ 1, 0, 0 })));
+    }
+
+    // chain in reverse creation order, every parent starts behind its child
+    for (i32 i = 0; i < 63; i++) {
+        hierarchy.SetParent(ids[i], ids[i + 1]);
+    }
+
+    hierarchy.Propagate();
+
+    for (i32 i = 0; i < 64; i++) {
+        TransformId id = ids[i];
+        if (Optional<TransformId> parent = hierarchy.GetParent(id)) {
+            REQUIRE(hierarchy.GetFlatIndex(*parent) < hierarchy.GetFlatIndex(id));
+        }
+        REQUIRE(IsClose(hierarchy.GetWorld(id).translation, { As<f32>(64 - i), 0, 0 }));
+    }
+
+    // children inherit the removed node's parent and keep their world transform
+    hierarchy.Remove(ids[32]);
+    hierarchy.Propagate();
+
+    REQUIRE(hierarchy.Size() == 63);
+    REQUIRE(hierarchy.GetParent(ids[31]) == ids[33]);
+    REQUIRE(IsClose(hierarchy.GetWorld(ids[0]).translation, { 64, 0, 0 }));
+
+    hierarchy.SetParent(ids[0], {});
+    hierarchy.Propagate();
+
+    REQUIRE(IsClose(hierarchy.GetWorld(ids[0]).translation, { 1, 0, 0 }));
+}
+
+TEST_CASE("transform hierarchy batched removal matches removing one by one", "[ecs]")
+{
+    TransformHierarchy one_by_one;
+    TransformHierarchy batched;
+    Array<TransformId> ids = RandomForest(one_by_one, 2000);
+    RandomForest(batched, 2000);
+    // moves some parents behind their children
+    one_by_one.SetParent(ids[5], ids[1999]);
+    batched.SetParent(ids[5], ids[1999]);
+
+    Array<TransformId> removed;
+    for (i32 i = 0; i < 2000; i += 3) {
+        removed.PushBack(ids[i]);
+    }
+
+    for (TransformId id : removed) {
+        one_by_one.Remove(id);
+        RequireLinksMatchParents(one_by_one);
+    }
+    batched.Remove({ .data = removed.Data(), .num = removed.Size() });
+    RequireLinksMatchParents(batched);
+
+    one_by_one.Propagate();
+    batched.Propagate();
+
+    REQUIRE(batched.Size() == one_by_one.Size());
+    for (i32 i = 0; i < 2000; i++) {
+        if (i % 3 == 0) {
+            continue;
+        }
+        REQUIRE(batched.GetParent(ids[i]) == one_by_one.GetParent(ids[i]));
+        REQUIRE(IsClose(batched.GetWorld(ids[i]).translation, one_by_one.GetWorld(ids[i]).translation));
+    }
+
+    // handles are recycled by both
+    REQUIRE(batched.Add({}).GetIndex() == one_by_one.Add({}).GetIndex());
+}
@@ -0,0 +1,136 @@
+#include "WideBvh.h"
+#include "random.h"
+#include <algorithm>
+#include "catch/catch.hpp"
+
+using namespace Playground;
+
+namespace {
+
+Aabb3D RandomBox(Rng& rng, f32 extent)
+{
+    Vector3 p { rng.F32UniformInRange(-extent, extent), rng.F32UniformInRange(-extent, extent), rng.F32UniformInRange(-extent, extent) };
+    return Aabb3D::From(p, p + Vector3 { rng.F32UniformInRange(0.1f, 2.f), rng.F32UniformInRange(0.1f, 2.f), rng.F32UniformInRange(0.1f, 2.f) });
+}
+
+i64 Count(Array<DynamicBvh::Handle>& handles, DynamicBvh const& bvh, Vector3 point)
+{
+    i64 num = 0;
+    for (DynamicBvh::Handle h : handles) {
+        num += bvh.GetBoundingBox(h).Contains(point);
+    }
+    return num;
+}
+
+template <typename Wide>
+void RequireSameResults(Wide const& wide, DynamicBvh const& bvh, Array<DynamicBvh::Handle>& handles, Rng& rng)
+{
+    for (i32 query = 0; query < 100; query++) {
+        Vector3 point { rng.F32UniformInRange(-20, 20), rng.F32UniformInRange(-20, 20), rng.F32UniformInRange(-20, 20) };
+
+        Array<DynamicBvh::Handle> inside;
+        wide.FindAllIntersecting(point, inside);
+        REQUIRE(inside.Size() == Count(handles, bvh, point));
+        for (i64 i = 0; i < inside.Size(); i++) {
+            REQUIRE(bvh.GetBoundingBox(inside[i]).Contains(point));
+        }
+
+        i32 k = rng.I32UniformInRange(1, 12);
+        f32 max_distance = rng.F32UniformInRange(1.f, 8.f);
+        Array<DynamicBvh::Handle> expected_closest;
+        Array<DynamicBvh::Handle> closest;
+        bvh.FindKClosest(point, k, max_distance, expected_closest);
+        wide.FindKClosest(point, k, max_distance, closest);
+        REQUIRE(closest.Size() == expected_closest.Size());
+        for (i64 i = 0; i < closest.Size(); i++) {
+            REQUIRE(bvh.GetBoundingBox(closest[i]).Distance(point) == Approx(bvh.GetBoundingBox(expected_closest[i]).Distance(point)));
+        }
+        REQUIRE(bool(wide.FindClosest(point, max_distance)) == (expected_closest.Size() > 0));
+
+        Vector3 direction = Vector3 { rng.F32UniformInRange(-1, 1), rng.F32UniformInRange(-1, 1), rng.F32UniformInRange(-1, 1) }.normalized();
+        Optional<DynamicBvh::RayHit> expected_hit = bvh.RayCastClosest(point, direction, 30.f);
+        Optional<DynamicBvh::RayHit> hit = wide.RayCastClosest(point, direction, 30.f);
+        REQUIRE(bool(hit) == bool(expected_hit));
+        if (hit) {
+            REQUIRE(hit->t == Approx(expected_hit->t));
+        }
+
+        Aabb3D bounds = Aabb3D::From(point, point + Vector3 { rng.F32UniformInRange(0.5f, 6.f) });
+        i32 expected_overlapping = 0;
+        bvh.QueryAabb(bounds, [&](DynamicBvh::Handle) {
+            expected_overlapping++;
+            return true;
+        });
+        i32 overlapping = 0;
+        wide.QueryAabb(bounds, [&](DynamicBvh::Handle h) {
+            REQUIRE(bvh.GetBoundingBox(h).Overlaps(bounds));
+            overlapping++;
+            return true;
+        });
+        REQUIRE(overlapping == expected_overlapping);
+
+        Sphere3D sphere { .position = point, .radius = rng.F32UniformInRange(0.5f, 6.f) };
+        i32 expected_in_sphere = 0;
+        bvh.QuerySphere(sphere, [&](DynamicBvh::Handle) {
+            expected_in_sphere++;
+            return true;
+        });
+        i32 in_sphere = 0;
+        wide.QuerySphere(sphere, [&](DynamicBvh::Handle) {
+            in_sphere++;
+            return true;
+        });
+        REQUIRE(in_sphere == expected_in_sphere);
+    }
+}
+
+}
+
+TEMPLATE_TEST_CASE("wide bvh queries match the dynamic bvh", "[wide_bvh]", Bvh4, Bvh8)
+{
+    Rng rng;
+    DynamicBvh bvh;
+    TestType wide;
+
+    wide.Build(bvh);
+    REQUIRE(wide.Empty());
+    REQUIRE(!wide.FindClosest({}, 100.f));
+    REQUIRE(!wide.RayCastClosest({}, Vector3 { 1.f, 0.f, 0.f }, 100.f));
+
+    Array<DynamicBvh::Handle> handles;
+    handles.PushBack(bvh.Add(Aabb3D::From(Vector3 { 0.f }, Vector3 { 1.f })));
+    wide.Build(bvh);
+    REQUIRE(wide.GetDepth() == 1);
+    REQUIRE(wide.FindClosest(Vector3 { 0.5f }, 0.f));
+
+    for (i32 i = 0; i < 1000; i++) {
+        handles.PushBack(bvh.Add(RandomBox(rng, 20.f)));
+    }
+    wide.Build(bvh);
+
+    // collapsing removes at least every other level
+    REQUIRE(wide.GetDepth() <= (bvh.GetDepth() + 1) / 2);
+    RequireSameResults(wide, bvh, handles, rng);
+
+    SECTION("refit after leaves moved")
+    {
+        for (i32 i = 0; i < handles.Size(); i += 3) {
+            Aabb3D moved = bvh.GetBoundingBox(handles[i]);
+            Vector3 offset { rng.F32UniformInRange(-4, 4), rng.F32UniformInRange(-4, 4), rng.F32UniformInRange(-4, 4) };
+            bvh.Modify(handles[i], Aabb3D::From(moved.vec_min + offset, moved.vec_max + offset));
+        }
+
+        wide.Refit(bvh);
+        RequireSameResults(wide, bvh, handles, rng);
+    }
+
+    SECTION("rebuild after leaves were removed")
+    {
+        for (i32 i = 0; i < 300; i++) {
+            bvh.Remove(handles.PopBack());
+        }
+
+        wide.Build(bvh);
+        RequireSameResults(wide, bvh, handles, rng);
+    }
+}
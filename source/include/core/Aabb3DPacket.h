@@ -0,0 +1,165 @@
+#pragma once
+
+#include "Geometry.h"
+#include "Simd.h"
+
+namespace Playground {
+
+// WIDTH boxes stored as coordinate lanes, queries test all of them at once and return lane masks
+// unused lanes hold Aabb3D::Empty() and never contain or overlap anything
+template <typename V>
+struct Aabb3DPacket {
+    static constexpr i32 WIDTH = V::WIDTH;
+
+    V min_x, min_y, min_z;
+    V max_x, max_y, max_z;
+
+    static Aabb3DPacket Splat(Aabb3D const& box)
+    {
+        return {
+            V::Splat(box.vec_min.x()), V::Splat(box.vec_min.y()), V::Splat(box.vec_min.z()),
+            V::Splat(box.vec_max.x()), V::Splat(box.vec_max.y()), V::Splat(box.vec_max.z())
+        };
+    }
+
+    static Aabb3DPacket Empty()
+    {
+        return Splat(Aabb3D::Empty());
+    }
+
+    // num <= WIDTH
+    static Aabb3DPacket Load(Aabb3D const* boxes, i64 num)
+    {
+        plgr_assert(num <= WIDTH);
+
+        Aabb3D empty = Aabb3D::Empty();
+        alignas(32) f32 scratch[6][WIDTH];
+        for (i64 i = 0; i < WIDTH; i++) {
+            Aabb3D const& box = i < num ? boxes[i] : empty;
+            for (i32 c = 0; c < 3; c++) {
+                scratch[c][i] = box.vec_min[c];
+                scratch[3 + c][i] = box.vec_max[c];
+            }
+        }
+
+        return {
+            V::Load(scratch[0]), V::Load(scratch[1]), V::Load(scratch[2]),
+            V::Load(scratch[3]), V::Load(scratch[4]), V::Load(scratch[5])
+        };
+    }
+
+    Aabb3D Get(i32 lane) const
+    {
+        return {
+            .vec_min = { min_x.Get(lane), min_y.Get(lane), min_z.Get(lane) },
+            .vec_max = { max_x.Get(lane), max_y.Get(lane), max_z.Get(lane) }
+        };
+    }
+
+    void Set(i32 lane, Aabb3D const& box)
+    {
+        V* columns[6] = { &min_x, &min_y, &min_z, &max_x, &max_y, &max_z };
+        for (i32 c = 0; c < 6; c++) {
+            alignas(32) f32 lanes[WIDTH];
+            columns[c]->Store(lanes);
+            lanes[lane] = c < 3 ? box.vec_min[c] : box.vec_max[c - 3];
+            *columns[c] = V::Load(lanes);
+        }
+    }
+
+    // union of all lanes
+    Aabb3D Bounds() const
+    {
+        alignas(32) f32 scratch[6][WIDTH];
+        V const* columns[6] = { &min_x, &min_y, &min_z, &max_x, &max_y, &max_z };
+        for (i32 c = 0; c < 6; c++) {
+            columns[c]->Store(scratch[c]);
+        }
+
+        Aabb3D bounds = Aabb3D::Empty();
+        for (i32 i = 0; i < WIDTH; i++) {
+            for (i32 c = 0; c < 3; c++) {
+                bounds.vec_min[c] = Min(bounds.vec_min[c], scratch[c][i]);
+                bounds.vec_max[c] = Max(bounds.vec_max[c], scratch[3 + c][i]);
+            }
+        }
+        return bounds;
+    }
+
+    Aabb3DPacket Union(Aabb3DPacket const& other) const
+    {
+        return {
+            Min(min_x, other.min_x), Min(min_y, other.min_y), Min(min_z, other.min_z),
+            Max(max_x, other.max_x), Max(max_y, other.max_y), Max(max_z, other.max_z)
+        };
+    }
+
+    Aabb3DPacket Union(Aabb3D const& box) const
+    {
+        return Union(Splat(box));
+    }
+
+    V Contains(Vector3 v) const
+    {
+        V x = V::Splat(v.x()), y = V::Splat(v.y()), z = V::Splat(v.z());
+        return And(And(And(CmpLe(min_x, x), CmpLe(x, max_x)), And(CmpLe(min_y, y), CmpLe(y, max_y))), And(CmpLe(min_z, z), CmpLe(z, max_z)));
+    }
+
+    V Contains(Aabb3D const& box) const
+    {
+        return And(Contains(box.vec_min), Contains(box.vec_max));
+    }
+
+    V Overlaps(Aabb3D const& box) const
+    {
+        V x0 = V::Splat(box.vec_min.x()), y0 = V::Splat(box.vec_min.y()), z0 = V::Splat(box.vec_min.z());
+        V x1 = V::Splat(box.vec_max.x()), y1 = V::Splat(box.vec_max.y()), z1 = V::Splat(box.vec_max.z());
+        return And(And(And(CmpLe(min_x, x1), CmpLe(x0, max_x)), And(CmpLe(min_y, y1), CmpLe(y0, max_y))), And(CmpLe(min_z, z1), CmpLe(z0, max_z)));
+    }
+
+    // 0 inside, Aabb3D::Distance squared per lane
+    V DistanceSquared(Vector3 v) const
+    {
+        V x = V::Splat(v.x()), y = V::Splat(v.y()), z = V::Splat(v.z());
+        V dx = Max(min_x, Min(x, max_x)) - x;
+        V dy = Max(min_y, Min(y, max_y)) - y;
+        V dz = Max(min_z, Min(z, max_z)) - z;
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    V Distance(Vector3 v) const
+    {
+        return Sqrt(DistanceSquared(v));
+    }
+
+    // Aabb3D::RayIntersection per lane, t_enter is only meaningful in lanes that hit
+    V RayIntersection(Vector3 origin, Vector3 inv_direction, V max_t, V& t_enter) const
+    {
+        V ox = V::Splat(origin.x()), oy = V::Splat(origin.y()), oz = V::Splat(origin.z());
+        V ix = V::Splat(inv_direction.x()), iy = V::Splat(inv_direction.y()), iz = V::Splat(inv_direction.z());
+        V tx0 = (min_x - ox) * ix, tx1 = (max_x - ox) * ix;
+        V ty0 = (min_y - oy) * iy, ty1 = (max_y - oy) * iy;
+        V tz0 = (min_z - oz) * iz, tz1 = (max_z - oz) * iz;
+
+        t_enter = Max(Max(Max(Min(tx0, tx1), Min(ty0, ty1)), Min(tz0, tz1)), V::Splat(0.f));
+        V t_exit = Min(Min(Min(Max(tx0, tx1), Max(ty0, ty1)), Max(tz0, tz1)), max_t);
+        // empty lanes span (-inf, inf) on every axis and have to be rejected explicitly
+        return And(CmpLe(t_enter, t_exit), CmpLe(min_x, max_x));
+    }
+
+    V Area() const
+    {
+        V sx = max_x - min_x, sy = max_y - min_y, sz = max_z - min_z;
+        return V::Splat(2.f) * (sx * sy + sy * sz + sz * sx);
+    }
+
+    V Volume() const
+    {
+        return (max_x - min_x) * (max_y - min_y) * (max_z - min_z);
+    }
+};
+
+using Aabb3Dx4 = Aabb3DPacket<f32x4>;
+using Aabb3Dx8 = Aabb3DPacket<f32x8>;
+
+}
@@ -98,6 +98,13 @@ struct DenseIndex
         return container_.Size();
     }
 
+    i32 GetFlatIndex(IdType id) const
+    {
+        i32 flat_index = indirection_[id.GetIndex()];
+        plgr_assert(id.GetGeneration() == generation_[flat_index]);
+        return flat_index;
+    }
+
     IdType GetIdFromFlatIndex(i32 flat_index) {
         return IdType::Make(rev_indirection_[flat_index], generation_[flat_index]);
     }
@@ -165,6 +172,14 @@ struct DenseArray
         freelist_.Free(h.GetIndex());
     }
 
+    void Reserve(i64 size)
+    {
+        data_.Reserve(size);
+        generation_.Reserve(size);
+        indirection_.Reserve(size);
+        rev_indirection_.Reserve(size);
+    }
+
     T& operator[](Handle h)
     {
         i32 flat_index = indirection_[h.GetIndex()];
@@ -4,18 +4,27 @@
 
 namespace Playground {
 
+struct JobSystem;
+struct DynamicBvhView;
+
 // TODO:
 // when the queries are mostly 2D, does including 3rd dimension in cost help? probably not...
 
 struct DynamicBvh {
+    // stable across tree changes, nodes are renumbered by Compact()
     struct Handle {
         i32 index;
     };
 
-    struct Node {
-        Aabb3D bounds;
+    // one cache line, a node carries its children's bounds so they can be rejected without being fetched
+    // a node's own bounds live in its parent (root_bounds_ for the root)
+    // leaves keep their tight bounds in child_bounds[0]
+    struct alignas(64) Node {
+        Aabb3D child_bounds[2];
         i32 parent;
         i32 children[2];
+        // leaves only
+        i32 handle;
 
         bool IsLeaf() const;
         i32 ChildrenNum() const;
@@ -23,12 +32,20 @@ struct DynamicBvh {
         i32 GetSibling(i32) const;
     };
 
+    // how much bigger than the tight bounds a leaf's node is, a leaf is only reinserted once it leaves it
     enum InflationPolicy : i32 {
-        Default
+        // twice the size around the centre
+        Default,
+        // every side grows by inflation_margin_
+        FixedMargin,
+        // fixed margin, then stretched along the velocity by velocity_prediction_time_
+        // steadily moving leaves stay inside for several frames
+        Velocity
     };
 
+    // indexed by handle
     struct Leaf {
-        Aabb3D tight_bounds;
+        i32 node;
         InflationPolicy inflation_policy;
     };
 
@@ -36,23 +53,70 @@ struct DynamicBvh {
 
     FreeList nodes_freelist_;
     Array<Node> nodes_;
+    FreeList leaves_freelist_;
     Array<Leaf> leaves_;
     i32 root_ = NULL_NODE;
+    Aabb3D root_bounds_ = Aabb3D::Empty();
+
+    f32 inflation_margin_ = 0.1f;
+    f32 velocity_prediction_time_ = 4.f / 60.f;
+
+    // next handle Optimize() looks at
+    i32 optimize_cursor_ = 0;
 
     Handle Add(Aabb3D bounds, InflationPolicy inflation_policy = InflationPolicy::Default);
     void Remove(Handle);
 
-    i32 _Add(Aabb3D inflated_bounds, Optional<i32> index);
+    // bulk build of an empty tree with binned SAH, much faster than adding one by one
+    // out_handles[i] is the handle of bounds[i], the tree is laid out as by Compact()
+    // large subtrees are built on jobs' workers when given
+    void Build(Slice<Aabb3D> bounds, Slice<Handle> out_handles, JobSystem* jobs = nullptr, InflationPolicy inflation_policy = InflationPolicy::Default);
+
+    // links an allocated leaf node into the tree
+    void _Add(i32 leaf, Aabb3D inflated_bounds);
     void _Remove(i32);
+    // _Add and _Remove without the refit, return the lowest node whose bounds are stale or NULL_NODE
+    i32 _Link(i32 leaf, Aabb3D inflated_bounds);
+    i32 _Unlink(i32 leaf);
+
+    void Modify(Handle current, Aabb3D bounds, Vector3 velocity = {});
+    // Modify for many leaves at once, velocities may be empty, every handle has to be live and listed once
+    // escaped leaves are all unlinked and reinserted first, then every touched ancestor is refitted and rotated once
+    void ModifyBatch(Slice<Handle> handles, Slice<Aabb3D> bounds, Slice<Vector3> velocities);
+
+    // spends a frame's budget on tree quality: reinserts up to budget_nodes leaves with freshly inflated bounds,
+    // the search picks the cheapest spot and the refits rotate along both paths, consecutive calls cycle through all leaves
+    void Optimize(i32 budget_nodes);
+    // sum of the node areas relative to the root's, the expected number of nodes a random ray visits
+    // walks the whole tree
+    f32 GetSahCost() const;
 
-    void Modify(Handle current, Aabb3D bounds);
+    // renumbers nodes depth first so a subtree is contiguous and a left child directly follows its parent
+    // handles stay valid
+    void Compact();
 
-    Aabb3D _Inflate(Aabb3D, InflationPolicy);
+    // flat little endian image: a versioned header, then the raw node, leaf and free list arrays
+    // every section starts on a cache line, so a mapped file can be queried in place through DynamicBvhView
+    // Load copies every section into the tree's own arrays instead, the image can go away right after
+    // Compact() first for the smallest image
+    void Save(Array<u8>& out) const;
+    // replaces the tree, false when the image is truncated, written by a different version or node layout,
+    // or holds a node, leaf or free list index outside of its arrays, the tree is empty then
+    // a damaged image whose indices are all in range still loads
+    bool Load(Slice<u8 const> image);
+
+    // the slot holding a node's bounds, inflated for leaves
+    Aabb3D& _Bounds(i32);
+    Aabb3D const& _Bounds(i32) const;
+
+    Aabb3D _Inflate(Aabb3D, InflationPolicy, Vector3 velocity = {}) const;
     
     // make a temporary transitional node that should be patched with the new sibling
     i32 _Split(i32);
-    // recursively walks up and update bounding boxes
+    // walks up to the root updating bounding boxes and rotating
     void _Refit(i32);
+    // union of the children
+    void _UpdateBounds(i32);
     void _Rotate(i32, i32);
     //    o 
     //  o   o
@@ -64,6 +128,7 @@ struct DynamicBvh {
     void _Rotate21(i32, i32);
     // this finds the optimal rotation of children (degree 1st and 2nd)
     // checks all 6 rotations and applies the best if better than the current setup
+    // the node's own bounds don't change
     void Rotate(i32);
 
     f32 _GetMergeCost(i32 l, i32 r) const;
@@ -73,7 +138,208 @@ struct DynamicBvh {
     Aabb3D GetBoundingBox(Handle) const;
 
     Optional<Handle> FindClosest(Vector3 point, f32 max_distance) const;
+    // appends up to k leaves within max_distance, nearest first
+    void FindKClosest(Vector3 point, i32 k, f32 max_distance, Array<Handle> & out) const;
     bool FindAllIntersecting(Vector3 point, Array<Handle> & out) const;
+
+    struct RayHit {
+        Handle handle;
+        f32 t;
+    };
+
+    // visitor(Handle, f32 t) -> f32 is called for leaves hit before max_t, nearer subtrees first
+    // it returns the new max_t: t to clip the ray to this hit, 0 to stop, max_t to keep all hits
+    template <typename F>
+    void RayCast(Vector3 origin, Vector3 direction, f32 max_t, F&& visitor) const;
+    Optional<RayHit> RayCastClosest(Vector3 origin, Vector3 direction, f32 max_t) const;
+
+    // visitor(Handle) -> bool is called for every leaf overlapping the query, false stops
+    template <typename F>
+    void QueryAabb(Aabb3D const& bounds, F&& visitor) const;
+    template <typename F>
+    void QuerySphere(Sphere3D const& sphere, F&& visitor) const;
+
+    // batched queries, packets of f32xN::WIDTH queries share one traversal
+    // a node is entered with the mask of queries that overlap it and tested against all of them at once
+    struct PointHit {
+        i32 query;
+        Handle handle;
+    };
+
+    // appends a hit for every (point, leaf) pair where the leaf contains the point, grouped by packet
+    void FindAllIntersecting(Slice<Vector3> points, Array<PointHit>& out) const;
+    // out[i] is the closest hit for ray i
+    void RayCastClosest(Slice<Vector3> origins, Slice<Vector3> directions, f32 max_t, Slice<Optional<RayHit>> out) const;
+
+    // broadphase, a.index < b.index
+    struct Pair {
+        Handle a;
+        Handle b;
+    };
+
+    // appends every pair of leaves whose tight bounds overlap
+    // the tree is traversed against itself, a pair is only reached below its lowest common ancestor so it's found once
+    void FindOverlappingPairs(Array<Pair>& out) const;
+    // the top of the tree is split into subtree vs subtree tasks that run on the workers, same pairs as the serial one
+    void FindOverlappingPairs(Array<Pair>& out, JobSystem& jobs) const;
+    // only the pairs with at least one leaf in moved, each once, for when most of the scene is at rest
+    // moved may list a live handle more than once
+    void FindOverlappingPairs(Slice<Handle> moved, Array<Pair>& out) const;
+
+    // the tree's arrays seen as a view, the queries it shares with one are implemented there
+    DynamicBvhView _View() const;
+};
+
+// read-only DynamicBvh over arrays it doesn't own, usually an image Save wrote that's mapped from a file
+// queried in place, nothing is copied and opening doesn't have to touch the nodes
+// the image has to outlive the view and start on a cache line, as a mapped file does
+struct DynamicBvhView {
+    using Node = DynamicBvh::Node;
+    using Leaf = DynamicBvh::Leaf;
+    using Handle = DynamicBvh::Handle;
+    using RayHit = DynamicBvh::RayHit;
+
+    Slice<Node const> nodes_ = {};
+    Slice<Leaf const> leaves_ = {};
+    i32 root_ = DynamicBvh::NULL_NODE;
+    Aabb3D root_bounds_ = Aabb3D::Empty();
+
+    // points the view at image, false when Load would reject it or a section isn't aligned for its type in memory,
+    // the view is empty then
+    // the header and the section bounds are always checked, trusted skips the pass over every node and leaf
+    // that range checks their indices, for images this program wrote itself
+    bool Open(Slice<u8 const> image, bool trusted = false);
+
+    Aabb3D GetBoundingBox(Handle) const;
+
+    // same as DynamicBvh's
+    template <typename F>
+    void RayCast(Vector3 origin, Vector3 direction, f32 max_t, F&& visitor) const;
+    Optional<RayHit> RayCastClosest(Vector3 origin, Vector3 direction, f32 max_t) const;
+    template <typename F>
+    void QueryAabb(Aabb3D const& bounds, F&& visitor) const;
+    template <typename F>
+    void QuerySphere(Sphere3D const& sphere, F&& visitor) const;
+
+    // visits leaves whose node and tight bounds pass overlaps(Aabb3D)
+    template <typename Overlaps, typename F>
+    void _Query(Overlaps&& overlaps, F&& visitor) const;
 };
 
+template <typename F>
+void DynamicBvh::RayCast(Vector3 origin, Vector3 direction, f32 max_t, F&& visitor) const
+{
+    _View().RayCast(origin, direction, max_t, std::forward<F>(visitor));
+}
+
+template <typename F>
+void DynamicBvh::QueryAabb(Aabb3D const& bounds, F&& visitor) const
+{
+    _View().QueryAabb(bounds, std::forward<F>(visitor));
+}
+
+template <typename F>
+void DynamicBvh::QuerySphere(Sphere3D const& sphere, F&& visitor) const
+{
+    _View().QuerySphere(sphere, std::forward<F>(visitor));
+}
+
+template <typename F>
+void DynamicBvhView::RayCast(Vector3 origin, Vector3 direction, f32 max_t, F&& visitor) const
+{
+    if (root_ == DynamicBvh::NULL_NODE) {
+        return;
+    }
+
+    Vector3 inv_direction = 1.f / direction;
+
+    struct Frame {
+        i32 node;
+        f32 t;
+    };
+
+    Array<Frame> stack;
+    if (Optional<f32> t = root_bounds_.RayIntersection(origin, inv_direction, max_t)) {
+        stack.PushBack({ .node = root_, .t = *t });
+    }
+
+    while (stack.Size()) {
+        Frame frame = stack.PopBack();
+        // max_t may have shrunk since the node was pushed
+        if (frame.t > max_t) {
+            continue;
+        }
+
+        Node const& node = nodes_.data[frame.node];
+        if (node.IsLeaf()) {
+            if (Optional<f32> t = node.child_bounds[0].RayIntersection(origin, inv_direction, max_t)) {
+                max_t = Min(max_t, visitor(Handle { node.handle }, *t));
+                if (max_t <= 0.f) {
+                    return;
+                }
+            }
+            continue;
+        }
+
+        Optional<f32> t0 = node.child_bounds[0].RayIntersection(origin, inv_direction, max_t);
+        Optional<f32> t1 = node.child_bounds[1].RayIntersection(origin, inv_direction, max_t);
+
+        // the nearer child goes on top
+        if (t0 && t1 && *t1 < *t0) {
+            stack.PushBack({ .node = node.children[0], .t = *t0 });
+            stack.PushBack({ .node = node.children[1], .t = *t1 });
+        } else {
+            if (t1) {
+                stack.PushBack({ .node = node.children[1], .t = *t1 });
+            }
+            if (t0) {
+                stack.PushBack({ .node = node.children[0], .t = *t0 });
+            }
+        }
+    }
+}
+
+template <typename F>
+void DynamicBvhView::QueryAabb(Aabb3D const& bounds, F&& visitor) const
+{
+    auto overlaps = [&bounds](Aabb3D const& node_bounds) { return node_bounds.Overlaps(bounds); };
+    _Query(overlaps, std::forward<F>(visitor));
+}
+
+template <typename F>
+void DynamicBvhView::QuerySphere(Sphere3D const& sphere, F&& visitor) const
+{
+    auto overlaps = [&sphere](Aabb3D const& node_bounds) { return node_bounds.Distance(sphere.position) <= sphere.radius; };
+    _Query(overlaps, std::forward<F>(visitor));
+}
+
+template <typename Overlaps, typename F>
+void DynamicBvhView::_Query(Overlaps&& overlaps, F&& visitor) const
+{
+    if (root_ == DynamicBvh::NULL_NODE || !overlaps(root_bounds_)) {
+        return;
+    }
+
+    Array<i32> stack;
+    stack.PushBack(root_);
+
+    while (stack.Size()) {
+        Node const& node = nodes_.data[stack.PopBack()];
+
+        if (node.IsLeaf()) {
+            if (overlaps(node.child_bounds[0]) && !visitor(Handle { node.handle })) {
+                return;
+            }
+            continue;
+        }
+
+        if (overlaps(node.child_bounds[1])) {
+            stack.PushBack(node.children[1]);
+        }
+        if (overlaps(node.child_bounds[0])) {
+            stack.PushBack(node.children[0]);
+        }
+    }
+}
+
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include "types.h"
 #include "array.h"
+#include "Slice.h"
+#include "bitarray.h"
 
 namespace Playground {
 
@@ -20,6 +22,7 @@ struct Transform {
     bool HasUniformScale() const;
 
     Transform Combine(Transform const& other) const;
+    Matrix4 ToMatrix() const;
 };
 
 struct Aabb2D {
@@ -54,6 +57,9 @@ struct Aabb3D {
     f32 Distance(Vector3 v) const;
     bool Contains(Vector3 v) const;
     bool Contains(Aabb3D const &) const;
+    bool Overlaps(Aabb3D const &) const;
+    // entry distance along the ray, 0 when starting inside
+    Optional<f32> RayIntersection(Vector3 origin, Vector3 inv_direction, f32 max_t) const;
 
     f32 Volume() const;
     f32 Area() const;
@@ -79,11 +85,34 @@ struct Obb3D {
     static Obb3D UnitCube();
 };
 
+// planes point inwards, (normal, distance) with dot(normal, p) + distance >= 0 inside
+struct ViewFrustum {
+    Vector4 planes[6];
+
+    // clip space with x, y in [-w, w] and z in [0, w], as produced by PerspectiveFovLh
+    static ViewFrustum FromMatrix(Matrix4 const& view_projection);
+
+    bool Intersects(Aabb3D const&) const;
+};
+
 struct Sphere3D {
     Vector3 position;
     f32 radius;
 };
 
+// batched versions of the Transform functions, vectorised across elements
+// outputs are as long as the inputs and may alias them
+void TransformPoints(Transform const&, Slice<Vector3> points, Slice<Vector3> out);
+// in place over separate coordinate columns
+void TransformPoints(Transform const&, Slice<f32> xs, Slice<f32> ys, Slice<f32> zs);
+void CombineTransforms(Slice<Transform> parents, Slice<Transform> locals, Slice<Transform> out);
+void TransformsToMatrices(Slice<Transform> transforms, Slice<Matrix4> out);
+
+// same as Obb3D::GetAabb for affine transforms, without visiting the corners
+void ComputeAabbs(Slice<Obb3D> boxes, Matrix4 const& transform, Slice<Aabb3D> out);
+// conservative, boxes intersecting the frustum get their bit set, visible is resized to the boxes num
+void CullAabbs(ViewFrustum const&, Slice<Aabb3D> boxes, Bitarray& visible);
+
 Vector2 RandomPointInAnnulus(f32 r0, f32 r1, Vector2 random_pair);
 Quaternion QuaternionRotationVectorToVector(Vector3 v0, Vector3 v1);
 Vector3 Slerp(Vector3 start, Vector3 end, f32 f);
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "array.h"
+
+#include <functional>
+
+namespace Playground {
+
+// binary heap on top of an Array, Top() is the element no other element is Less than
+// the default Less gives a min-heap, std::greater a max-heap
+template <typename T, typename Less = std::less<T>>
+struct Heap {
+    Array<T> data_;
+    Less less_;
+
+    Heap() = default;
+    explicit Heap(Less less)
+        : less_(std::move(less))
+    {
+    }
+
+    void Push(T t)
+    {
+        data_.PushBack(t);
+        _SiftUp(data_.Size() - 1);
+    }
+
+    T Pop()
+    {
+        plgr_assert(data_.Size());
+        T top = data_[0];
+        T last = data_.PopBack();
+        if (data_.Size()) {
+            data_[0] = last;
+            _SiftDown(0);
+        }
+        return top;
+    }
+
+    // replaces the top, cheaper than Pop followed by Push
+    void ReplaceTop(T t)
+    {
+        plgr_assert(data_.Size());
+        data_[0] = t;
+        _SiftDown(0);
+    }
+
+    T const& Top() const
+    {
+        plgr_assert(data_.Size());
+        return data_[0];
+    }
+
+    i64 Size() const
+    {
+        return data_.Size();
+    }
+
+    bool Empty() const
+    {
+        return data_.Size() == 0;
+    }
+
+    void Reserve(i64 size)
+    {
+        data_.Reserve(size);
+    }
+
+    void Clear()
+    {
+        data_.Clear();
+    }
+
+    void _SiftUp(i64 index)
+    {
+        T t = data_[index];
+        while (index > 0) {
+            i64 parent = (index - 1) / 2;
+            if (!less_(t, data_[parent])) {
+                break;
+            }
+            data_[index] = data_[parent];
+            index = parent;
+        }
+        data_[index] = t;
+    }
+
+    void _SiftDown(i64 index)
+    {
+        i64 size = data_.Size();
+        T t = data_[index];
+        while (true) {
+            i64 child = index * 2 + 1;
+            if (child >= size) {
+                break;
+            }
+            if (child + 1 < size && less_(data_[child + 1], data_[child])) {
+                child++;
+            }
+            if (!less_(data_[child], t)) {
+                break;
+            }
+            data_[index] = data_[child];
+            index = child;
+        }
+        data_[index] = t;
+    }
+};
+
+}
@@ -0,0 +1,223 @@
+#pragma once
+#include "Types.h"
+#include "Array.h"
+#include "box.h"
+#include "Slice.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace Playground {
+
+struct JobCounter;
+
+using JobFunction = void (*)(void* data, i64 begin, i64 end);
+
+struct Job {
+    JobFunction function = nullptr;
+    void* data = nullptr;
+    i64 begin = 0;
+    i64 end = 0;
+    JobCounter* counter = nullptr;
+};
+
+// number of jobs in flight, waiting on it runs other jobs until it drops to zero
+// jobs submitted after it are held here and released by the job that brings it to zero
+struct JobCounter {
+    // set while held_ is changed
+    static constexpr i32 LOCKED = 1 << 30;
+    // set while held_ has jobs, the job that brings the count to zero sees it and releases them
+    static constexpr i32 HELD = 1 << 29;
+    static constexpr i32 COUNT_MASK = HELD - 1;
+
+    // count of jobs in the low bits, flags on top so the value only reads zero once held_ is empty and unlocked
+    std::atomic<i32> value_ = 0;
+    Array<Job> held_;
+
+    bool IsDone() const;
+
+    // sets LOCKED, returns the value from before
+    i32 _Lock();
+};
+
+// Chase-Lev work stealing deque of jobs
+// the owner pushes and pops at the bottom without locking, other threads steal from the top with a CAS,
+// the two ends only race over the last job
+// the ring grows by doubling, replaced rings are kept until the deque is destroyed as a thief may still read them
+struct JobDeque : private Pinned<JobDeque> {
+    struct Ring : private Pinned<Ring> {
+        // jobs are copied in and out field by field with relaxed atomics, a thief that loses the race
+        // for a slot drops what it read
+        struct Slot {
+            std::atomic<JobFunction> function;
+            std::atomic<void*> data;
+            std::atomic<i64> begin;
+            std::atomic<i64> end;
+            std::atomic<JobCounter*> counter;
+        };
+
+        i64 capacity_;
+        Slot* slots_;
+
+        explicit Ring(i64 capacity);
+        ~Ring();
+
+        void Store(i64 index, Job const& job)
+        {
+            Slot& slot = slots_[index & (capacity_ - 1)];
+            slot.function.store(job.function, std::memory_order_relaxed);
+            slot.data.store(job.data, std::memory_order_relaxed);
+            slot.begin.store(job.begin, std::memory_order_relaxed);
+            slot.end.store(job.end, std::memory_order_relaxed);
+            slot.counter.store(job.counter, std::memory_order_relaxed);
+        }
+
+        Job Load(i64 index) const
+        {
+            Slot const& slot = slots_[index & (capacity_ - 1)];
+            return {
+                .function = slot.function.load(std::memory_order_relaxed),
+                .data = slot.data.load(std::memory_order_relaxed),
+                .begin = slot.begin.load(std::memory_order_relaxed),
+                .end = slot.end.load(std::memory_order_relaxed),
+                .counter = slot.counter.load(std::memory_order_relaxed),
+            };
+        }
+    };
+
+    // own cache lines, the owner writes bottom_ and thieves write top_
+    alignas(64) std::atomic<i64> top_ = 0;
+    alignas(64) std::atomic<i64> bottom_ = 0;
+    std::atomic<Ring*> ring_ = nullptr;
+    Array<Box<Ring>> rings_;
+
+    explicit JobDeque(i64 capacity = 256);
+
+    // owner only
+    void Push(Job const& job);
+    Optional<Job> Pop();
+    // any thread, NullOpt when empty or when another thread took the job first
+    Optional<Job> Steal();
+    bool Empty() const;
+};
+
+// fixed pool of worker threads, each with its own deque
+// the owner pushes and pops at the back, idle workers steal from the front
+// the thread that creates the pool is worker 0 and only runs jobs while waiting,
+// other threads outside of the pool submit through a shared queue
+struct JobSystem : private Pinned<JobSystem> {
+    Array<Box<JobDeque>> deques_;
+    Array<Box<std::thread>> threads_;
+    std::thread::id owner_thread_;
+
+    std::mutex shared_mutex_;
+    Array<Job> shared_jobs_;
+    i64 shared_front_ = 0;
+    // jobs left in shared_jobs_, checked before taking the lock
+    std::atomic<i64> shared_num_ = 0;
+
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    std::atomic<i32> sleeping_ = 0;
+    std::atomic<bool> quit_ = false;
+
+    // jobs submitted without a counter of their own, the pool waits for them before shutting down
+    JobCounter detached_;
+
+    // threads_num < 0 picks hardware concurrency - 1
+    JobSystem(i32 threads_num = -1);
+    ~JobSystem();
+
+    i32 WorkersNum() const;
+    // 0 for any thread outside of the pool
+    static i32 GetWorkerIndex();
+
+    void Submit(Job job, JobCounter& counter);
+    void Submit(Slice<Job> jobs, JobCounter& counter);
+    // job counts in counter right away but runs only once dependency next drops to zero, right away if it's zero
+    void SubmitAfter(Job job, JobCounter& counter, JobCounter& dependency);
+    // for jobs that signal their own completion, like coroutines resumed on a worker
+    void SubmitDetached(Job job);
+    // helps with other jobs until the counter drops to zero
+    void Wait(JobCounter& counter);
+    // runs one queued job on the calling thread, false when there was none
+    bool RunOne();
+
+    // f(begin, end) over [0, num) in chunks of grain, the calling thread takes the first chunk
+    template <typename F>
+    void ParallelFor(i64 num, i64 grain, F&& f);
+    // f(Slice<T>) over consecutive chunks of up to grain items
+    template <typename T, typename F>
+    void ParallelFor(Slice<T> items, i64 grain, F&& f);
+    template <typename T, typename F>
+    void ParallelFor(Array<T>& items, i64 grain, F&& f);
+
+    // deque the calling thread owns, -1 when it owns none
+    i32 _OwnedWorker() const;
+    // jobs whose counters already include them
+    void _Enqueue(Slice<Job> jobs);
+    Optional<Job> _Pop(i32 worker_index);
+    Optional<Job> _Steal(i32 worker_index);
+    bool _RunOne(i32 worker_index);
+    void _Execute(Job const& job);
+    // drops the counter by one, the last job releases the held ones
+    void _Retire(JobCounter& counter);
+    // any deque or the shared queue has a job, checked by workers before they sleep
+    bool _HasWork() const;
+    void _WorkerLoop(i32 worker_index);
+    void _Wake(i64 jobs_num);
+};
+
+template <typename F>
+void JobSystem::ParallelFor(i64 num, i64 grain, F&& f)
+{
+    plgr_assert(grain > 0);
+
+    if (num <= 0) {
+        return;
+    }
+
+    if (num <= grain) {
+        f(i64 { 0 }, num);
+        return;
+    }
+
+    using Function = std::remove_reference_t<F>;
+    JobFunction run = [](void* data, i64 begin, i64 end) {
+        (*static_cast<Function*>(data))(begin, end);
+    };
+
+    Array<Job> jobs;
+    jobs.Reserve((num + grain - 1) / grain - 1);
+    for (i64 begin = grain; begin < num; begin += grain) {
+        jobs.PushBack({ .function = run,
+            .data = const_cast<void*>(static_cast<const void*>(&f)),
+            .begin = begin,
+            .end = Min(begin + grain, num) });
+    }
+
+    JobCounter counter;
+    Submit({ .data = jobs.Data(), .num = jobs.Size() }, counter);
+
+    f(i64 { 0 }, grain);
+
+    Wait(counter);
+}
+
+template <typename T, typename F>
+void JobSystem::ParallelFor(Slice<T> items, i64 grain, F&& f)
+{
+    ParallelFor(items.num, grain, [&items, &f](i64 begin, i64 end) {
+        f(Slice<T> { .data = items.data + begin, .num = end - begin });
+    });
+}
+
+template <typename T, typename F>
+void JobSystem::ParallelFor(Array<T>& items, i64 grain, F&& f)
+{
+    ParallelFor(Slice<T> { .data = items.Data(), .num = items.Size() }, grain, std::forward<F>(f));
+}
+
+}
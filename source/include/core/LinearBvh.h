@@ -0,0 +1,89 @@
+#pragma once
+#include "DynamicBvh.h"
+
+namespace Playground {
+
+struct JobSystem;
+
+// immutable bvh for geometry that never moves, built in linear time from the Morton order of the box centres
+// a node splits its range where the highest bit that differs between its Morton codes flips, no cost is evaluated
+// nodes are depth first and know where their subtree ends, queries walk the array without a stack
+// build quality is below DynamicBvh::Build's SAH, in exchange the build is a sort and a single pass
+struct LinearBvh {
+    using Handle = DynamicBvh::Handle;
+    using RayHit = DynamicBvh::RayHit;
+
+    struct Node {
+        Aabb3D bounds;
+        // first node past the subtree, the left child is the next node and the right child is the left one's skip
+        i32 skip;
+        // index into the built bounds, leaves only
+        i32 handle;
+
+        bool IsLeaf() const;
+    };
+
+    static constexpr i32 NULL_NODE = -1;
+
+    // depth first, a subtree of n leaves takes 2n - 1 nodes
+    Array<Node> nodes_;
+
+    // handles are indices into bounds, the sort and large subtrees run on jobs' workers when given
+    void Build(Slice<Aabb3D> bounds, JobSystem* jobs = nullptr);
+
+    bool Empty() const;
+    i32 GetDepth() const;
+
+    // same queries and results as their DynamicBvh counterparts
+    bool FindAllIntersecting(Vector3 point, Array<Handle>& out) const;
+    Optional<Handle> FindClosest(Vector3 point, f32 max_distance) const;
+    // appends up to k leaves within max_distance, nearest first
+    void FindKClosest(Vector3 point, i32 k, f32 max_distance, Array<Handle>& out) const;
+    // nodes are visited in layout order rather than nearest first, max_t still shrinks with every hit
+    Optional<RayHit> RayCastClosest(Vector3 origin, Vector3 direction, f32 max_t) const;
+
+    // visitor(Handle) -> bool is called for every leaf overlapping the query, false stops
+    template <typename F>
+    void QueryAabb(Aabb3D const& bounds, F&& visitor) const;
+    template <typename F>
+    void QuerySphere(Sphere3D const& sphere, F&& visitor) const;
+
+    // visits leaves whose bounds pass overlaps(Aabb3D), a failed test skips the whole subtree
+    template <typename Overlaps, typename F>
+    void _Query(Overlaps&& overlaps, F&& visitor) const;
+};
+
+template <typename F>
+void LinearBvh::QueryAabb(Aabb3D const& bounds, F&& visitor) const
+{
+    auto overlaps = [&bounds](Aabb3D const& node_bounds) { return node_bounds.Overlaps(bounds); };
+    _Query(overlaps, std::forward<F>(visitor));
+}
+
+template <typename F>
+void LinearBvh::QuerySphere(Sphere3D const& sphere, F&& visitor) const
+{
+    auto overlaps = [&sphere](Aabb3D const& node_bounds) { return node_bounds.Distance(sphere.position) <= sphere.radius; };
+    _Query(overlaps, std::forward<F>(visitor));
+}
+
+template <typename Overlaps, typename F>
+void LinearBvh::_Query(Overlaps&& overlaps, F&& visitor) const
+{
+    i32 num = As<i32>(nodes_.Size());
+    for (i32 index = 0; index < num;) {
+        Node const& node = nodes_[index];
+
+        if (!overlaps(node.bounds)) {
+            index = node.skip;
+            continue;
+        }
+
+        if (node.IsLeaf() && !visitor(Handle { node.handle })) {
+            return;
+        }
+        index++;
+    }
+}
+
+}
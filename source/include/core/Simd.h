@@ -0,0 +1,323 @@
+#pragma once
+
+#include "Types.h"
+#include "Core.h"
+
+#include <bit>
+
+// PLGR_SIMD_SCALAR forces the scalar fallback, used to check the vector paths against it
+#if !defined(PLGR_SIMD_SCALAR)
+#if defined(__AVX__)
+#define PLGR_AVX 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PLGR_SSE 1
+#endif
+#endif
+
+#if PLGR_AVX
+#include <immintrin.h>
+#elif PLGR_SSE
+#include <emmintrin.h>
+#endif
+
+namespace Playground {
+
+// 4 wide float lanes, comparisons return masks with all bits of a lane set
+struct f32x4 {
+    static constexpr i32 WIDTH = 4;
+
+#if PLGR_SSE
+    __m128 v;
+#else
+    f32 v[4];
+#endif
+
+    static f32x4 Splat(f32 f)
+    {
+#if PLGR_SSE
+        return { _mm_set1_ps(f) };
+#else
+        return { { f, f, f, f } };
+#endif
+    }
+
+    static f32x4 Set(f32 a, f32 b, f32 c, f32 d)
+    {
+#if PLGR_SSE
+        return { _mm_setr_ps(a, b, c, d) };
+#else
+        return { { a, b, c, d } };
+#endif
+    }
+
+    static f32x4 Load(f32 const* src)
+    {
+#if PLGR_SSE
+        return { _mm_loadu_ps(src) };
+#else
+        return { { src[0], src[1], src[2], src[3] } };
+#endif
+    }
+
+    void Store(f32* dst) const
+    {
+#if PLGR_SSE
+        _mm_storeu_ps(dst, v);
+#else
+        for (i32 i = 0; i < WIDTH; i++) {
+            dst[i] = v[i];
+        }
+#endif
+    }
+
+    f32 Get(i32 lane) const
+    {
+        alignas(16) f32 lanes[WIDTH];
+        Store(lanes);
+        return lanes[lane];
+    }
+};
+
+#if PLGR_SSE
+
+inline f32x4 operator+(f32x4 a, f32x4 b) { return { _mm_add_ps(a.v, b.v) }; }
+inline f32x4 operator-(f32x4 a, f32x4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline f32x4 operator*(f32x4 a, f32x4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline f32x4 operator/(f32x4 a, f32x4 b) { return { _mm_div_ps(a.v, b.v) }; }
+inline f32x4 Min(f32x4 a, f32x4 b) { return { _mm_min_ps(a.v, b.v) }; }
+inline f32x4 Max(f32x4 a, f32x4 b) { return { _mm_max_ps(a.v, b.v) }; }
+inline f32x4 Sqrt(f32x4 a) { return { _mm_sqrt_ps(a.v) }; }
+inline f32x4 CmpLt(f32x4 a, f32x4 b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline f32x4 CmpLe(f32x4 a, f32x4 b) { return { _mm_cmple_ps(a.v, b.v) }; }
+inline f32x4 CmpGt(f32x4 a, f32x4 b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+inline f32x4 CmpGe(f32x4 a, f32x4 b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+inline f32x4 And(f32x4 a, f32x4 b) { return { _mm_and_ps(a.v, b.v) }; }
+inline f32x4 Or(f32x4 a, f32x4 b) { return { _mm_or_ps(a.v, b.v) }; }
+// a & ~b
+inline f32x4 AndNot(f32x4 a, f32x4 b) { return { _mm_andnot_ps(b.v, a.v) }; }
+// one bit per lane
+inline i32 MoveMask(f32x4 mask) { return _mm_movemask_ps(mask.v); }
+
+#else
+
+template <typename F>
+f32x4 _PerLane(f32x4 a, f32x4 b, F&& f)
+{
+    f32x4 result;
+    for (i32 i = 0; i < f32x4::WIDTH; i++) {
+        result.v[i] = f(a.v[i], b.v[i]);
+    }
+    return result;
+}
+
+inline f32 _LaneMask(bool b) { return std::bit_cast<f32>(b ? 0xffffffffu : 0u); }
+inline u32 _LaneBits(f32 f) { return std::bit_cast<u32>(f); }
+
+inline f32x4 operator+(f32x4 a, f32x4 b) { return _PerLane(a, b, [](f32 x, f32 y) { return x + y; }); }
+inline f32x4 operator-(f32x4 a, f32x4 b) { return _PerLane(a, b, [](f32 x, f32 y) { return x - y; }); }
+inline f32x4 operator*(f32x4 a, f32x4 b) { return _PerLane(a, b, [](f32 x, f32 y) { return x * y; }); }
+inline f32x4 operator/(f32x4 a, f32x4 b) { return _PerLane(a, b, [](f32 x, f32 y) { return x / y; }); }
+// same operand order as minps/maxps, the second operand wins on NaN
+inline f32x4 Min(f32x4 a, f32x4 b) { return _PerLane(a, b, [](f32 x, f32 y) { return x < y ? x : y; }); }
+inline f32x4 Max(f32x4 a, f32x4 b) { return _PerLane(a, b, [](f32 x, f32 y) { return x > y ? x : y; }); }
+inline f32x4 Sqrt(f32x4 a) { return _PerLane(a, a, [](f32 x, f32) { return sqrtf(x); }); }
+inline f32x4 CmpLt(f32x4 a, f32x4 b) { return _PerLane(a, b, [](f32 x, f32 y) { return _LaneMask(x < y); }); }
+inline f32x4 CmpLe(f32x4 a, f32x4 b) { return _PerLane(a, b, [](f32 x, f32 y) { return _LaneMask(x <= y); }); }
+inline f32x4 CmpGt(f32x4 a, f32x4 b) { return _PerLane(a, b, [](f32 x, f32 y) { return _LaneMask(x > y); }); }
+inline f32x4 CmpGe(f32x4 a, f32x4 b) { return _PerLane(a, b, [](f32 x, f32 y) { return _LaneMask(x >= y); }); }
+inline f32x4 And(f32x4 a, f32x4 b) { return _PerLane(a, b, [](f32 x, f32 y) { return std::bit_cast<f32>(_LaneBits(x) & _LaneBits(y)); }); }
+inline f32x4 Or(f32x4 a, f32x4 b) { return _PerLane(a, b, [](f32 x, f32 y) { return std::bit_cast<f32>(_LaneBits(x) | _LaneBits(y)); }); }
+inline f32x4 AndNot(f32x4 a, f32x4 b) { return _PerLane(a, b, [](f32 x, f32 y) { return std::bit_cast<f32>(_LaneBits(x) & ~_LaneBits(y)); }); }
+
+inline i32 MoveMask(f32x4 mask)
+{
+    i32 bits = 0;
+    for (i32 i = 0; i < f32x4::WIDTH; i++) {
+        bits |= As<i32>(_LaneBits(mask.v[i]) >> 31) << i;
+    }
+    return bits;
+}
+
+#endif
+
+// mask ? a : b
+inline f32x4 Select(f32x4 mask, f32x4 a, f32x4 b)
+{
+    return Or(And(mask, a), AndNot(b, mask));
+}
+
+inline f32x4 Abs(f32x4 a)
+{
+    return AndNot(a, f32x4::Splat(-0.f));
+}
+
+// 8 wide float lanes, a pair of f32x4 without AVX
+struct f32x8 {
+    static constexpr i32 WIDTH = 8;
+
+#if PLGR_AVX
+    __m256 v;
+#else
+    f32x4 lo;
+    f32x4 hi;
+#endif
+
+    static f32x8 Splat(f32 f)
+    {
+#if PLGR_AVX
+        return { _mm256_set1_ps(f) };
+#else
+        return { f32x4::Splat(f), f32x4::Splat(f) };
+#endif
+    }
+
+    static f32x8 Load(f32 const* src)
+    {
+#if PLGR_AVX
+        return { _mm256_loadu_ps(src) };
+#else
+        return { f32x4::Load(src), f32x4::Load(src + 4) };
+#endif
+    }
+
+    void Store(f32* dst) const
+    {
+#if PLGR_AVX
+        _mm256_storeu_ps(dst, v);
+#else
+        lo.Store(dst);
+        hi.Store(dst + 4);
+#endif
+    }
+
+    f32 Get(i32 lane) const
+    {
+        alignas(32) f32 lanes[WIDTH];
+        Store(lanes);
+        return lanes[lane];
+    }
+};
+
+#if PLGR_AVX
+
+inline f32x8 operator+(f32x8 a, f32x8 b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline f32x8 operator-(f32x8 a, f32x8 b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline f32x8 operator*(f32x8 a, f32x8 b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline f32x8 operator/(f32x8 a, f32x8 b) { return { _mm256_div_ps(a.v, b.v) }; }
+inline f32x8 Min(f32x8 a, f32x8 b) { return { _mm256_min_ps(a.v, b.v) }; }
+inline f32x8 Max(f32x8 a, f32x8 b) { return { _mm256_max_ps(a.v, b.v) }; }
+inline f32x8 Sqrt(f32x8 a) { return { _mm256_sqrt_ps(a.v) }; }
+inline f32x8 CmpLt(f32x8 a, f32x8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline f32x8 CmpLe(f32x8 a, f32x8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+inline f32x8 CmpGt(f32x8 a, f32x8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+inline f32x8 CmpGe(f32x8 a, f32x8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+inline f32x8 And(f32x8 a, f32x8 b) { return { _mm256_and_ps(a.v, b.v) }; }
+inline f32x8 Or(f32x8 a, f32x8 b) { return { _mm256_or_ps(a.v, b.v) }; }
+inline f32x8 AndNot(f32x8 a, f32x8 b) { return { _mm256_andnot_ps(b.v, a.v) }; }
+inline i32 MoveMask(f32x8 mask) { return _mm256_movemask_ps(mask.v); }
+inline f32x8 Select(f32x8 mask, f32x8 a, f32x8 b) { return { _mm256_blendv_ps(b.v, a.v, mask.v) }; }
+
+#else
+
+inline f32x8 operator+(f32x8 a, f32x8 b) { return { a.lo + b.lo, a.hi + b.hi }; }
+inline f32x8 operator-(f32x8 a, f32x8 b) { return { a.lo - b.lo, a.hi - b.hi }; }
+inline f32x8 operator*(f32x8 a, f32x8 b) { return { a.lo * b.lo, a.hi * b.hi }; }
+inline f32x8 operator/(f32x8 a, f32x8 b) { return { a.lo / b.lo, a.hi / b.hi }; }
+inline f32x8 Min(f32x8 a, f32x8 b) { return { Min(a.lo, b.lo), Min(a.hi, b.hi) }; }
+inline f32x8 Max(f32x8 a, f32x8 b) { return { Max(a.lo, b.lo), Max(a.hi, b.hi) }; }
+inline f32x8 Sqrt(f32x8 a) { return { Sqrt(a.lo), Sqrt(a.hi) }; }
+inline f32x8 CmpLt(f32x8 a, f32x8 b) { return { CmpLt(a.lo, b.lo), CmpLt(a.hi, b.hi) }; }
+inline f32x8 CmpLe(f32x8 a, f32x8 b) { return { CmpLe(a.lo, b.lo), CmpLe(a.hi, b.hi) }; }
+inline f32x8 CmpGt(f32x8 a, f32x8 b) { return { CmpGt(a.lo, b.lo), CmpGt(a.hi, b.hi) }; }
+inline f32x8 CmpGe(f32x8 a, f32x8 b) { return { CmpGe(a.lo, b.lo), CmpGe(a.hi, b.hi) }; }
+inline f32x8 And(f32x8 a, f32x8 b) { return { And(a.lo, b.lo), And(a.hi, b.hi) }; }
+inline f32x8 Or(f32x8 a, f32x8 b) { return { Or(a.lo, b.lo), Or(a.hi, b.hi) }; }
+inline f32x8 AndNot(f32x8 a, f32x8 b) { return { AndNot(a.lo, b.lo), AndNot(a.hi, b.hi) }; }
+inline i32 MoveMask(f32x8 mask) { return MoveMask(mask.lo) | (MoveMask(mask.hi) << 4); }
+inline f32x8 Select(f32x8 mask, f32x8 a, f32x8 b) { return { Select(mask.lo, a.lo, b.lo), Select(mask.hi, a.hi, b.hi) }; }
+
+#endif
+
+inline f32x8 Abs(f32x8 a)
+{
+    return AndNot(a, f32x8::Splat(-0.f));
+}
+
+// 4 wide int lanes, only comparisons for searching sorted tables
+struct i32x4 {
+    static constexpr i32 WIDTH = 4;
+
+#if PLGR_SSE
+    __m128i v;
+#else
+    i32 v[4];
+#endif
+
+    static i32x4 Splat(i32 i)
+    {
+#if PLGR_SSE
+        return { _mm_set1_epi32(i) };
+#else
+        return { { i, i, i, i } };
+#endif
+    }
+
+    static i32x4 Set(i32 a, i32 b, i32 c, i32 d)
+    {
+#if PLGR_SSE
+        return { _mm_setr_epi32(a, b, c, d) };
+#else
+        return { { a, b, c, d } };
+#endif
+    }
+
+    static i32x4 Load(i32 const* src)
+    {
+#if PLGR_SSE
+        return { _mm_loadu_si128(reinterpret_cast<__m128i const*>(src)) };
+#else
+        return { { src[0], src[1], src[2], src[3] } };
+#endif
+    }
+};
+
+#if PLGR_SSE
+inline i32x4 CmpLt(i32x4 a, i32x4 b) { return { _mm_cmplt_epi32(a.v, b.v) }; }
+inline i32x4 CmpGt(i32x4 a, i32x4 b) { return { _mm_cmpgt_epi32(a.v, b.v) }; }
+inline i32x4 Xor(i32x4 a, i32x4 b) { return { _mm_xor_si128(a.v, b.v) }; }
+inline i32 MoveMask(i32x4 mask) { return _mm_movemask_ps(_mm_castsi128_ps(mask.v)); }
+#else
+inline i32x4 CmpLt(i32x4 a, i32x4 b) { return { { -(a.v[0] < b.v[0]), -(a.v[1] < b.v[1]), -(a.v[2] < b.v[2]), -(a.v[3] < b.v[3]) } }; }
+inline i32x4 CmpGt(i32x4 a, i32x4 b) { return CmpLt(b, a); }
+inline i32x4 Xor(i32x4 a, i32x4 b) { return { { a.v[0] ^ b.v[0], a.v[1] ^ b.v[1], a.v[2] ^ b.v[2], a.v[3] ^ b.v[3] } }; }
+inline i32 MoveMask(i32x4 mask)
+{
+    i32 bits = 0;
+    for (i32 i = 0; i < i32x4::WIDTH; i++) {
+        bits |= As<i32>(As<u32>(mask.v[i]) >> 31) << i;
+    }
+    return bits;
+}
+#endif
+
+// hint to pull the cache line holding address into all cache levels
+inline void Prefetch(void const* address)
+{
+#if PLGR_SSE
+    _mm_prefetch(static_cast<char const*>(address), _MM_HINT_T0);
+#elif defined(__GNUC__)
+    __builtin_prefetch(address);
+#else
+    (void)address;
+#endif
+}
+
+// widest vector the build targets, for kernels that only need a lane count
+#if PLGR_AVX
+using f32xN = f32x8;
+#else
+using f32xN = f32x4;
+#endif
+
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "array.h"
+#include "Slice.h"
+#include "Simd.h"
+
+#include <bit>
+
+namespace Playground {
+
+// read-only sorted table for lookups into arrays too large for the cache
+// keys are stored in Eytzinger order: the root at 1 and the children of k at 2k and 2k + 1, the top levels of
+// the search are packed together and stay cached, and the children 4 levels below are one cache line that is
+// prefetched while the current levels are compared, a binary search instead waits on a cold line every step
+// results are positions in the sorted input, same as LowerBound on it
+template <typename T>
+struct SortedIndex {
+    static constexpr i64 CACHE_LINE = 64;
+    static_assert(CACHE_LINE % sizeof(T) == 0);
+    static constexpr i64 KEYS_PER_LINE = CACHE_LINE / sizeof(T);
+
+    // slot 0 starts a cache line so every group of descendants is on one, the allocation keeps that through copies
+    struct alignas(CACHE_LINE) Line {
+        T keys[KEYS_PER_LINE];
+    };
+
+    Array<Line> storage_;
+    // position in the sorted input of the key in every slot
+    Array<i32> ranks_;
+    i64 num_ = 0;
+
+    void Build(Slice<T const> sorted)
+    {
+        plgr_assert(sorted.num < i64(1) << 31);
+
+        num_ = sorted.num;
+        storage_.Clear();
+        ranks_.Clear();
+        storage_.ResizeUninitialised(num_ / KEYS_PER_LINE + 1);
+        ranks_.ResizeUninitialised(num_ + 1);
+
+        i64 next = 0;
+        _Fill(sorted, next, 1);
+    }
+
+    i64 Size() const
+    {
+        return num_;
+    }
+
+    // first position whose key isn't less than value, Size() when there's none
+    i64 LowerBound(T value) const
+    {
+        i64 slot = _LowerBoundSlot(value);
+        return slot == 0 ? num_ : ranks_[slot];
+    }
+
+    // position of a key equal to value
+    Optional<i64> Find(T value) const
+    {
+        i64 slot = _LowerBoundSlot(value);
+        if (slot == 0 || value < _Keys()[slot]) {
+            return NullOpt;
+        }
+        return i64(ranks_[slot]);
+    }
+
+    T const* _Keys() const
+    {
+        return reinterpret_cast<T const*>(storage_.Data());
+    }
+
+    // every step goes left when the key isn't less than value, the answer is the last slot that went left
+    // the trailing ones of the final slot are the right turns taken after it, shifting them out leaves that slot
+    i64 _LowerBoundSlot(T value) const
+    {
+        T const* keys = _Keys();
+        u64 slot = 1;
+        while (slot <= u64(num_)) {
+            Prefetch(keys + KEYS_PER_LINE * slot);
+            slot = 2 * slot + (keys[slot] < value);
+        }
+        slot >>= std::countr_one(slot) + 1;
+        return As<i64>(slot);
+    }
+
+    // in-order walk of the implicit tree hands out the sorted keys in order
+    void _Fill(Slice<T const> sorted, i64& next, i64 slot)
+    {
+        if (slot > num_) {
+            return;
+        }
+        _Fill(sorted, next, 2 * slot);
+        reinterpret_cast<T*>(storage_.Data())[slot] = sorted.data[next];
+        ranks_[slot] = As<i32>(next);
+        next++;
+        _Fill(sorted, next, 2 * slot + 1);
+    }
+};
+
+}
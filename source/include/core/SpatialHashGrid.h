@@ -0,0 +1,125 @@
+#pragma once
+#include "Geometry.h"
+#include "hashmap.h"
+
+namespace Playground {
+
+// loose uniform grid over many similarly sized moving objects, an alternative broadphase to DynamicBvh
+// rebuilt from scratch every frame: an object goes into the cell of its centre, objects of a cell are contiguous
+// queries grow by the largest half extent, cell_size_ works best around the usual query size and no smaller than the objects
+// few large objects make every query visit more cells, those are better kept in a DynamicBvh
+struct SpatialHashGrid {
+    // index of the object's bounds in the last Rebuild()
+    struct Handle {
+        i32 index;
+    };
+
+    struct Cell {
+        i32 begin;
+        i32 num;
+    };
+
+    f32 cell_size_ = 1.f;
+
+    // cell key -> index into cells_
+    Hashmap<u64, i32> cell_ids_;
+    Array<Cell> cells_;
+    // grouped by cell, cells_[i] spans [begin, begin + num)
+    Array<Aabb3D> sorted_bounds_;
+    Array<i32> sorted_handles_;
+    // per object cell index, kept between rebuilds to avoid reallocation
+    Array<i32> object_cells_;
+
+    // largest half extent of any object
+    Vector3 margin_;
+    // range of occupied cells, queries are clamped to it
+    Vector3i cell_min_;
+    Vector3i cell_max_;
+
+    // counting sort of the objects by cell, handles are indices into bounds
+    void Rebuild(Slice<Aabb3D> bounds);
+
+    bool Empty() const;
+    // cells are clamped to +-2^20 per axis so every cell has a unique key
+    Vector3i _CellOf(Vector3 point) const;
+    static u64 _Key(Vector3i cell);
+
+    // same queries and results as their DynamicBvh counterparts
+    Optional<Handle> FindClosest(Vector3 point, f32 max_distance) const;
+    // appends up to k objects within max_distance, nearest first
+    // searches shells of cells outwards until nothing farther can be closer
+    void FindKClosest(Vector3 point, i32 k, f32 max_distance, Array<Handle>& out) const;
+    bool FindAllIntersecting(Vector3 point, Array<Handle>& out) const;
+
+    // visitor(Handle) -> bool is called for every object overlapping the query, false stops
+    template <typename F>
+    void QueryAabb(Aabb3D const& bounds, F&& visitor) const;
+    template <typename F>
+    void QuerySphere(Sphere3D const& sphere, F&& visitor) const;
+
+    // visits objects in cells touched by region grown by margin_ that pass overlaps(Aabb3D)
+    template <typename Overlaps, typename F>
+    void _Query(Aabb3D const& region, Overlaps&& overlaps, F&& visitor) const;
+};
+
+template <typename F>
+void SpatialHashGrid::QueryAabb(Aabb3D const& bounds, F&& visitor) const
+{
+    auto overlaps = [&bounds](Aabb3D const& object_bounds) { return object_bounds.Overlaps(bounds); };
+    _Query(bounds, overlaps, std::forward<F>(visitor));
+}
+
+template <typename F>
+void SpatialHashGrid::QuerySphere(Sphere3D const& sphere, F&& visitor) const
+{
+    Aabb3D region = Aabb3D::From(sphere.position - Vector3 { sphere.radius }, sphere.position + Vector3 { sphere.radius });
+    auto overlaps = [&sphere](Aabb3D const& object_bounds) { return object_bounds.Distance(sphere.position) <= sphere.radius; };
+    _Query(region, overlaps, std::forward<F>(visitor));
+}
+
+template <typename Overlaps, typename F>
+void SpatialHashGrid::_Query(Aabb3D const& region, Overlaps&& overlaps, F&& visitor) const
+{
+    if (Empty()) {
+        return;
+    }
+
+    Vector3i first = Math::max(_CellOf(region.vec_min - margin_), cell_min_);
+    Vector3i last = Math::min(_CellOf(region.vec_max + margin_), cell_max_);
+    if ((first > last).any()) {
+        return;
+    }
+
+    auto visit = [&](Cell cell) {
+        for (i32 i = cell.begin; i < cell.begin + cell.num; i++) {
+            if (overlaps(sorted_bounds_[i]) && !visitor(Handle { sorted_handles_[i] })) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // probing mostly empty cells is slower than going through the occupied ones
+    Vector3i span = last - first + Vector3i { 1 };
+    if (i64 { span.x() } * span.y() * span.z() > cells_.Size()) {
+        for (i64 i = 0; i < cells_.Size(); i++) {
+            if (!visit(cells_[i])) {
+                return;
+            }
+        }
+        return;
+    }
+
+    for (i32 z = first.z(); z <= last.z(); z++) {
+        for (i32 y = first.y(); y <= last.y(); y++) {
+            for (i32 x = first.x(); x <= last.x(); x++) {
+                Optional<i32*> id = cell_ids_.Find(_Key({ x, y, z }));
+                if (id && !visit(cells_[**id])) {
+                    return;
+                }
+            }
+        }
+    }
+}
+
+}
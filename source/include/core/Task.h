@@ -0,0 +1,343 @@
+#pragma once
+#include "Types.h"
+#include "Array.h"
+#include "box.h"
+#include "Jobs.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+
+namespace Playground {
+
+template <typename T>
+struct Task;
+struct TaskLoop;
+
+// runs coroutines on the one thread that calls Run, for the work that has to stay there, like talking to the device
+// coroutines are resumed when another thread posts them back, or when a polled condition they wait on comes true,
+// between those the thread helps with jobs, and sleeps once there are none
+struct TaskLoop : private Pinned<TaskLoop> {
+    // how often polls are checked while the loop sleeps and none of them can be waited on
+    static constexpr std::chrono::milliseconds POLL_INTERVAL { 1 };
+
+    struct Poll {
+        bool (*is_done)(void* data);
+        // blocks until is_done would return true, null when the condition can only be polled
+        void (*wait)(void* data);
+        void* data;
+        std::coroutine_handle<> handle;
+    };
+
+    JobSystem* jobs_ = nullptr;
+
+    std::mutex ready_mutex_;
+    // signalled by Post
+    std::condition_variable wake_;
+    Array<std::coroutine_handle<>> ready_;
+    // loop thread only
+    Array<Poll> polls_;
+
+    explicit TaskLoop(JobSystem* jobs = nullptr);
+
+    // loop running on the calling thread, null outside of Run
+    static TaskLoop* Current();
+
+    // runs task and the loop until the task finishes
+    template <typename T>
+    T Run(Task<T> task);
+
+    // any thread, handle is resumed on the loop thread
+    void Post(std::coroutine_handle<> handle);
+    // loop thread only
+    void AddPoll(Poll poll);
+    // resumes one posted coroutine, or one whose poll came true, false when there was none
+    bool RunOne();
+    // called when RunOne and the jobs had nothing, blocks until a coroutine is posted
+    // when the only poll left can be waited on it blocks in its wait instead, posts then wait for it to return,
+    // other polls are checked every POLL_INTERVAL
+    void Sleep();
+
+    // co_await loop.Schedule() continues the coroutine on the loop thread
+    auto Schedule()
+    {
+        struct Awaiter {
+            TaskLoop* loop_;
+
+            bool await_ready() const { return Current() == loop_; }
+            void await_suspend(std::coroutine_handle<> handle) { loop_->Post(handle); }
+            void await_resume() { }
+        };
+        return Awaiter { this };
+    }
+
+    static TaskLoop* _SetCurrent(TaskLoop* loop);
+};
+
+// state shared by the promises of every Task<T>
+// continuation_ is null while nothing waits on the task, the address of the awaiting coroutine once something does,
+// and the promise's own address once the task has finished, whichever of the two arrives second resumes the awaiter
+struct _TaskPromiseBase {
+    std::atomic<void*> continuation_ = nullptr;
+    // loop of the thread the awaiter suspended on, null when it wasn't on one
+    TaskLoop* continuation_loop_ = nullptr;
+
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            return handle.promise()._Finish();
+        }
+
+        void await_resume() noexcept { }
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    // the engine is built without exceptions
+    void unhandled_exception() { std::terminate(); }
+
+    bool _IsDone() const
+    {
+        return continuation_.load(std::memory_order_acquire) == this;
+    }
+
+    // marks the task as finished, returns the awaiter when it should continue on this thread
+    std::coroutine_handle<> _Finish();
+};
+
+template <typename T>
+struct _TaskPromise : _TaskPromiseBase {
+    Optional<T> value_;
+
+    Task<T> get_return_object();
+    void return_value(T value) { value_ = std::move(value); }
+
+    T _TakeResult()
+    {
+        plgr_assert(value_);
+        return std::move(*value_);
+    }
+};
+
+template <>
+struct _TaskPromise<void> : _TaskPromiseBase {
+    Task<void> get_return_object();
+    void return_void() { }
+    void _TakeResult() { }
+};
+
+// coroutine producing a T, it doesn't run until it's started or awaited
+// co_await on a task that hasn't started runs it right away on the awaiting thread, on one that was started it
+// suspends until the task finishes, the awaiter then continues on the thread that finished it, or back on its
+// TaskLoop when it awaited from one
+// a task that was started has to have finished before it's destroyed
+template <typename T>
+struct Task : private MoveableNonCopyable<Task<T>> {
+    using promise_type = _TaskPromise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    struct Awaiter {
+        Task* task_;
+
+        bool await_ready() const
+        {
+            return task_->IsDone();
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting)
+        {
+            promise_type& promise = task_->handle_.promise();
+            promise.continuation_loop_ = TaskLoop::Current();
+
+            if (!task_->started_) {
+                // nothing else can finish it, the task runs here and resumes the awaiter when it's done
+                task_->started_ = true;
+                promise.continuation_.store(awaiting.address(), std::memory_order_release);
+                return task_->handle_;
+            }
+
+            void* expected = nullptr;
+            if (promise.continuation_.compare_exchange_strong(expected, awaiting.address(), std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return std::noop_coroutine();
+            }
+            // finished in the meantime
+            return awaiting;
+        }
+
+        T await_resume()
+        {
+            return task_->handle_.promise()._TakeResult();
+        }
+    };
+
+    Handle handle_;
+    bool started_ = false;
+
+    Task() = default;
+    explicit Task(Handle handle)
+        : handle_(handle)
+    {
+    }
+
+    Task(Task&& other)
+        : handle_(std::exchange(other.handle_, nullptr))
+        , started_(other.started_)
+    {
+    }
+
+    Task& operator=(Task&& other)
+    {
+        _Destroy();
+        handle_ = std::exchange(other.handle_, nullptr);
+        started_ = other.started_;
+        return *this;
+    }
+
+    Task(Task const&) = delete;
+    Task& operator=(Task const&) = delete;
+
+    ~Task()
+    {
+        _Destroy();
+    }
+
+    // runs the task on the calling thread until its first suspension, usually a SwitchTo onto the workers,
+    // and leaves the rest running in the background
+    void Start()
+    {
+        plgr_assert(handle_ && !started_);
+        started_ = true;
+        handle_.resume();
+    }
+
+    bool IsDone() const
+    {
+        return handle_.promise()._IsDone();
+    }
+
+    Awaiter operator co_await()
+    {
+        plgr_assert(handle_);
+        return { this };
+    }
+
+    void _Destroy()
+    {
+        if (handle_) {
+            plgr_assert(!started_ || IsDone());
+            handle_.destroy();
+            handle_ = nullptr;
+        }
+    }
+};
+
+template <typename T>
+Task<T> _TaskPromise<T>::get_return_object()
+{
+    return Task<T> { std::coroutine_handle<_TaskPromise<T>>::from_promise(*this) };
+}
+
+inline Task<void> _TaskPromise<void>::get_return_object()
+{
+    return Task<void> { std::coroutine_handle<_TaskPromise<void>>::from_promise(*this) };
+}
+
+inline Task<void> _Nothing()
+{
+    co_return;
+}
+
+template <typename T>
+T TaskLoop::Run(Task<T> task)
+{
+    TaskLoop* previous = _SetCurrent(this);
+
+    // the loop awaits the task with one that does nothing, when the task finishes on another thread that one is
+    // posted back, which wakes the loop, and the loop only returns once it ran so nothing is still posting to it
+    Task<void> finished = _Nothing();
+    finished.started_ = true;
+    plgr_assert(task.handle_ && !task.started_);
+    task.started_ = true;
+    task.handle_.promise().continuation_loop_ = this;
+    task.handle_.promise().continuation_.store(finished.handle_.address(), std::memory_order_release);
+    task.handle_.resume();
+
+    while (!finished.IsDone()) {
+        if (!RunOne() && !(jobs_ && jobs_->RunOne())) {
+            Sleep();
+        }
+    }
+
+    _SetCurrent(previous);
+    return task.handle_.promise()._TakeResult();
+}
+
+struct _NoWait {
+};
+
+// co_await suspends until is_done() returns true, checked by the current TaskLoop between its other work
+// for things that can't wake anybody up themselves, like gpu fences
+// wait() blocks until is_done() would be true, the loop calls it instead of sleeping when nothing else is pending
+template <typename F, typename W = _NoWait>
+struct PollAwaiter {
+    F is_done_;
+    W wait_;
+
+    bool await_ready()
+    {
+        return is_done_();
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        TaskLoop* loop = TaskLoop::Current();
+        plgr_assert(loop);
+
+        TaskLoop::Poll poll { .is_done = [](void* data) { return static_cast<PollAwaiter*>(data)->is_done_(); }, .wait = nullptr, .data = this, .handle = handle };
+        if constexpr (!std::is_same_v<W, _NoWait>) {
+            poll.wait = [](void* data) { static_cast<PollAwaiter*>(data)->wait_(); };
+        }
+        loop->AddPoll(poll);
+    }
+
+    void await_resume() { }
+};
+
+template <typename F>
+PollAwaiter<std::decay_t<F>> PollUntil(F&& is_done)
+{
+    return { std::forward<F>(is_done) };
+}
+
+template <typename F, typename W>
+PollAwaiter<std::decay_t<F>, std::decay_t<W>> PollUntil(F&& is_done, W&& wait)
+{
+    return { std::forward<F>(is_done), std::forward<W>(wait) };
+}
+
+// co_await SwitchTo(jobs) continues the coroutine as a job on one of the workers
+inline auto SwitchTo(JobSystem& jobs)
+{
+    struct Awaiter {
+        JobSystem* jobs_;
+
+        bool await_ready() const { return false; }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            jobs_->SubmitDetached({ .function = [](void* data, i64, i64) { std::coroutine_handle<>::from_address(data).resume(); },
+                .data = handle.address() });
+        }
+
+        void await_resume() { }
+    };
+    return Awaiter { &jobs };
+}
+
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "DynamicBvh.h"
+#include "Aabb3DPacket.h"
+
+namespace Playground {
+
+// read only collapse of a DynamicBvh with WIDTH children per node, for query heavy phases
+// a node tests all of its children's boxes at once, leaves use their tight bounds
+// the DynamicBvh stays the tree that gets modified, this one is rebuilt from it
+template <typename V>
+struct WideBvh {
+    static constexpr i32 WIDTH = V::WIDTH;
+
+    using Handle = DynamicBvh::Handle;
+    using RayHit = DynamicBvh::RayHit;
+
+    struct Node {
+        // unused lanes are empty
+        Aabb3DPacket<V> child_bounds;
+        // node index, or the leaf's handle for lanes in leaf_mask
+        i32 children[WIDTH];
+        i32 leaf_mask;
+    };
+
+    // depth first, nodes_[0] is the root and children come after their parent
+    Array<Node> nodes_;
+
+    // collapses the subtrees with the largest area first until WIDTH children are gathered
+    void Build(DynamicBvh const& source);
+    // refreshes the bounds of leaves moved since Build, keeps the topology
+    // the set of handles must not have changed, query quality drops the further leaves move
+    void Refit(DynamicBvh const& source);
+
+    bool Empty() const;
+    i32 GetDepth() const;
+
+    // same queries and results as their DynamicBvh counterparts
+    bool FindAllIntersecting(Vector3 point, Array<Handle>& out) const;
+    Optional<Handle> FindClosest(Vector3 point, f32 max_distance) const;
+    void FindKClosest(Vector3 point, i32 k, f32 max_distance, Array<Handle>& out) const;
+    Optional<RayHit> RayCastClosest(Vector3 origin, Vector3 direction, f32 max_t) const;
+
+    template <typename F>
+    void QueryAabb(Aabb3D const& bounds, F&& visitor) const;
+    template <typename F>
+    void QuerySphere(Sphere3D const& sphere, F&& visitor) const;
+
+    // returns the tight bounds of the subtree
+    Aabb3D _Collapse(DynamicBvh const& source, i32 source_node);
+    // overlaps(Aabb3DPacket) -> V lane mask
+    template <typename Overlaps, typename F>
+    void _Query(Overlaps&& overlaps, F&& visitor) const;
+};
+
+using Bvh4 = WideBvh<f32x4>;
+using Bvh8 = WideBvh<f32x8>;
+
+template <typename V>
+template <typename F>
+void WideBvh<V>::QueryAabb(Aabb3D const& bounds, F&& visitor) const
+{
+    auto overlaps = [&bounds](Aabb3DPacket<V> const& packet) { return packet.Overlaps(bounds); };
+    _Query(overlaps, std::forward<F>(visitor));
+}
+
+template <typename V>
+template <typename F>
+void WideBvh<V>::QuerySphere(Sphere3D const& sphere, F&& visitor) const
+{
+    V radius_squared = V::Splat(sphere.radius * sphere.radius);
+    auto overlaps = [&sphere, radius_squared](Aabb3DPacket<V> const& packet) { return CmpLe(packet.DistanceSquared(sphere.position), radius_squared); };
+    _Query(overlaps, std::forward<F>(visitor));
+}
+
+template <typename V>
+template <typename Overlaps, typename F>
+void WideBvh<V>::_Query(Overlaps&& overlaps, F&& visitor) const
+{
+    if (Empty()) {
+        return;
+    }
+
+    Array<i32> stack;
+    stack.PushBack(0);
+
+    while (stack.Size()) {
+        Node const& node = nodes_[stack.PopBack()];
+
+        for (i32 mask = MoveMask(overlaps(node.child_bounds)); mask; mask &= mask - 1) {
+            i32 lane = std::countr_zero(As<u32>(mask));
+            if (node.leaf_mask & (1 << lane)) {
+                if (!visitor(Handle { node.children[lane] })) {
+                    return;
+                }
+            } else {
+                stack.PushBack(node.children[lane]);
+            }
+        }
+    }
+}
+
+}
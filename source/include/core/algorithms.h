@@ -1,8 +1,17 @@
 #pragma once
 
 #include "types.h"
+#include "array.h"
+#include "Slice.h"
+#include "Soa.h"
+#include "Simd.h"
+
+#include <bit>
 
 namespace Playground {
+
+struct JobSystem;
+
 template <typename T>
 i64 LowerBound(const T* array, i64 size, T value)
 {
@@ -22,5 +31,312 @@ i64 LowerBound(const T* array, i64 size, T value)
     return l;
 }
 
+// first element greater than value
+template <typename T>
+i64 UpperBound(const T* array, i64 size, T value)
+{
+    i64 l = 0;
+    i64 c = size;
+    while (c > 0) {
+        i64 step = c / 2;
+        if (!(value < array[l + step])) {
+            l = l + step + 1;
+            c -= step + 1;
+        } else {
+            c = step;
+        }
+    }
+
+    return l;
+}
+
+// same results as LowerBound/UpperBound, the halving always takes the same number of steps and the comparison
+// picks the half with a conditional move, there's no branch to mispredict on random lookups
+template <typename T>
+i64 LowerBoundBranchless(const T* array, i64 size, T value)
+{
+    if (size == 0) {
+        return 0;
+    }
+
+    const T* base = array;
+    i64 n = size;
+    while (n > 1) {
+        i64 half = n / 2;
+        base = base[half] < value ? base + half : base;
+        n -= half;
+    }
+
+    return (base - array) + (*base < value);
+}
+
+template <typename T>
+i64 UpperBoundBranchless(const T* array, i64 size, T value)
+{
+    if (size == 0) {
+        return 0;
+    }
+
+    const T* base = array;
+    i64 n = size;
+    while (n > 1) {
+        i64 half = n / 2;
+        base = !(value < base[half]) ? base + half : base;
+        n -= half;
+    }
+
+    return (base - array) + !(value < *base);
+}
+
+// vector type and key mapping of the keys LowerBoundSimd supports, u32 is biased so the signed lane compare orders it
+template <typename T>
+struct _SearchLanes;
+
+template <>
+struct _SearchLanes<f32> {
+    using V = f32x4;
+    static f32 Map(f32 x) { return x; }
+    static V Strided(f32 const* first, i64 step) { return V::Set(first[0], first[step], first[2 * step], first[3 * step]); }
+};
+
+template <>
+struct _SearchLanes<i32> {
+    using V = i32x4;
+    static i32 Map(i32 x) { return x; }
+    static V Strided(i32 const* first, i64 step) { return V::Set(first[0], first[step], first[2 * step], first[3 * step]); }
+};
+
+template <>
+struct _SearchLanes<u32> {
+    using V = i32x4;
+    static i32 Map(u32 x) { return As<i32>(x ^ 0x80000000u); }
+    static V Strided(u32 const* first, i64 step) { return V::Set(Map(first[0]), Map(first[step]), Map(first[2 * step]), Map(first[3 * step])); }
+};
+
+// k-ary search: WIDTH keys split the range into WIDTH + 1 parts and one vector compare picks the part,
+// the WIDTH loads of a step are independent so their cache misses overlap, a binary search takes log2(WIDTH + 1)
+// dependent steps for the same narrowing, the last few keys are left to LowerBoundBranchless
+// same result as LowerBound, for f32, i32 and u32 keys
+template <typename T>
+i64 LowerBoundSimd(const T* array, i64 size, T value)
+{
+    using Lanes = _SearchLanes<T>;
+    using V = typename Lanes::V;
+    constexpr i64 WIDTH = V::WIDTH;
+
+    V needle = V::Splat(Lanes::Map(value));
+
+    i64 begin = 0;
+    i64 n = size;
+    while (n > 2 * WIDTH) {
+        i64 step = n / (WIDTH + 1);
+
+        // the last key of every part but the final one, parts ending below value are a prefix
+        // and the lower bound is in the part after them
+        V separators = Lanes::Strided(array + begin + step - 1, step);
+        i64 below = std::popcount(As<u32>(MoveMask(CmpLt(separators, needle))));
+        begin += below * step;
+        n = below == WIDTH ? n - WIDTH * step : step;
+    }
+
+    return begin + LowerBoundBranchless(array + begin, n, value);
+}
+
 f32 Frac(f32 x);
-}
\ No newline at end of file
+
+// LSD radix sort of u32 or u64 keys, values[i] moves along with keys[i], stable
+// 8 bits per pass, a pass is skipped when every key has the same digit, so narrow keys in wide types are cheap
+template <typename K, typename T>
+void RadixSort(Slice<K> keys, Slice<T> values);
+// every pass counts and scatters chunks of the keys on the workers
+template <typename K, typename T>
+void RadixSort(Slice<K> keys, Slice<T> values, JobSystem& jobs);
+
+// sorts values by key(value) -> u32 or u64, stable
+template <typename T, typename F>
+void RadixSortBy(Slice<T> values, F&& key);
+template <typename T, typename F>
+void RadixSortBy(Slice<T> values, F&& key, JobSystem& jobs);
+
+// reorders every column of soa by key(element of column KeyIndex) -> u32 or u64, stable
+template <i32 KeyIndex, typename... Types, typename F>
+void RadixSortBy(Soa<Types...>& soa, F&& key);
+template <i32 KeyIndex, typename... Types, typename F>
+void RadixSortBy(Soa<Types...>& soa, F&& key, JobSystem& jobs);
+
+// f(begin, end) over [0, num), split into _RadixChunkSize chunks on the workers when jobs is given
+void _ForChunks(JobSystem* jobs, i64 num, i64 grain, void (*function)(void* data, i64 begin, i64 end), void* data);
+i64 _RadixChunkSize(JobSystem* jobs, i64 num);
+
+template <typename F>
+void _ForChunks(JobSystem* jobs, i64 num, i64 grain, F& f)
+{
+    _ForChunks(jobs, num, grain, [](void* data, i64 begin, i64 end) { (*static_cast<F*>(data))(begin, end); }, &f);
+}
+
+template <typename K, typename T>
+void _RadixSort(Slice<K> keys, Slice<T> values, JobSystem* jobs)
+{
+    static_assert(std::is_same_v<K, u32> || std::is_same_v<K, u64>);
+    static_assert(std::is_trivially_copyable_v<T>);
+    plgr_assert(keys.num == values.num);
+
+    constexpr i32 BITS = 8;
+    constexpr i32 BUCKETS = 1 << BITS;
+
+    i64 num = keys.num;
+    if (num < 2) {
+        return;
+    }
+
+    i64 chunk = _RadixChunkSize(jobs, num);
+    i64 chunks = (num + chunk - 1) / chunk;
+
+    Array<K> scratch_keys;
+    Array<T> scratch_values;
+    scratch_keys.ResizeUninitialised(num);
+    scratch_values.ResizeUninitialised(num);
+
+    K* src_keys = keys.data;
+    T* src_values = values.data;
+    K* dst_keys = scratch_keys.Data();
+    T* dst_values = scratch_values.Data();
+
+    // per chunk counts of every digit, then where the chunk writes its next key of that digit
+    Array<i64> offsets;
+
+    for (i32 shift = 0; shift < i32(sizeof(K) * 8); shift += BITS) {
+        offsets.Clear();
+        offsets.Resize(chunks * BUCKETS);
+
+        auto count = [&](i64 begin, i64 end) {
+            i64* counts = offsets.Data() + begin / chunk * BUCKETS;
+            for (i64 i = begin; i < end; i++) {
+                counts[(src_keys[i] >> shift) & (BUCKETS - 1)]++;
+            }
+        };
+        _ForChunks(jobs, num, chunk, count);
+
+        i64 first_digit = (src_keys[0] >> shift) & (BUCKETS - 1);
+        i64 first_digit_num = 0;
+        for (i64 c = 0; c < chunks; c++) {
+            first_digit_num += offsets[c * BUCKETS + first_digit];
+        }
+        if (first_digit_num == num) {
+            continue;
+        }
+
+        i64 offset = 0;
+        for (i32 digit = 0; digit < BUCKETS; digit++) {
+            for (i64 c = 0; c < chunks; c++) {
+                i64 digit_num = offsets[c * BUCKETS + digit];
+                offsets[c * BUCKETS + digit] = offset;
+                offset += digit_num;
+            }
+        }
+
+        auto scatter = [&](i64 begin, i64 end) {
+            i64* next = offsets.Data() + begin / chunk * BUCKETS;
+            for (i64 i = begin; i < end; i++) {
+                i64 slot = next[(src_keys[i] >> shift) & (BUCKETS - 1)]++;
+                dst_keys[slot] = src_keys[i];
+                dst_values[slot] = src_values[i];
+            }
+        };
+        _ForChunks(jobs, num, chunk, scatter);
+
+        Swap(src_keys, dst_keys);
+        Swap(src_values, dst_values);
+    }
+
+    // an odd number of passes left the result in the scratch arrays
+    if (src_keys != keys.data) {
+        memcpy(keys.data, src_keys, num * sizeof(K));
+        memcpy(values.data, src_values, num * sizeof(T));
+    }
+}
+
+template <typename K, typename T>
+void RadixSort(Slice<K> keys, Slice<T> values)
+{
+    _RadixSort(keys, values, nullptr);
+}
+
+template <typename K, typename T>
+void RadixSort(Slice<K> keys, Slice<T> values, JobSystem& jobs)
+{
+    _RadixSort(keys, values, &jobs);
+}
+
+template <typename T, typename F>
+void _RadixSortBy(Slice<T> values, F& key, JobSystem* jobs)
+{
+    using K = std::remove_cvref_t<decltype(key(values.data[0]))>;
+
+    Array<K> keys;
+    keys.ResizeUninitialised(values.num);
+    auto extract = [&](i64 begin, i64 end) {
+        for (i64 i = begin; i < end; i++) {
+            keys[i] = key(values.data[i]);
+        }
+    };
+    _ForChunks(jobs, values.num, _RadixChunkSize(jobs, values.num), extract);
+
+    _RadixSort(Slice<K> { .data = keys.Data(), .num = keys.Size() }, values, jobs);
+}
+
+template <typename T, typename F>
+void RadixSortBy(Slice<T> values, F&& key)
+{
+    _RadixSortBy(values, key, nullptr);
+}
+
+template <typename T, typename F>
+void RadixSortBy(Slice<T> values, F&& key, JobSystem& jobs)
+{
+    _RadixSortBy(values, key, &jobs);
+}
+
+template <i32 KeyIndex, typename... Types, typename F>
+void _RadixSortBy(Soa<Types...>& soa, F& key, JobSystem* jobs)
+{
+    auto& key_column = soa.template _ArrayFromIndex<KeyIndex>();
+    using K = std::remove_cvref_t<decltype(key(key_column[0]))>;
+
+    // the permutation is sorted once and applied to every column
+    i64 num = soa.Size();
+    Array<K> keys;
+    Array<i32> order;
+    keys.ResizeUninitialised(num);
+    order.ResizeUninitialised(num);
+    for (i64 i = 0; i < num; i++) {
+        keys[i] = key(key_column[i]);
+        order[i] = As<i32>(i);
+    }
+
+    _RadixSort(Slice<K> { .data = keys.Data(), .num = num }, Slice<i32> { .data = order.Data(), .num = num }, jobs);
+
+    soa._ForEach([&](auto& column, auto) {
+        using Column = std::remove_reference_t<decltype(column)>;
+        Column sorted;
+        sorted.ResizeUninitialised(num);
+        for (i64 i = 0; i < num; i++) {
+            sorted[i] = column[order[i]];
+        }
+        column = std::move(sorted);
+    });
+}
+
+template <i32 KeyIndex, typename... Types, typename F>
+void RadixSortBy(Soa<Types...>& soa, F&& key)
+{
+    _RadixSortBy<KeyIndex>(soa, key, nullptr);
+}
+
+template <i32 KeyIndex, typename... Types, typename F>
+void RadixSortBy(Soa<Types...>& soa, F&& key, JobSystem& jobs)
+{
+    _RadixSortBy<KeyIndex>(soa, key, &jobs);
+}
+
+}
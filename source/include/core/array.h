@@ -3,6 +3,7 @@
 #include "containers_shared.h"
 #include "Core.h"
 #include <string.h>
+#include <cstddef>
 
 namespace Playground {
 template <typename T>
@@ -170,8 +171,8 @@ struct Array {
         }
 
         if (max_size != max_size_) {
+            _Reallocate(max_size);
             max_size_ = max_size;
-            data_ = static_cast<T*>(realloc(data_, sizeof(T) * max_size_));
         }
     }
 
@@ -266,18 +267,37 @@ struct Array {
             return;
         }
 
-        data_ = static_cast<T*>(realloc(data_, size_ * sizeof(T)));
+        _Reallocate(size_);
         max_size_ = size_;
     }
 
     void Release()
     {
         Resize(0);
-        free(data_);
+        if constexpr (alignof(T) > alignof(std::max_align_t)) {
+            AlignedFree(data_);
+        } else {
+            free(data_);
+        }
         data_ = nullptr;
         max_size_ = 0;
     }
 
+    // realloc only guarantees max_align_t, over-aligned types move to a new block
+    void _Reallocate(i64 max_size)
+    {
+        if constexpr (alignof(T) > alignof(std::max_align_t)) {
+            T* data = static_cast<T*>(AlignedAlloc(sizeof(T) * max_size, alignof(T)));
+            if (data_) {
+                memcpy(data, data_, sizeof(T) * Min(size_, max_size));
+                AlignedFree(data_);
+            }
+            data_ = data;
+        } else {
+            data_ = static_cast<T*>(realloc(data_, sizeof(T) * max_size));
+        }
+    }
+
     const T* Data() const
     {
         return data_;
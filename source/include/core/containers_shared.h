@@ -3,6 +3,7 @@
 #include "types.h"
 #include <debug_assert/debug_assert.hpp>
 #include <stdio.h>
+#include <stdlib.h>
 #include <type_traits>
 
 namespace Playground {
@@ -11,4 +12,23 @@ struct containers_module
       debug_assert::set_level<-1> // level -1, i.e. all assertions, 0 would mean none, 1 would be level 1, 2 level 2 or lower,...
 {
 };
+
+// for element types that need more than malloc's alignment, e.g. simd packets
+inline void* AlignedAlloc(size_t size, size_t alignment)
+{
+#ifdef _MSC_VER
+    return _aligned_malloc(size, alignment);
+#else
+    return aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+#endif
+}
+
+inline void AlignedFree(void* p)
+{
+#ifdef _MSC_VER
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
 }
\ No newline at end of file
@@ -7,34 +7,70 @@
 
 namespace Playground {
 
-template <typename _ComponentIdType, typename _Indexer>
+// TrackChanges stamps every written row with the container's current version
+// so consumers (bvh, gpu upload) can visit only the rows written since they last ran
+template <typename _ComponentIdType, typename _Indexer, bool _TrackChanges = false>
 struct ComponentContainer {
     using ComponentIdType = _ComponentIdType;
+    static constexpr bool TrackChanges = _TrackChanges;
 
     _Indexer indexer_;
+    // version of the last write per flat row, moves with the rows on swap-with-last
+    Array<u32> versions_;
+    u32 version_ = 1;
 
     ComponentIdType Add()
     {
-        return indexer_.Add();
+        ComponentIdType id = indexer_.Add();
+        if constexpr (TrackChanges) {
+            versions_.PushBack(version_);
+        }
+        return id;
     }
 
     void Remove(ComponentIdType in)
     {
+        if constexpr (TrackChanges) {
+            versions_.RemoveAtAndSwapWithLast(indexer_.GetFlatIndex(in));
+        }
         indexer_.Remove(in);
     }
 
     template<i32 InnerIndex>
     auto& AtMut(ComponentIdType id)
     {
+        if constexpr (TrackChanges) {
+            versions_[indexer_.GetFlatIndex(id)] = version_;
+        }
         return indexer_.AtMut<InnerIndex>(id);
     }
 
+    // read access, writes through it aren't tracked
     template <i32 Index>
     auto DataSlice()
     {
         return indexer_.DataSlice<Index>();
     }
 
+    // flat rows [begin, end) for writing, marks them as changed
+    template <i32 Index>
+    auto DataSliceMut(i64 begin, i64 end)
+    {
+        plgr_assert(0 <= begin && begin <= end && end <= Size());
+        MarkChanged(begin, end);
+        auto slice = indexer_.DataSlice<Index>();
+        return decltype(slice) { .data = slice.data + begin, .num = end - begin };
+    }
+
+    void MarkChanged(i64 begin, i64 end)
+    {
+        if constexpr (TrackChanges) {
+            for (i64 i = begin; i < end; i++) {
+                versions_[i] = version_;
+            }
+        }
+    }
+
     i64 Size() const
     {
         return indexer_.Size();
@@ -43,9 +79,42 @@ struct ComponentContainer {
     ComponentIdType GetComponentFromFlatIndex(i32 index) {
         return indexer_.GetIdFromFlatIndex(index);
     }
+
+    u32 GetVersion() const
+    {
+        return version_;
+    }
+
+    // writes after this are newer than every version returned so far
+    // typically called once per frame, before the systems run
+    void AdvanceVersion()
+    {
+        version_++;
+    }
+
+    bool ChangedSince(i32 flat_index, u32 version) const
+    {
+        static_assert(TrackChanges);
+        return versions_[flat_index] > version;
+    }
+
+    // f(flat_index) for rows written with a version newer than `version`
+    template <typename F>
+    void ForEachChanged(u32 version, F&& f) const
+    {
+        static_assert(TrackChanges);
+        for (i32 i = 0, N = As<i32>(versions_.Size()); i < N; i++) {
+            if (versions_[i] > version) {
+                f(i);
+            }
+        }
+    }
 };
 
 template<typename ComponentId, typename ... Data>
 using DenseComponentArray = ComponentContainer<ComponentId, DenseIndex<ComponentId, Soa<Data...>>>;
 
-}
\ No newline at end of file
+template<typename ComponentId, typename ... Data>
+using TrackedComponentArray = ComponentContainer<ComponentId, DenseIndex<ComponentId, Soa<Data...>>, true>;
+
+}
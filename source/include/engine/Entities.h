@@ -1,13 +1,14 @@
 #pragma once
 #include "DenseArray.h"
 #include "SparseArray.h"
-#include "Hashmap.h"
+#include "Array.h"
 
 namespace Playground {
 
 using ComponentTypeId = i32;
 
-constexpr ComponentTypeId InvalidComponentT = 0;
+constexpr ComponentTypeId InvalidComponentT = -1;
+constexpr ComponentTypeId TransformComponentT = 0;
 
 struct TypelessComponentId {
     u32 id;
@@ -70,8 +71,10 @@ struct EntityId : public Handle32 {
     }
 };
 
+using TransformId = ComponentId<TransformComponentT>;
+
 struct Entity {
-    ComponentId<0> transform_ = {};
+    TransformId transform_ = {};
 
     i32 components_list_head_index = -1;
 };
@@ -84,11 +87,25 @@ struct EntityComponentListNode {
 
     i32 next_node_index = EMPTY_NODE_INDEX;
     bool Empty() const;
+    void Clear();
+};
+
+// owners of a single component type, indexed by the component handle's index
+// the handle index doesn't move when the container swaps with last, so entries never need patching
+struct ComponentOwnerTable {
+    struct Entry {
+        // full handle value, a recycled index with a different generation doesn't match
+        u32 component = 0;
+        EntityId owner = {};
+    };
+
+    Array<Entry> entries_;
 };
 
 struct Entities {
     // interface
     EntityId Spawn();
+    // also detaches every component of the entity and releases its list nodes
     void Destroy(EntityId);
 
     // can attach multiple components of the same type
@@ -102,10 +119,39 @@ struct Entities {
     // reverse lookup
     Optional<EntityId> GetOwner(TypedComponentId);
 
+    // f(TypedComponentId) for every attached component, walks the node chain without lookups
+    template <typename F>
+    void ForEachComponent(EntityId, F&& f);
+
     DenseArray<Entity, EntityId> entities_;
     SparseArray<EntityComponentListNode> component_list_nodes_;
 
-    Hashmap<TypedComponentId, EntityId> component_owner_; // TODO: split by type for faster lookups?
+    // indexed by ComponentTypeId
+    Array<ComponentOwnerTable> component_owners_;
+
+    void _SetOwner(TypedComponentId, EntityId);
+    void _ClearOwner(TypedComponentId);
 };
 
+template <typename F>
+void Entities::ForEachComponent(EntityId entity, F&& f)
+{
+    Entity& e = entities_[entity];
+
+    if (e.transform_) {
+        f(As<TypedComponentId>(e.transform_));
+    }
+
+    i32 node_index = e.components_list_head_index;
+    while (node_index != EntityComponentListNode::EMPTY_NODE_INDEX) {
+        EntityComponentListNode& node = component_list_nodes_[node_index];
+        for (i32 i = 0; i < EntityComponentListNode::NODE_COMPONENTS_NUM; i++) {
+            if (node.node_ids[i].type != InvalidComponentT) {
+                f(node.node_ids[i]);
+            }
+        }
+        node_index = node.next_node_index;
+    }
+}
+
 }
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+#include "Entities.h"
+#include "box.h"
+
+namespace Playground {
+
+// entity spawned through a command buffer, valid as a target for commands recorded in the same buffer
+// resolves to an EntityId once the buffer is played back
+struct DeferredEntityId {
+    i32 buffer = -1;
+    i32 index = -1;
+};
+
+// where a spawn or command was recorded: the buffer's scope at the time, then its order within the scope
+struct EntityCommandKey {
+    u64 scope = 0;
+    u32 sequence = 0;
+};
+
+struct EntityCommand {
+    enum class Type : i32 {
+        Detach,
+        Attach,
+        Destroy
+    };
+
+    Type type;
+    EntityId entity;
+    // index into the buffer's spawns when the entity is deferred
+    i32 deferred_index = -1;
+    TypedComponentId component;
+    EntityCommandKey key;
+};
+
+// records structural changes without touching Entities
+// each thread writes only its own buffer
+// playback goes by scope and recording order within a scope rather than by buffer, so the outcome doesn't depend
+// on which worker recorded what, a scope has to be recorded by one thread at a time
+// the system scheduler opens one per system and one per ParallelFor chunk
+struct EntityCommandBuffer {
+    struct ScopeState {
+        u64 scope;
+        u32 sequence;
+    };
+
+    i32 buffer_index_ = 0;
+    u64 scope_ = 0;
+    u32 sequence_ = 0;
+    Array<EntityCommandKey> spawns_;
+    Array<EntityCommand> commands_;
+
+    DeferredEntityId Spawn();
+    void Destroy(EntityId);
+    void Destroy(DeferredEntityId);
+    void AttachComponent(EntityId, TypedComponentId);
+    void AttachComponent(DeferredEntityId, TypedComponentId);
+    void DetachComponent(EntityId, TypedComponentId);
+    void DetachComponent(DeferredEntityId, TypedComponentId);
+
+    // returns the scope that was open, to be passed back to EndScope
+    ScopeState BeginScope(u64 scope);
+    void EndScope(ScopeState previous);
+
+    bool Empty() const;
+    void Clear();
+
+    EntityCommandKey _NextKey();
+    void _Record(EntityCommand::Type, EntityId, i32 deferred_index, TypedComponentId);
+};
+
+// one command buffer per job system worker
+struct EntityCommands {
+    Array<Box<EntityCommandBuffer>> buffers_;
+    // entities created by the last playback, per buffer
+    Array<Array<EntityId>> spawned_;
+
+    EntityCommands(i32 buffers_num = 1);
+
+    // buffer of the calling job system worker
+    EntityCommandBuffer& Local();
+    EntityCommandBuffer& At(i32 buffer_index);
+    i32 BuffersNum() const;
+
+    // single threaded, applies all buffers and clears them
+    // spawns first, then detaches, attaches and destroys, each batch sorted by entity
+    // as every detach runs before every attach, a component can be moved to another entity in one frame, but
+    // one attached in a frame can't be detached again in the same frame
+    void Playback(Entities&);
+
+    EntityId Resolve(DeferredEntityId) const;
+};
+
+}
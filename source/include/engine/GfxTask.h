@@ -0,0 +1,16 @@
+#pragma once
+#include "gfx.h"
+#include "Task.h"
+
+namespace Playground {
+namespace Gfx {
+
+// co_await suspends until the gpu gets here, polled and resumed by the TaskLoop of the awaiting thread,
+// which blocks on the fence when it has nothing else to do
+inline auto operator co_await(Waitable waitable)
+{
+    return PollUntil([waitable]() mutable { return waitable.IsDone(); }, [waitable]() mutable { waitable.Wait(); });
+}
+
+}
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "Types.h"
+#include "Array.h"
+#include "box.h"
+#include "Jobs.h"
+#include "Entities.h"
+#include "EntityCommands.h"
+
+namespace Playground {
+
+// component types a system touches
+// systems conflict when one writes a type the other reads or writes
+struct SystemAccess {
+    Array<ComponentTypeId> reads_;
+    Array<ComponentTypeId> writes_;
+    // structural changes applied directly to Entities, conflicts with every system
+    // prefer recording them through SystemContext::Commands()
+    bool exclusive_ = false;
+
+    SystemAccess& Read(ComponentTypeId);
+    SystemAccess& Write(ComponentTypeId);
+    SystemAccess& Exclusive();
+
+    template <typename ComponentIdType>
+    SystemAccess& Read()
+    {
+        return Read(ComponentIdType::ComponentTypeId);
+    }
+
+    template <typename ComponentIdType>
+    SystemAccess& Write()
+    {
+        return Write(ComponentIdType::ComponentTypeId);
+    }
+
+    bool ConflictsWith(SystemAccess const&) const;
+};
+
+struct SystemContext {
+    JobSystem* jobs_ = nullptr;
+    EntityCommands* commands_ = nullptr;
+    i32 system_index_ = -1;
+    // goes up by one when a ParallelFor starts and again when it ends, odd while the chunks run,
+    // so commands recorded after a loop land in a later scope than its chunks
+    u32 phase_ = 0;
+
+    // structural changes are recorded into the calling worker's buffer and applied by EntityCommands::Playback,
+    // in the order a serial frame would have recorded them
+    EntityCommandBuffer& Commands()
+    {
+        plgr_assert(commands_);
+        return commands_->Local();
+    }
+
+    // f(begin, end), runs inline when the scheduler is executed serially
+    // every chunk records its commands in a scope of its own, keyed by its begin
+    template <typename F>
+    void ParallelFor(i64 num, i64 grain, F&& f)
+    {
+        if (!commands_) {
+            _ParallelFor(num, grain, f);
+            return;
+        }
+
+        // phase_ belongs to the thread running the system, a chunk can't start loops of its own
+        plgr_assert(phase_ % 2 == 0);
+
+        phase_++;
+        u64 chunks_scope = _Scope(0);
+        EntityCommands* commands = commands_;
+        _ParallelFor(num, grain, [commands, chunks_scope, &f](i64 begin, i64 end) {
+            plgr_assert(begin < i64(1) << 32);
+            EntityCommandBuffer& buffer = commands->Local();
+            EntityCommandBuffer::ScopeState previous = buffer.BeginScope(chunks_scope | u64(begin));
+            f(begin, end);
+            buffer.EndScope(previous);
+        });
+
+        phase_++;
+        commands_->Local().BeginScope(_Scope(0));
+    }
+
+    // splits the flat range of a component container into chunks
+    template <typename Container, typename F>
+    void ForEachChunk(Container& container, i64 grain, F&& f)
+    {
+        ParallelFor(container.Size(), grain, std::forward<F>(f));
+    }
+
+    template <typename F>
+    void _ParallelFor(i64 num, i64 grain, F&& f)
+    {
+        if (jobs_) {
+            jobs_->ParallelFor(num, grain, std::forward<F>(f));
+        } else if (num > 0) {
+            f(i64 { 0 }, num);
+        }
+    }
+
+    // system index, phase, then the begin of the chunk
+    u64 _Scope(i64 begin) const
+    {
+        plgr_assert(system_index_ < (1 << 16) && phase_ < (1 << 16));
+        return (u64(system_index_) << 48) | (u64(phase_) << 32) | u64(begin);
+    }
+};
+
+struct ISystem {
+    virtual ~ISystem();
+    virtual void Run(SystemContext&) = 0;
+};
+
+template <typename F>
+struct FunctionSystem : public ISystem {
+    F function_;
+
+    FunctionSystem(F&& function)
+        : function_(std::move(function))
+    {
+    }
+
+    void Run(SystemContext& context) override
+    {
+        function_(context);
+    }
+};
+
+// systems are ordered by registration: a system waits for every earlier system it conflicts with,
+// so a parallel frame gives the same results as running the systems one by one
+struct SystemScheduler {
+    struct Node {
+        const char* name = nullptr;
+        Box<ISystem> system;
+        SystemAccess access;
+
+        Array<i32> dependents;
+        i32 dependencies_num = 0;
+        std::atomic<i32> pending_dependencies = 0;
+    };
+
+    Array<Box<Node>> nodes_;
+    bool graph_dirty_ = true;
+
+    // optional, needs a buffer per job system worker
+    EntityCommands* commands_ = nullptr;
+
+    JobSystem* running_jobs_ = nullptr;
+    JobCounter running_counter_;
+
+    i32 AddSystem(const char* name, SystemAccess access, Box<ISystem> system);
+
+    template <typename F>
+    i32 AddSystem(const char* name, SystemAccess access, F&& f)
+    {
+        using Function = std::decay_t<F>;
+        return AddSystem(name, std::move(access), Box<ISystem> { new FunctionSystem<Function> { Function { std::forward<F>(f) } } });
+    }
+
+    i32 SystemsNum() const;
+
+    // edges go from earlier to later systems, only between conflicting ones
+    void BuildGraph();
+
+    // runs every system once, serially in registration order if jobs is null
+    void Run(JobSystem* jobs);
+
+    // runs a system inside its own command scope
+    void _RunSystem(i32 index, JobSystem* jobs);
+    void _RunNode(i32 index);
+    void _Submit(i32 index);
+};
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Types.h"
+#include "Array.h"
+#include "FreeList.h"
+#include "Slice.h"
+#include "Geometry.h"
+#include "Entities.h"
+
+namespace Playground {
+
+// storage for TransformId components
+// flat arrays are kept in parent-before-child order, so world transforms are computed in one linear sweep
+// Sort() additionally lays the nodes out depth first, keeping every subtree contiguous
+struct TransformHierarchy {
+    static constexpr i32 NO_PARENT = -1;
+
+    FreeList freelist_;
+    // per handle index
+    Array<i8> generation_;
+    Array<i32> indirection_;
+
+    // per flat index
+    Array<i32> rev_indirection_;
+    Array<i32> parents_;
+    // children of every node as a doubly linked list in no particular order, roots aren't linked
+    // Remove only touches the nodes around the removed one
+    Array<i32> first_child_;
+    Array<i32> next_sibling_;
+    Array<i32> prev_sibling_;
+    Array<Transform> locals_;
+    Array<Transform> worlds_;
+    // local written since the last propagation
+    Array<u8> dirty_;
+    // world recomputed by the last propagation
+    Array<u8> world_changed_;
+
+    // a parent doesn't precede one of its children, Propagate() sorts first
+    bool order_dirty_ = false;
+    bool any_dirty_ = false;
+
+    TransformId Add(Transform local, TransformId parent = {});
+    // children are attached to the removed node's parent and keep their world transform
+    void Remove(TransformId);
+    // same result as removing one by one, in one pass over the hierarchy, which keeps the order
+    void Remove(Slice<TransformId>);
+
+    // null parent makes the node a root
+    void SetParent(TransformId, TransformId parent);
+    Optional<TransformId> GetParent(TransformId) const;
+
+    void SetLocal(TransformId, Transform const&);
+    Transform const& GetLocal(TransformId) const;
+    // valid as of the last Propagate()
+    Transform const& GetWorld(TransformId) const;
+
+    i32 GetFlatIndex(TransformId) const;
+    TransformId GetIdFromFlatIndex(i32) const;
+    i64 Size() const;
+
+    // depth first layout, siblings keep their relative order
+    void Sort();
+    // recomputes world transforms of dirty nodes and their descendants, clean subtrees are skipped
+    void Propagate();
+
+    // f(flat_index) for every world transform recomputed by the last Propagate()
+    template <typename F>
+    void ForEachChangedWorld(F&& f) const;
+
+    bool _IsAncestor(i32 ancestor, i32 flat_index) const;
+    void _MarkDirty(i32 flat_index);
+    // into parent's list of children, nothing for NO_PARENT
+    void _Link(i32 flat_index, i32 parent);
+    void _Unlink(i32 flat_index);
+    void _RebuildLinks();
+    void _Release(TransformId);
+};
+
+template <typename F>
+void TransformHierarchy::ForEachChangedWorld(F&& f) const
+{
+    for (i32 i = 0, N = As<i32>(world_changed_.Size()); i < N; i++) {
+        if (world_changed_[i]) {
+            f(i);
+        }
+    }
+}
+
+}
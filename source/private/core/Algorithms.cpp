@@ -1,12 +1,38 @@
 #include "Pch.h"
 #include "Algorithms.h"
+#include "Jobs.h"
 
 namespace Playground {
 
+namespace {
+// smaller chunks aren't worth a job
+constexpr i64 RADIX_PARALLEL_MIN = 16384;
+}
+
 f32 Frac(f32 x)
 {
     f32 _;
     return modf(x, &_);
 }
 
-}
\ No newline at end of file
+void _ForChunks(JobSystem* jobs, i64 num, i64 grain, void (*function)(void* data, i64 begin, i64 end), void* data)
+{
+    if (jobs) {
+        jobs->ParallelFor(num, grain, [function, data](i64 begin, i64 end) { function(data, begin, end); });
+    } else if (num > 0) {
+        function(data, 0, num);
+    }
+}
+
+i64 _RadixChunkSize(JobSystem* jobs, i64 num)
+{
+    if (!jobs) {
+        return Max<i64>(num, 1);
+    }
+
+    // a few chunks per worker so the ones finishing early can steal
+    i64 chunks = 4 * jobs->WorkersNum();
+    return Max(RADIX_PARALLEL_MIN, (num + chunks - 1) / chunks);
+}
+
+}
@@ -1,5 +1,6 @@
 #include "Pch.h"
 #include "Geometry.h"
+#include "Simd.h"
 
 namespace Playground {
 
@@ -26,6 +27,390 @@ Transform Transform::Combine(Transform const& other) const {
     return { .translation = translation + rotation.transformVector(other.translation * scale), .rotation = rotation * other.rotation, .scale = scale * other.scale };
 }
 
+Matrix4 Transform::ToMatrix() const {
+    return Matrix4::from(rotation.toMatrix(), translation) * Matrix4::scaling(scale);
+}
+
+//
+
+namespace {
+
+constexpr i64 LANES = f32xN::WIDTH;
+
+struct Vector3Lanes {
+    f32xN x, y, z;
+};
+
+struct QuaternionLanes {
+    f32xN x, y, z, w;
+};
+
+struct TransformLanes {
+    Vector3Lanes translation;
+    QuaternionLanes rotation;
+    Vector3Lanes scale;
+};
+
+Vector3Lanes SplatVector3(Vector3 v)
+{
+    return { f32xN::Splat(v.x()), f32xN::Splat(v.y()), f32xN::Splat(v.z()) };
+}
+
+Vector3Lanes operator+(Vector3Lanes const& a, Vector3Lanes const& b)
+{
+    return { a.x + b.x, a.y + b.y, a.z + b.z };
+}
+
+Vector3Lanes operator*(Vector3Lanes const& a, Vector3Lanes const& b)
+{
+    return { a.x * b.x, a.y * b.y, a.z * b.z };
+}
+
+Vector3Lanes Cross(Vector3Lanes const& a, Vector3Lanes const& b)
+{
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+// unit quaternions only, same as Quaternion::transformVector
+Vector3Lanes Rotate(QuaternionLanes const& q, Vector3Lanes const& v)
+{
+    Vector3Lanes axis { q.x, q.y, q.z };
+    Vector3Lanes t = Cross(axis, v);
+    t = t + t;
+    Vector3Lanes wt { q.w * t.x, q.w * t.y, q.w * t.z };
+    return v + wt + Cross(axis, t);
+}
+
+QuaternionLanes Multiply(QuaternionLanes const& a, QuaternionLanes const& b)
+{
+    return {
+        a.w * b.x + b.w * a.x + (a.y * b.z - a.z * b.y),
+        a.w * b.y + b.w * a.y + (a.z * b.x - a.x * b.z),
+        a.w * b.z + b.w * a.z + (a.x * b.y - a.y * b.x),
+        a.w * b.w - (a.x * b.x + a.y * b.y + a.z * b.z)
+    };
+}
+
+// AoS <-> lanes through a transposing scratch buffer, num < LANES pads with the last element
+Vector3Lanes LoadVector3s(Vector3 const* src, i64 num)
+{
+    alignas(32) f32 scratch[3][LANES];
+    for (i64 i = 0; i < LANES; i++) {
+        Vector3 const& v = src[Min(i, num - 1)];
+        scratch[0][i] = v.x();
+        scratch[1][i] = v.y();
+        scratch[2][i] = v.z();
+    }
+    return { f32xN::Load(scratch[0]), f32xN::Load(scratch[1]), f32xN::Load(scratch[2]) };
+}
+
+struct AabbLanes {
+    Vector3Lanes min, max;
+};
+
+AabbLanes LoadAabbs(Aabb3D const* src, i64 num)
+{
+    alignas(32) f32 scratch[6][LANES];
+    for (i64 i = 0; i < LANES; i++) {
+        Aabb3D const& box = src[Min(i, num - 1)];
+        for (i32 c = 0; c < 3; c++) {
+            scratch[c][i] = box.vec_min[c];
+            scratch[3 + c][i] = box.vec_max[c];
+        }
+    }
+    return {
+        { f32xN::Load(scratch[0]), f32xN::Load(scratch[1]), f32xN::Load(scratch[2]) },
+        { f32xN::Load(scratch[3]), f32xN::Load(scratch[4]), f32xN::Load(scratch[5]) }
+    };
+}
+
+void StoreAabbs(AabbLanes const& lanes, Aabb3D* dst, i64 num)
+{
+    alignas(32) f32 scratch[6][LANES];
+    f32xN const* columns[6] = { &lanes.min.x, &lanes.min.y, &lanes.min.z, &lanes.max.x, &lanes.max.y, &lanes.max.z };
+    for (i32 c = 0; c < 6; c++) {
+        columns[c]->Store(scratch[c]);
+    }
+
+    for (i64 i = 0; i < num; i++) {
+        dst[i] = {
+            .vec_min = { scratch[0][i], scratch[1][i], scratch[2][i] },
+            .vec_max = { scratch[3][i], scratch[4][i], scratch[5][i] }
+        };
+    }
+}
+
+void StoreVector3s(Vector3Lanes const& v, Vector3* dst, i64 num)
+{
+    alignas(32) f32 scratch[3][LANES];
+    v.x.Store(scratch[0]);
+    v.y.Store(scratch[1]);
+    v.z.Store(scratch[2]);
+    for (i64 i = 0; i < num; i++) {
+        dst[i] = { scratch[0][i], scratch[1][i], scratch[2][i] };
+    }
+}
+
+TransformLanes LoadTransforms(Transform const* src, i64 num)
+{
+    alignas(32) f32 scratch[10][LANES];
+    for (i64 i = 0; i < LANES; i++) {
+        Transform const& t = src[Min(i, num - 1)];
+        scratch[0][i] = t.translation.x();
+        scratch[1][i] = t.translation.y();
+        scratch[2][i] = t.translation.z();
+        scratch[3][i] = t.rotation.vector().x();
+        scratch[4][i] = t.rotation.vector().y();
+        scratch[5][i] = t.rotation.vector().z();
+        scratch[6][i] = t.rotation.scalar();
+        scratch[7][i] = t.scale.x();
+        scratch[8][i] = t.scale.y();
+        scratch[9][i] = t.scale.z();
+    }
+
+    TransformLanes lanes;
+    lanes.translation = { f32xN::Load(scratch[0]), f32xN::Load(scratch[1]), f32xN::Load(scratch[2]) };
+    lanes.rotation = { f32xN::Load(scratch[3]), f32xN::Load(scratch[4]), f32xN::Load(scratch[5]), f32xN::Load(scratch[6]) };
+    lanes.scale = { f32xN::Load(scratch[7]), f32xN::Load(scratch[8]), f32xN::Load(scratch[9]) };
+    return lanes;
+}
+
+void StoreTransforms(TransformLanes const& lanes, Transform* dst, i64 num)
+{
+    alignas(32) f32 scratch[10][LANES];
+    f32xN const* columns[10] = {
+        &lanes.translation.x, &lanes.translation.y, &lanes.translation.z,
+        &lanes.rotation.x, &lanes.rotation.y, &lanes.rotation.z, &lanes.rotation.w,
+        &lanes.scale.x, &lanes.scale.y, &lanes.scale.z
+    };
+    for (i32 c = 0; c < 10; c++) {
+        columns[c]->Store(scratch[c]);
+    }
+
+    for (i64 i = 0; i < num; i++) {
+        dst[i] = {
+            .translation = { scratch[0][i], scratch[1][i], scratch[2][i] },
+            .rotation = Quaternion { { scratch[3][i], scratch[4][i], scratch[5][i] }, scratch[6][i] },
+            .scale = { scratch[7][i], scratch[8][i], scratch[9][i] }
+        };
+    }
+}
+
+}
+
+void TransformPoints(Transform const& transform, Slice<Vector3> points, Slice<Vector3> out)
+{
+    plgr_assert(points.num == out.num);
+
+    Vector3Lanes translation = SplatVector3(transform.translation);
+    Vector3Lanes scale = SplatVector3(transform.scale);
+    QuaternionLanes rotation {
+        f32xN::Splat(transform.rotation.vector().x()),
+        f32xN::Splat(transform.rotation.vector().y()),
+        f32xN::Splat(transform.rotation.vector().z()),
+        f32xN::Splat(transform.rotation.scalar())
+    };
+
+    for (i64 i = 0; i < points.num; i += LANES) {
+        i64 num = Min(LANES, points.num - i);
+        Vector3Lanes p = LoadVector3s(points.data + i, num);
+        StoreVector3s(Rotate(rotation, p * scale) + translation, out.data + i, num);
+    }
+}
+
+void TransformPoints(Transform const& transform, Slice<f32> xs, Slice<f32> ys, Slice<f32> zs)
+{
+    plgr_assert(xs.num == ys.num && ys.num == zs.num);
+
+    Vector3Lanes translation = SplatVector3(transform.translation);
+    Vector3Lanes scale = SplatVector3(transform.scale);
+    QuaternionLanes rotation {
+        f32xN::Splat(transform.rotation.vector().x()),
+        f32xN::Splat(transform.rotation.vector().y()),
+        f32xN::Splat(transform.rotation.vector().z()),
+        f32xN::Splat(transform.rotation.scalar())
+    };
+
+    i64 i = 0;
+    for (; i + LANES <= xs.num; i += LANES) {
+        Vector3Lanes p { f32xN::Load(xs.data + i), f32xN::Load(ys.data + i), f32xN::Load(zs.data + i) };
+        Vector3Lanes result = Rotate(rotation, p * scale) + translation;
+        result.x.Store(xs.data + i);
+        result.y.Store(ys.data + i);
+        result.z.Store(zs.data + i);
+    }
+
+    for (; i < xs.num; i++) {
+        Vector3 result = transform.TransformVector({ xs.data[i], ys.data[i], zs.data[i] });
+        xs.data[i] = result.x();
+        ys.data[i] = result.y();
+        zs.data[i] = result.z();
+    }
+}
+
+void CombineTransforms(Slice<Transform> parents, Slice<Transform> locals, Slice<Transform> out)
+{
+    plgr_assert(parents.num == locals.num && locals.num == out.num);
+
+    for (i64 i = 0; i < parents.num; i += LANES) {
+        i64 num = Min(LANES, parents.num - i);
+        TransformLanes parent = LoadTransforms(parents.data + i, num);
+        TransformLanes local = LoadTransforms(locals.data + i, num);
+
+        TransformLanes combined;
+        combined.translation = parent.translation + Rotate(parent.rotation, local.translation * parent.scale);
+        combined.rotation = Multiply(parent.rotation, local.rotation);
+        combined.scale = parent.scale * local.scale;
+
+        StoreTransforms(combined, out.data + i, num);
+    }
+}
+
+void TransformsToMatrices(Slice<Transform> transforms, Slice<Matrix4> out)
+{
+    plgr_assert(transforms.num == out.num);
+
+    f32xN one = f32xN::Splat(1.f);
+    f32xN two = f32xN::Splat(2.f);
+
+    for (i64 i = 0; i < transforms.num; i += LANES) {
+        i64 num = Min(LANES, transforms.num - i);
+        TransformLanes t = LoadTransforms(transforms.data + i, num);
+        QuaternionLanes const& q = t.rotation;
+
+        f32xN xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+        f32xN xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+        f32xN xw = q.x * q.w, yw = q.y * q.w, zw = q.z * q.w;
+
+        // column major, rotation columns scaled per axis
+        f32xN m[12] = {
+            (one - two * (yy + zz)) * t.scale.x, two * (xy + zw) * t.scale.x, two * (xz - yw) * t.scale.x,
+            two * (xy - zw) * t.scale.y, (one - two * (xx + zz)) * t.scale.y, two * (yz + xw) * t.scale.y,
+            two * (xz + yw) * t.scale.z, two * (yz - xw) * t.scale.z, (one - two * (xx + yy)) * t.scale.z,
+            t.translation.x, t.translation.y, t.translation.z
+        };
+
+        alignas(32) f32 scratch[12][LANES];
+        for (i32 c = 0; c < 12; c++) {
+            m[c].Store(scratch[c]);
+        }
+
+        for (i64 j = 0; j < num; j++) {
+            out.data[i + j] = Matrix4 {
+                Vector4 { scratch[0][j], scratch[1][j], scratch[2][j], 0.f },
+                Vector4 { scratch[3][j], scratch[4][j], scratch[5][j], 0.f },
+                Vector4 { scratch[6][j], scratch[7][j], scratch[8][j], 0.f },
+                Vector4 { scratch[9][j], scratch[10][j], scratch[11][j], 1.f }
+            };
+        }
+    }
+}
+
+void ComputeAabbs(Slice<Obb3D> boxes, Matrix4 const& transform, Slice<Aabb3D> out)
+{
+    plgr_assert(boxes.num == out.num);
+
+    f32xN m[4][3];
+    for (i32 c = 0; c < 4; c++) {
+        for (i32 r = 0; r < 3; r++) {
+            m[c][r] = f32xN::Splat(transform[c][r]);
+        }
+    }
+
+    auto transform_vector = [&m](Vector3Lanes const& v) -> Vector3Lanes {
+        return {
+            m[0][0] * v.x + m[1][0] * v.y + m[2][0] * v.z,
+            m[0][1] * v.x + m[1][1] * v.y + m[2][1] * v.z,
+            m[0][2] * v.x + m[1][2] * v.y + m[2][2] * v.z
+        };
+    };
+
+    for (i64 i = 0; i < boxes.num; i += LANES) {
+        i64 num = Min(LANES, boxes.num - i);
+
+        alignas(32) f32 scratch[15][LANES];
+        for (i64 j = 0; j < LANES; j++) {
+            Obb3D const& box = boxes.data[i + Min(j, num - 1)];
+            Vector3 const* columns[5] = { &box.pos, &box.axis100, &box.axis010, &box.axis001, &box.half_size };
+            for (i32 c = 0; c < 5; c++) {
+                for (i32 k = 0; k < 3; k++) {
+                    scratch[c * 3 + k][j] = (*columns[c])[k];
+                }
+            }
+        }
+
+        Vector3Lanes lanes[5];
+        for (i32 c = 0; c < 5; c++) {
+            lanes[c] = { f32xN::Load(scratch[c * 3]), f32xN::Load(scratch[c * 3 + 1]), f32xN::Load(scratch[c * 3 + 2]) };
+        }
+        Vector3Lanes const& half_size = lanes[4];
+
+        Vector3Lanes center = transform_vector(lanes[0]) + Vector3Lanes { m[3][0], m[3][1], m[3][2] };
+
+        // world extents are the summed absolute projections of the scaled box axes
+        f32xN const* half_sizes[3] = { &half_size.x, &half_size.y, &half_size.z };
+        Vector3Lanes extents { f32xN::Splat(0.f), f32xN::Splat(0.f), f32xN::Splat(0.f) };
+        for (i32 a = 0; a < 3; a++) {
+            Vector3Lanes axis = lanes[1 + a];
+            Vector3Lanes scaled { axis.x * *half_sizes[a], axis.y * *half_sizes[a], axis.z * *half_sizes[a] };
+            Vector3Lanes world = transform_vector(scaled);
+            extents = extents + Vector3Lanes { Abs(world.x), Abs(world.y), Abs(world.z) };
+        }
+
+        AabbLanes result {
+            { center.x - extents.x, center.y - extents.y, center.z - extents.z },
+            center + extents
+        };
+        StoreAabbs(result, out.data + i, num);
+    }
+}
+
+void CullAabbs(ViewFrustum const& frustum, Slice<Aabb3D> boxes, Bitarray& visible)
+{
+    static_assert(64 % LANES == 0);
+
+    visible.Resize(boxes.num);
+
+    f32xN half = f32xN::Splat(0.5f);
+    f32xN zero = f32xN::Splat(0.f);
+
+    Vector3Lanes normals[6];
+    Vector3Lanes abs_normals[6];
+    f32xN distances[6];
+    for (i32 p = 0; p < 6; p++) {
+        Vector4 plane = frustum.planes[p];
+        normals[p] = SplatVector3(plane.xyz());
+        abs_normals[p] = SplatVector3(Math::abs(plane.xyz()));
+        distances[p] = f32xN::Splat(plane.w());
+    }
+
+    u64 word = 0;
+    for (i64 i = 0; i < boxes.num; i += LANES) {
+        i64 num = Min(LANES, boxes.num - i);
+        AabbLanes box = LoadAabbs(boxes.data + i, num);
+
+        Vector3Lanes center { (box.min.x + box.max.x) * half, (box.min.y + box.max.y) * half, (box.min.z + box.max.z) * half };
+        Vector3Lanes extents { (box.max.x - box.min.x) * half, (box.max.y - box.min.y) * half, (box.max.z - box.min.z) * half };
+
+        f32xN inside = CmpGe(zero, zero);
+        for (i32 p = 0; p < 6; p++) {
+            Vector3Lanes const& n = normals[p];
+            Vector3Lanes const& an = abs_normals[p];
+            f32xN distance = n.x * center.x + n.y * center.y + n.z * center.z + distances[p]
+                + an.x * extents.x + an.y * extents.y + an.z * extents.z;
+            inside = And(inside, CmpGe(distance, zero));
+        }
+
+        u64 bits = As<u64>(MoveMask(inside)) & ((u64 { 1 } << num) - 1);
+        word |= bits << (i % 64);
+
+        if ((i + LANES) % 64 == 0 || i + LANES >= boxes.num) {
+            visible.data_[i / 64] = As<i64>(word);
+            word = 0;
+        }
+    }
+}
+
 //
 
 Vector2 Aabb2D::Min() const
@@ -101,6 +486,23 @@ bool Aabb3D::Contains(Aabb3D const & other) const {
     return Contains(other.vec_min) && Contains(other.vec_max);
 }
 
+bool Aabb3D::Overlaps(Aabb3D const & other) const {
+    return (vec_min <= other.vec_max && other.vec_min <= vec_max).all();
+}
+
+Optional<f32> Aabb3D::RayIntersection(Vector3 origin, Vector3 inv_direction, f32 max_t) const {
+    Vector3 t0 = (vec_min - origin) * inv_direction;
+    Vector3 t1 = (vec_max - origin) * inv_direction;
+
+    f32 t_enter = Math::max(Math::min(t0, t1).max(), 0.f);
+    f32 t_exit = Math::min(Math::max(t0, t1).min(), max_t);
+
+    if (t_enter > t_exit) {
+        return NullOpt;
+    }
+    return t_enter;
+}
+
 f32 Aabb3D::Volume() const {
     Vector3 span = Span();
     return span.x() * span.y() * span.z();
@@ -186,6 +588,35 @@ Obb3D Obb3D::UnitCube()
 
 //
 
+ViewFrustum ViewFrustum::FromMatrix(Matrix4 const& view_projection)
+{
+    Vector4 r0 = view_projection.row(0);
+    Vector4 r1 = view_projection.row(1);
+    Vector4 r2 = view_projection.row(2);
+    Vector4 r3 = view_projection.row(3);
+
+    ViewFrustum frustum { .planes = { r3 + r0, r3 - r0, r3 + r1, r3 - r1, r2, r3 - r2 } };
+    for (Vector4& plane : frustum.planes) {
+        plane /= plane.xyz().length();
+    }
+    return frustum;
+}
+
+bool ViewFrustum::Intersects(Aabb3D const& box) const
+{
+    Vector3 center = box.Center();
+    Vector3 extents = box.Span() * 0.5f;
+
+    for (Vector4 const& plane : planes) {
+        if (Math::dot(plane.xyz(), center) + plane.w() + Math::dot(Math::abs(plane.xyz()), extents) < 0.f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+
 Vector2 RandomPointInAnnulus(f32 r0, f32 r1, Vector2 random_pair)
 {
     plgr_assert(r0 < r1);
@@ -0,0 +1,386 @@
+#include "Pch.h"
+#include "Jobs.h"
+
+#include <bit>
+
+namespace Playground {
+
+static thread_local JobSystem* tls_job_system = nullptr;
+static thread_local i32 tls_worker_index = 0;
+
+bool JobCounter::IsDone() const
+{
+    return value_.load(std::memory_order_acquire) == 0;
+}
+
+i32 JobCounter::_Lock()
+{
+    i32 value = value_.load(std::memory_order_relaxed);
+    while ((value & LOCKED) || !value_.compare_exchange_weak(value, value | LOCKED, std::memory_order_acquire, std::memory_order_relaxed)) {
+        std::this_thread::yield();
+        value = value_.load(std::memory_order_relaxed);
+    }
+    return value;
+}
+
+JobDeque::Ring::Ring(i64 capacity)
+    : capacity_(capacity)
+    , slots_(new Slot[capacity])
+{
+    plgr_assert(std::has_single_bit(u64(capacity)));
+}
+
+JobDeque::Ring::~Ring()
+{
+    delete[] slots_;
+}
+
+JobDeque::JobDeque(i64 capacity)
+{
+    rings_.PushBackRvalueRef(Box<Ring> { new Ring { capacity } });
+    ring_.store(rings_[0].get(), std::memory_order_relaxed);
+}
+
+// orderings follow Le, Pop, Cohen, Zappa Nardelli: Correct and Efficient Work-Stealing for Weak Memory Models
+void JobDeque::Push(Job const& job)
+{
+    i64 bottom = bottom_.load(std::memory_order_relaxed);
+    i64 top = top_.load(std::memory_order_acquire);
+    Ring* ring = ring_.load(std::memory_order_relaxed);
+
+    if (bottom - top >= ring->capacity_) {
+        Box<Ring> grown { new Ring { ring->capacity_ * 2 } };
+        for (i64 i = top; i < bottom; i++) {
+            grown->Store(i, ring->Load(i));
+        }
+        ring = grown.get();
+        rings_.PushBackRvalueRef(std::move(grown));
+        ring_.store(ring, std::memory_order_release);
+    }
+
+    // a release store in place of the paper's release fence, same cost and visible to thread sanitizers
+    ring->Store(bottom, job);
+    bottom_.store(bottom + 1, std::memory_order_release);
+}
+
+bool JobDeque::Empty() const
+{
+    return bottom_.load(std::memory_order_seq_cst) <= top_.load(std::memory_order_seq_cst);
+}
+
+Optional<Job> JobDeque::Pop()
+{
+    // top_ only grows, a deque that looks empty to its owner is, and the xchg below can be skipped
+    if (bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed)) {
+        return NullOpt;
+    }
+
+    i64 bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    Ring* ring = ring_.load(std::memory_order_relaxed);
+    // the store has to land before top_ is read, a seq_cst store is a single xchg where the paper's fence is an mfence
+    bottom_.store(bottom, std::memory_order_seq_cst);
+    i64 top = top_.load(std::memory_order_seq_cst);
+
+    if (top > bottom) {
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+        return NullOpt;
+    }
+
+    Job job = ring->Load(bottom);
+    if (top == bottom) {
+        // the last job, thieves may be after it too
+        bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+        if (!won) {
+            return NullOpt;
+        }
+    }
+    return job;
+}
+
+Optional<Job> JobDeque::Steal()
+{
+    // skips the fence for the common empty victim, a stale read only makes this steal give up early
+    if (bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed)) {
+        return NullOpt;
+    }
+
+    i64 top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    i64 bottom = bottom_.load(std::memory_order_acquire);
+
+    if (top >= bottom) {
+        return NullOpt;
+    }
+
+    Ring* ring = ring_.load(std::memory_order_acquire);
+    Job job = ring->Load(top);
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return NullOpt;
+    }
+    return job;
+}
+
+JobSystem::JobSystem(i32 threads_num)
+    : owner_thread_(std::this_thread::get_id())
+{
+    if (threads_num < 0) {
+        threads_num = Max(As<i32>(std::thread::hardware_concurrency()) - 1, 0);
+    }
+
+    for (i32 i = 0; i <= threads_num; i++) {
+        deques_.PushBackRvalueRef(Box<JobDeque> { new JobDeque {} });
+    }
+
+    for (i32 i = 1; i <= threads_num; i++) {
+        threads_.PushBackRvalueRef(Box<std::thread> { new std::thread { [this, i]() { _WorkerLoop(i); } } });
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    Wait(detached_);
+
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        quit_ = true;
+    }
+    wake_.notify_all();
+
+    for (Box<std::thread>& thread : threads_) {
+        thread->join();
+    }
+}
+
+i32 JobSystem::WorkersNum() const
+{
+    return As<i32>(deques_.Size());
+}
+
+i32 JobSystem::GetWorkerIndex()
+{
+    return tls_worker_index;
+}
+
+void JobSystem::Submit(Job job, JobCounter& counter)
+{
+    Submit({ .data = &job, .num = 1 }, counter);
+}
+
+void JobSystem::Submit(Slice<Job> jobs, JobCounter& counter)
+{
+    if (jobs.num == 0) {
+        return;
+    }
+
+    counter.value_.fetch_add(As<i32>(jobs.num), std::memory_order_relaxed);
+    for (i64 i = 0; i < jobs.num; i++) {
+        jobs[i].counter = &counter;
+    }
+
+    _Enqueue(jobs);
+}
+
+void JobSystem::SubmitAfter(Job job, JobCounter& counter, JobCounter& dependency)
+{
+    plgr_assert(&counter != &dependency);
+
+    counter.value_.fetch_add(1, std::memory_order_relaxed);
+    job.counter = &counter;
+
+    i32 value = dependency._Lock();
+    bool hold = (value & JobCounter::COUNT_MASK) != 0;
+    if (hold) {
+        dependency.held_.PushBack(job);
+        // HELD only ever clears under the lock, it can't have changed since value was read
+        dependency.value_.fetch_add((value & JobCounter::HELD) ? -JobCounter::LOCKED : JobCounter::HELD - JobCounter::LOCKED, std::memory_order_release);
+    } else {
+        dependency.value_.fetch_sub(JobCounter::LOCKED, std::memory_order_release);
+        _Enqueue({ .data = &job, .num = 1 });
+    }
+}
+
+void JobSystem::SubmitDetached(Job job)
+{
+    Submit(job, detached_);
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+    i32 worker_index = _OwnedWorker();
+    while (!counter.IsDone()) {
+        if (!_RunOne(worker_index)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool JobSystem::RunOne()
+{
+    return _RunOne(_OwnedWorker());
+}
+
+i32 JobSystem::_OwnedWorker() const
+{
+    if (tls_job_system == this) {
+        return tls_worker_index;
+    }
+    if (std::this_thread::get_id() == owner_thread_) {
+        return 0;
+    }
+    return -1;
+}
+
+void JobSystem::_Enqueue(Slice<Job> jobs)
+{
+    i32 worker_index = _OwnedWorker();
+    if (worker_index >= 0) {
+        JobDeque& deque = *deques_[worker_index];
+        for (i64 i = 0; i < jobs.num; i++) {
+            deque.Push(jobs[i]);
+        }
+    } else {
+        std::lock_guard<std::mutex> lock(shared_mutex_);
+        for (i64 i = 0; i < jobs.num; i++) {
+            shared_jobs_.PushBack(jobs[i]);
+        }
+        shared_num_.fetch_add(jobs.num, std::memory_order_relaxed);
+    }
+
+    _Wake(jobs.num);
+}
+
+Optional<Job> JobSystem::_Pop(i32 worker_index)
+{
+    Optional<Job> job;
+    if (worker_index >= 0) {
+        job = deques_[worker_index]->Pop();
+    }
+
+    if (!job && shared_num_.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(shared_mutex_);
+        if (shared_front_ < shared_jobs_.Size()) {
+            job = shared_jobs_[shared_front_++];
+            shared_num_.fetch_sub(1, std::memory_order_relaxed);
+            if (shared_front_ == shared_jobs_.Size()) {
+                shared_jobs_.Clear();
+                shared_front_ = 0;
+            }
+        }
+    }
+
+    return job;
+}
+
+Optional<Job> JobSystem::_Steal(i32 worker_index)
+{
+    // fixed victim order, starting from the next worker
+    for (i32 i = 1, N = WorkersNum(); i <= N; i++) {
+        i32 victim = (worker_index + i) % N;
+        if (victim == worker_index) {
+            continue;
+        }
+
+        if (Optional<Job> job = deques_[victim]->Steal()) {
+            return job;
+        }
+    }
+
+    return NullOpt;
+}
+
+bool JobSystem::_RunOne(i32 worker_index)
+{
+    Optional<Job> job = _Pop(worker_index);
+    if (!job) {
+        job = _Steal(worker_index);
+    }
+
+    if (!job) {
+        return false;
+    }
+
+    _Execute(*job);
+    return true;
+}
+
+void JobSystem::_Execute(Job const& job)
+{
+    job.function(job.data, job.begin, job.end);
+    _Retire(*job.counter);
+}
+
+void JobSystem::_Retire(JobCounter& counter)
+{
+    i32 previous = counter.value_.fetch_sub(1, std::memory_order_acq_rel);
+    plgr_assert((previous & JobCounter::COUNT_MASK) > 0);
+    if ((previous & JobCounter::COUNT_MASK) != 1 || !(previous & (JobCounter::LOCKED | JobCounter::HELD))) {
+        return;
+    }
+
+    // the last job of a counter with jobs held or being held, the flags keep the value from reading zero,
+    // and its owner from freeing it, until the held jobs are taken out
+    counter._Lock();
+    Array<Job> released = std::move(counter.held_);
+    counter.value_.fetch_and(~(JobCounter::LOCKED | JobCounter::HELD), std::memory_order_acq_rel);
+
+    if (released.Size()) {
+        _Enqueue({ .data = released.Data(), .num = released.Size() });
+    }
+}
+
+bool JobSystem::_HasWork() const
+{
+    if (shared_num_.load(std::memory_order_seq_cst) > 0) {
+        return true;
+    }
+    for (i64 i = 0; i < deques_.Size(); i++) {
+        if (!deques_[i]->Empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::_WorkerLoop(i32 worker_index)
+{
+    tls_job_system = this;
+    tls_worker_index = worker_index;
+
+    while (true) {
+        if (_RunOne(worker_index)) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        sleeping_.fetch_add(1, std::memory_order_seq_cst);
+        wake_.wait(lock, [this]() { return quit_ || _HasWork(); });
+        sleeping_.fetch_sub(1, std::memory_order_relaxed);
+
+        if (quit_) {
+            break;
+        }
+    }
+}
+
+void JobSystem::_Wake(i64 jobs_num)
+{
+    // the jobs were pushed before the fence and a worker raises sleeping_ before looking for jobs,
+    // so either this sees the worker or the worker sees the jobs
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+
+    // taking the lock orders the push with a worker going to sleep
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+    }
+    if (jobs_num == 1) {
+        wake_.notify_one();
+    } else {
+        wake_.notify_all();
+    }
+}
+
+}
@@ -0,0 +1,289 @@
+#include "Pch.h"
+#include "LinearBvh.h"
+#include "Heap.h"
+#include "Jobs.h"
+#include "algorithms.h"
+
+#include <bit>
+
+namespace Playground {
+
+namespace {
+constexpr i32 MORTON_BITS_PER_AXIS = 10;
+// smaller ranges aren't worth a job
+constexpr i32 LINEAR_BUILD_PARALLEL_MIN = 4096;
+
+// spreads the low 10 bits of v so two zero bits follow each
+u32 ExpandBits(u32 v) {
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+struct LinearBuildContext {
+    LinearBvh* bvh;
+    JobSystem* jobs;
+    Slice<Aabb3D> bounds;
+    Array<u32> codes;
+    Array<i32> primitives;
+};
+
+struct LinearBuildTask {
+    LinearBuildContext* context;
+    i32 begin;
+    i32 end;
+    i32 node;
+    // written by the task
+    Aabb3D bounds;
+};
+
+// the first index of the right half: past the last code sharing more leading bits with the first code than the last code does
+// codes that are all equal split in the middle
+i32 FindSplit(u32 const* codes, i32 begin, i32 end) {
+    u32 first = codes[begin];
+    u32 last = codes[end - 1];
+    if (first == last) {
+        return begin + (end - begin) / 2;
+    }
+
+    i32 common_prefix = std::countl_zero(first ^ last);
+
+    i32 split = begin;
+    i32 step = end - 1 - begin;
+    do {
+        step = (step + 1) / 2;
+        i32 candidate = split + step;
+        if (candidate < end - 1 && std::countl_zero(first ^ codes[candidate]) > common_prefix) {
+            split = candidate;
+        }
+    } while (step > 1);
+
+    return split + 1;
+}
+
+Aabb3D BuildLinearSubtree(LinearBuildContext& context, i32 begin, i32 end, i32 index);
+
+void RunLinearBuildTask(void* data, i64, i64) {
+    LinearBuildTask& task = *static_cast<LinearBuildTask*>(data);
+    task.bounds = BuildLinearSubtree(*task.context, task.begin, task.end, task.node);
+}
+
+Aabb3D BuildLinearSubtree(LinearBuildContext& context, i32 begin, i32 end, i32 index) {
+    LinearBvh& bvh = *context.bvh;
+
+    if (end - begin == 1) {
+        i32 primitive = context.primitives[begin];
+        bvh.nodes_[index] = { .bounds = context.bounds[primitive], .skip = index + 1, .handle = primitive };
+        return context.bounds[primitive];
+    }
+
+    i32 mid = FindSplit(context.codes.Data(), begin, end);
+    i32 left = index + 1;
+    i32 right = index + 2 * (mid - begin);
+
+    Aabb3D left_bounds;
+    Aabb3D right_bounds;
+    if (context.jobs && end - begin >= LINEAR_BUILD_PARALLEL_MIN) {
+        LinearBuildTask task { .context = &context, .begin = mid, .end = end, .node = right };
+        JobCounter counter;
+        context.jobs->Submit({ .function = RunLinearBuildTask, .data = &task }, counter);
+        left_bounds = BuildLinearSubtree(context, begin, mid, left);
+        context.jobs->Wait(counter);
+        right_bounds = task.bounds;
+    } else {
+        left_bounds = BuildLinearSubtree(context, begin, mid, left);
+        right_bounds = BuildLinearSubtree(context, mid, end, right);
+    }
+
+    Aabb3D bounds { .vec_min = Math::min(left_bounds.vec_min, right_bounds.vec_min), .vec_max = Math::max(left_bounds.vec_max, right_bounds.vec_max) };
+    bvh.nodes_[index] = { .bounds = bounds, .skip = index + 2 * (end - begin) - 1, .handle = LinearBvh::NULL_NODE };
+    return bounds;
+}
+
+struct LinearDistance {
+    i32 index;
+    f32 distance;
+
+    bool operator<(LinearDistance const& other) const {
+        return distance < other.distance;
+    }
+
+    bool operator>(LinearDistance const& other) const {
+        return distance > other.distance;
+    }
+};
+}
+
+bool LinearBvh::Node::IsLeaf() const {
+    return handle != NULL_NODE;
+}
+
+void LinearBvh::Build(Slice<Aabb3D> bounds, JobSystem* jobs) {
+    nodes_.Clear();
+
+    i32 num = As<i32>(bounds.num);
+    if (num == 0) {
+        return;
+    }
+
+    Vector3 center_min { Math::Constants<f32>::inf() };
+    Vector3 center_max { -Math::Constants<f32>::inf() };
+    for (i32 i = 0; i < num; i++) {
+        Vector3 center = (bounds[i].vec_min + bounds[i].vec_max) * 0.5f;
+        center_min = Math::min(center_min, center);
+        center_max = Math::max(center_max, center);
+    }
+
+    // centres are quantised to a 2^10 grid over their bounds, flat axes stay at 0
+    constexpr f32 GRID_MAX = f32((1 << MORTON_BITS_PER_AXIS) - 1);
+    Vector3 extent = center_max - center_min;
+    Vector3 to_grid;
+    for (i32 axis = 0; axis < 3; axis++) {
+        to_grid[axis] = extent[axis] > 0.f ? GRID_MAX / extent[axis] : 0.f;
+    }
+
+    LinearBuildContext context { .bvh = this, .jobs = jobs, .bounds = bounds };
+    context.codes.ResizeUninitialised(num);
+    context.primitives.ResizeUninitialised(num);
+
+    auto encode = [&](i64 begin, i64 end) {
+        for (i64 i = begin; i < end; i++) {
+            Vector3 grid = ((bounds[i].vec_min + bounds[i].vec_max) * 0.5f - center_min) * to_grid;
+            Vector3i cell { Math::clamp(grid, 0.f, GRID_MAX) };
+            context.codes[i] = (ExpandBits(cell.x()) << 2) | (ExpandBits(cell.y()) << 1) | ExpandBits(cell.z());
+            context.primitives[i] = As<i32>(i);
+        }
+    };
+    _ForChunks(jobs, num, LINEAR_BUILD_PARALLEL_MIN, encode);
+
+    Slice<u32> codes { .data = context.codes.Data(), .num = num };
+    Slice<i32> primitives { .data = context.primitives.Data(), .num = num };
+    if (jobs) {
+        RadixSort(codes, primitives, *jobs);
+    } else {
+        RadixSort(codes, primitives);
+    }
+
+    nodes_.ResizeUninitialised(2 * num - 1);
+    BuildLinearSubtree(context, 0, num, 0);
+}
+
+bool LinearBvh::Empty() const {
+    return nodes_.Size() == 0;
+}
+
+i32 LinearBvh::GetDepth() const {
+    if (Empty()) {
+        return 0;
+    }
+
+    // skips of the ancestors still open, a node closes them once it's past their subtrees
+    Array<i32> open;
+    i32 max_depth = 0;
+    for (i32 index = 0; index < nodes_.Size(); index++) {
+        while (open.Size() && open[open.Size() - 1] <= index) {
+            open.PopBack();
+        }
+        open.PushBack(nodes_[index].skip);
+        max_depth = Max(max_depth, As<i32>(open.Size()));
+    }
+    return max_depth;
+}
+
+bool LinearBvh::FindAllIntersecting(Vector3 point, Array<Handle>& out) const {
+    plgr_assert(out.Size() == 0);
+
+    _Query([point](Aabb3D const& bounds) { return bounds.Contains(point); }, [&out](Handle handle) {
+        out.PushBack(handle);
+        return true;
+    });
+
+    return out.Size();
+}
+
+Optional<LinearBvh::Handle> LinearBvh::FindClosest(Vector3 point, f32 max_distance) const {
+    Array<Handle> closest;
+    FindKClosest(point, 1, max_distance, closest);
+
+    if (closest.Size() == 0) {
+        return NullOpt;
+    }
+    return closest[0];
+}
+
+void LinearBvh::FindKClosest(Vector3 point, i32 k, f32 max_distance, Array<Handle>& out) const {
+    plgr_assert(k > 0);
+
+    if (Empty() || nodes_[0].bounds.Distance(point) > max_distance) {
+        return;
+    }
+
+    // nodes nearest first, results farthest first so the worst one can be replaced
+    Heap<LinearDistance> queue;
+    Heap<LinearDistance, std::greater<LinearDistance>> closest;
+    closest.Reserve(k + 1);
+
+    queue.Push({ .index = 0, .distance = nodes_[0].bounds.Distance(point) });
+
+    while (queue.Size()) {
+        LinearDistance current = queue.Pop();
+
+        // nothing left in the queue can be closer
+        if (closest.Size() == k && current.distance >= closest.Top().distance) {
+            break;
+        }
+
+        Node const& node = nodes_[current.index];
+        if (node.IsLeaf()) {
+            LinearDistance leaf { .index = node.handle, .distance = current.distance };
+            if (closest.Size() < k) {
+                closest.Push(leaf);
+            } else {
+                closest.ReplaceTop(leaf);
+            }
+            continue;
+        }
+
+        i32 children[2] = { current.index + 1, nodes_[current.index + 1].skip };
+        for (i32 child : children) {
+            f32 distance = nodes_[child].bounds.Distance(point);
+            if (distance <= max_distance) {
+                queue.Push({ .index = child, .distance = distance });
+            }
+        }
+    }
+
+    i64 first = out.Size();
+    out.ResizeUninitialised(first + closest.Size());
+    for (i64 i = out.Size() - 1; i >= first; i--) {
+        out[i] = Handle { closest.Pop().index };
+    }
+}
+
+Optional<LinearBvh::RayHit> LinearBvh::RayCastClosest(Vector3 origin, Vector3 direction, f32 max_t) const {
+    Vector3 inv_direction = 1.f / direction;
+
+    Optional<RayHit> closest;
+    i32 num = As<i32>(nodes_.Size());
+    for (i32 index = 0; index < num;) {
+        Node const& node = nodes_[index];
+
+        Optional<f32> t = node.bounds.RayIntersection(origin, inv_direction, max_t);
+        if (!t) {
+            index = node.skip;
+            continue;
+        }
+
+        if (node.IsLeaf()) {
+            closest = RayHit { .handle = Handle { node.handle }, .t = *t };
+            max_t = *t;
+        }
+        index++;
+    }
+
+    return closest;
+}
+
+}
@@ -0,0 +1,194 @@
+#include "Pch.h"
+#include "SpatialHashGrid.h"
+#include "Heap.h"
+
+namespace Playground {
+
+namespace {
+// cells per axis on either side of the origin, 21 bits per axis in a key
+constexpr i32 CELL_LIMIT = 1 << 20;
+
+struct GridDistance {
+    i32 handle;
+    f32 distance;
+
+    bool operator<(GridDistance const& other) const {
+        return distance < other.distance;
+    }
+
+    bool operator>(GridDistance const& other) const {
+        return distance > other.distance;
+    }
+};
+}
+
+void SpatialHashGrid::Rebuild(Slice<Aabb3D> bounds) {
+    plgr_assert(cell_size_ > 0.f);
+
+    i32 num = As<i32>(bounds.num);
+
+    // the occupied cells change little between frames, the last frame's count avoids regrowing the map
+    i64 previous_cells = cells_.Size();
+    cell_ids_.Clear();
+    cell_ids_.Reserve(previous_cells);
+    cells_.Clear();
+
+    object_cells_.ResizeUninitialised(num);
+    sorted_bounds_.ResizeUninitialised(num);
+    sorted_handles_.ResizeUninitialised(num);
+
+    margin_ = Vector3 { 0.f };
+    cell_min_ = Vector3i { CELL_LIMIT };
+    cell_max_ = Vector3i { -CELL_LIMIT };
+
+    // count the objects of every cell
+    for (i32 i = 0; i < num; i++) {
+        Aabb3D const& object = bounds[i];
+        margin_ = Math::max(margin_, (object.vec_max - object.vec_min) * 0.5f);
+
+        Vector3i cell = _CellOf((object.vec_min + object.vec_max) * 0.5f);
+        cell_min_ = Math::min(cell_min_, cell);
+        cell_max_ = Math::max(cell_max_, cell);
+
+        u64 key = _Key(cell);
+        i32 cell_index;
+        if (Optional<i32*> id = cell_ids_.Find(key)) {
+            cell_index = **id;
+        } else {
+            cell_index = As<i32>(cells_.Size());
+            cell_ids_.Insert(key, cell_index);
+            cells_.PushBack({ .begin = 0, .num = 0 });
+        }
+
+        cells_[cell_index].num++;
+        object_cells_[i] = cell_index;
+    }
+
+    i32 begin = 0;
+    for (Cell& cell : cells_) {
+        cell.begin = begin;
+        begin += cell.num;
+        cell.num = 0;
+    }
+
+    // scatter, objects keep their order within a cell
+    for (i32 i = 0; i < num; i++) {
+        Cell& cell = cells_[object_cells_[i]];
+        i32 slot = cell.begin + cell.num++;
+        sorted_bounds_[slot] = bounds[i];
+        sorted_handles_[slot] = i;
+    }
+}
+
+bool SpatialHashGrid::Empty() const {
+    return cells_.Size() == 0;
+}
+
+Vector3i SpatialHashGrid::_CellOf(Vector3 point) const {
+    Vector3 cell = Math::clamp(Math::floor(point / cell_size_), f32(-CELL_LIMIT), f32(CELL_LIMIT - 1));
+    return Vector3i { cell };
+}
+
+u64 SpatialHashGrid::_Key(Vector3i cell) {
+    Vector3i biased = cell + Vector3i { CELL_LIMIT };
+    return (u64(biased.x()) << 42) | (u64(biased.y()) << 21) | u64(biased.z());
+}
+
+Optional<SpatialHashGrid::Handle> SpatialHashGrid::FindClosest(Vector3 point, f32 max_distance) const {
+    Array<Handle> closest;
+    FindKClosest(point, 1, max_distance, closest);
+
+    if (closest.Size() == 0) {
+        return NullOpt;
+    }
+    return closest[0];
+}
+
+void SpatialHashGrid::FindKClosest(Vector3 point, i32 k, f32 max_distance, Array<Handle>& out) const {
+    plgr_assert(k > 0);
+
+    if (Empty()) {
+        return;
+    }
+
+    // farthest first so the worst one can be replaced
+    Heap<GridDistance, std::greater<GridDistance>> closest;
+    closest.Reserve(k + 1);
+
+    auto consider = [&](i32 index) {
+        f32 distance = sorted_bounds_[index].Distance(point);
+        if (distance > max_distance) {
+            return;
+        }
+
+        GridDistance candidate { .handle = sorted_handles_[index], .distance = distance };
+        if (closest.Size() < k) {
+            closest.Push(candidate);
+        } else if (candidate.distance < closest.Top().distance) {
+            closest.ReplaceTop(candidate);
+        }
+    };
+
+    Vector3i center = _CellOf(point);
+    // a box reaches at most this much closer than its centre
+    f32 margin = margin_.length();
+    // shells past the occupied range are empty
+    i32 last_ring = Math::max(center - cell_min_, cell_max_ - center).max();
+
+    for (i32 ring = 0; ring <= last_ring; ring++) {
+        // centres in this shell are at least ring - 1 whole cells away
+        f32 lower_bound = (ring - 1) * cell_size_ - margin;
+        if (lower_bound > max_distance || (closest.Size() == k && lower_bound >= closest.Top().distance)) {
+            break;
+        }
+
+        // once the shells hold more cells than are occupied, going through all objects is cheaper
+        i64 side = 2 * ring + 1;
+        if (side * side * side > cells_.Size()) {
+            closest.Clear();
+            for (i32 i = 0; i < sorted_handles_.Size(); i++) {
+                consider(i);
+            }
+            break;
+        }
+
+        for (i32 z = -ring; z <= ring; z++) {
+            for (i32 y = -ring; y <= ring; y++) {
+                // inside the shell only its two faces along x are visited
+                bool inner = Math::abs(z) < ring && Math::abs(y) < ring;
+                for (i32 x = -ring; x <= ring; x += inner ? 2 * ring : 1) {
+                    Vector3i cell = center + Vector3i { x, y, z };
+                    if ((cell < cell_min_).any() || (cell > cell_max_).any()) {
+                        continue;
+                    }
+
+                    if (Optional<i32*> id = cell_ids_.Find(_Key(cell))) {
+                        Cell const& objects = cells_[**id];
+                        for (i32 i = objects.begin; i < objects.begin + objects.num; i++) {
+                            consider(i);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    i64 first = out.Size();
+    out.ResizeUninitialised(first + closest.Size());
+    for (i64 i = out.Size() - 1; i >= first; i--) {
+        out[i] = Handle { closest.Pop().handle };
+    }
+}
+
+bool SpatialHashGrid::FindAllIntersecting(Vector3 point, Array<Handle>& out) const {
+    plgr_assert(out.Size() == 0);
+
+    _Query(Aabb3D::From(point, point), [point](Aabb3D const& bounds) { return bounds.Contains(point); }, [&out](Handle handle) {
+        out.PushBack(handle);
+        return true;
+    });
+
+    return out.Size();
+}
+
+}
@@ -0,0 +1,103 @@
+#include "Pch.h"
+#include "Task.h"
+
+namespace Playground {
+
+static thread_local TaskLoop* tls_task_loop = nullptr;
+
+std::coroutine_handle<> _TaskPromiseBase::_Finish()
+{
+    void* continuation = continuation_.exchange(this, std::memory_order_acq_rel);
+    if (!continuation) {
+        return std::noop_coroutine();
+    }
+
+    // read after the exchange, the awaiter wrote it before publishing itself
+    TaskLoop* loop = continuation_loop_;
+    std::coroutine_handle<> awaiting = std::coroutine_handle<>::from_address(continuation);
+    if (loop && loop != TaskLoop::Current()) {
+        loop->Post(awaiting);
+        return std::noop_coroutine();
+    }
+    return awaiting;
+}
+
+TaskLoop::TaskLoop(JobSystem* jobs)
+    : jobs_(jobs)
+{
+}
+
+TaskLoop* TaskLoop::Current()
+{
+    return tls_task_loop;
+}
+
+TaskLoop* TaskLoop::_SetCurrent(TaskLoop* loop)
+{
+    return std::exchange(tls_task_loop, loop);
+}
+
+void TaskLoop::Post(std::coroutine_handle<> handle)
+{
+    // notified under the lock, once Run saw its last post it can return and the loop may be gone
+    std::lock_guard<std::mutex> lock(ready_mutex_);
+    ready_.PushBack(handle);
+    wake_.notify_one();
+}
+
+void TaskLoop::AddPoll(Poll poll)
+{
+    plgr_assert(Current() == this);
+    polls_.PushBack(poll);
+}
+
+bool TaskLoop::RunOne()
+{
+    plgr_assert(Current() == this);
+
+    std::coroutine_handle<> handle;
+    {
+        std::lock_guard<std::mutex> lock(ready_mutex_);
+        if (ready_.Size()) {
+            handle = ready_.RemoveAt(0);
+        }
+    }
+
+    if (!handle) {
+        for (i64 i = 0; i < polls_.Size(); i++) {
+            if (polls_[i].is_done(polls_[i].data)) {
+                // out of the list first, the coroutine may add polls when it's resumed
+                handle = polls_.RemoveAt(i).handle;
+                break;
+            }
+        }
+    }
+
+    if (!handle) {
+        return false;
+    }
+
+    handle.resume();
+    return true;
+}
+
+void TaskLoop::Sleep()
+{
+    plgr_assert(Current() == this);
+
+    std::unique_lock<std::mutex> lock(ready_mutex_);
+    if (ready_.Size()) {
+        return;
+    }
+
+    if (polls_.Size() == 0) {
+        wake_.wait(lock, [this]() { return ready_.Size() > 0; });
+    } else if (polls_.Size() == 1 && polls_[0].wait) {
+        lock.unlock();
+        polls_[0].wait(polls_[0].data);
+    } else {
+        wake_.wait_for(lock, POLL_INTERVAL, [this]() { return ready_.Size() > 0; });
+    }
+}
+
+}
@@ -0,0 +1,304 @@
+#include "Pch.h"
+#include "WideBvh.h"
+#include "Heap.h"
+
+namespace Playground {
+
+template <typename V>
+void WideBvh<V>::Build(DynamicBvh const& source) {
+    nodes_.Clear();
+
+    if (source.root_ == DynamicBvh::NULL_NODE) {
+        return;
+    }
+
+    DynamicBvh::Node const& root = source.nodes_[source.root_];
+    if (root.IsLeaf()) {
+        Node node;
+        node.child_bounds = Aabb3DPacket<V>::Load(&root.child_bounds[0], 1);
+        node.children[0] = root.handle;
+        for (i32 i = 1; i < WIDTH; i++) {
+            node.children[i] = DynamicBvh::NULL_NODE;
+        }
+        node.leaf_mask = 1;
+        nodes_.ResizeUninitialised(1);
+        nodes_[0] = node;
+        return;
+    }
+
+    _Collapse(source, source.root_);
+}
+
+template <typename V>
+Aabb3D WideBvh<V>::_Collapse(DynamicBvh const& source, i32 source_node) {
+    struct Candidate {
+        i32 node;
+        Aabb3D bounds;
+    };
+
+    Candidate candidates[WIDTH];
+    i32 num = 0;
+    for (i32 c = 0; c < 2; c++) {
+        candidates[num++] = { .node = source.nodes_[source_node].children[c], .bounds = source.nodes_[source_node].child_bounds[c] };
+    }
+
+    // opening the largest subtree removes the most area from a node visit
+    while (num < WIDTH) {
+        i32 largest = -1;
+        f32 largest_area = -1.f;
+        for (i32 i = 0; i < num; i++) {
+            if (!source.nodes_[candidates[i].node].IsLeaf() && candidates[i].bounds.Area() > largest_area) {
+                largest = i;
+                largest_area = candidates[i].bounds.Area();
+            }
+        }
+
+        if (largest == -1) {
+            break;
+        }
+
+        DynamicBvh::Node const& opened = source.nodes_[candidates[largest].node];
+        candidates[largest] = { .node = opened.children[0], .bounds = opened.child_bounds[0] };
+        candidates[num++] = { .node = opened.children[1], .bounds = opened.child_bounds[1] };
+    }
+
+    i32 index = As<i32>(nodes_.Size());
+    nodes_.ResizeUninitialised(index + 1);
+
+    // children are collapsed first, nodes_ may reallocate
+    Node node;
+    node.leaf_mask = 0;
+    Aabb3D lanes[WIDTH];
+    for (i32 i = 0; i < num; i++) {
+        DynamicBvh::Node const& child = source.nodes_[candidates[i].node];
+        if (child.IsLeaf()) {
+            lanes[i] = child.child_bounds[0];
+            node.children[i] = child.handle;
+            node.leaf_mask |= 1 << i;
+        } else {
+            node.children[i] = As<i32>(nodes_.Size());
+            lanes[i] = _Collapse(source, candidates[i].node);
+        }
+    }
+    for (i32 i = num; i < WIDTH; i++) {
+        node.children[i] = DynamicBvh::NULL_NODE;
+    }
+
+    node.child_bounds = Aabb3DPacket<V>::Load(lanes, num);
+    nodes_[index] = node;
+
+    return node.child_bounds.Bounds();
+}
+
+template <typename V>
+void WideBvh<V>::Refit(DynamicBvh const& source) {
+    // children follow their parents, so walking backwards visits every child before its parent
+    for (i64 index = nodes_.Size() - 1; index >= 0; index--) {
+        Node& node = nodes_[index];
+
+        Aabb3D lanes[WIDTH];
+        i32 num = 0;
+        for (; num < WIDTH && node.children[num] != DynamicBvh::NULL_NODE; num++) {
+            if (node.leaf_mask & (1 << num)) {
+                lanes[num] = source.GetBoundingBox(Handle { node.children[num] });
+            } else {
+                lanes[num] = nodes_[node.children[num]].child_bounds.Bounds();
+            }
+        }
+
+        node.child_bounds = Aabb3DPacket<V>::Load(lanes, num);
+    }
+}
+
+template <typename V>
+bool WideBvh<V>::Empty() const {
+    return nodes_.Size() == 0;
+}
+
+template <typename V>
+i32 WideBvh<V>::GetDepth() const {
+    if (Empty()) {
+        return 0;
+    }
+
+    struct Frame {
+        i32 node;
+        i32 depth;
+    };
+    Array<Frame> stack;
+    stack.PushBack({ .node = 0, .depth = 1 });
+    i32 max_depth = 1;
+
+    while (stack.Size()) {
+        auto [index, depth] = stack.PopBack();
+        max_depth = Max(max_depth, depth);
+
+        Node const& node = nodes_[index];
+        for (i32 i = 0; i < WIDTH && node.children[i] != DynamicBvh::NULL_NODE; i++) {
+            if (!(node.leaf_mask & (1 << i))) {
+                stack.PushBack({ .node = node.children[i], .depth = depth + 1 });
+            }
+        }
+    }
+
+    return max_depth;
+}
+
+template <typename V>
+bool WideBvh<V>::FindAllIntersecting(Vector3 point, Array<Handle>& out) const {
+    plgr_assert(out.Size() == 0);
+
+    _Query([point](Aabb3DPacket<V> const& packet) { return packet.Contains(point); }, [&out](Handle handle) {
+        out.PushBack(handle);
+        return true;
+    });
+
+    return out.Size();
+}
+
+template <typename V>
+Optional<DynamicBvh::Handle> WideBvh<V>::FindClosest(Vector3 point, f32 max_distance) const {
+    Array<Handle> closest;
+    FindKClosest(point, 1, max_distance, closest);
+
+    if (closest.Size() == 0) {
+        return NullOpt;
+    }
+    return closest[0];
+}
+
+namespace {
+    struct WideDistance {
+        i32 index;
+        f32 distance_squared;
+
+        bool operator<(WideDistance const& other) const {
+            return distance_squared < other.distance_squared;
+        }
+
+        bool operator>(WideDistance const& other) const {
+            return distance_squared > other.distance_squared;
+        }
+    };
+}
+
+template <typename V>
+void WideBvh<V>::FindKClosest(Vector3 point, i32 k, f32 max_distance, Array<Handle>& out) const {
+    plgr_assert(k > 0);
+
+    if (Empty()) {
+        return;
+    }
+
+    // nodes nearest first, results farthest first so the worst one can be replaced
+    Heap<WideDistance> queue;
+    Heap<WideDistance, std::greater<WideDistance>> closest;
+    closest.Reserve(k + 1);
+
+    V max_distance_squared = V::Splat(max_distance * max_distance);
+    queue.Push({ .index = 0, .distance_squared = 0.f });
+
+    while (queue.Size()) {
+        WideDistance current = queue.Pop();
+
+        // nothing left in the queue can be closer
+        if (closest.Size() == k && current.distance_squared >= closest.Top().distance_squared) {
+            break;
+        }
+
+        Node const& node = nodes_[current.index];
+        V distances_squared = node.child_bounds.DistanceSquared(point);
+        alignas(32) f32 lanes[WIDTH];
+        distances_squared.Store(lanes);
+
+        for (i32 mask = MoveMask(CmpLe(distances_squared, max_distance_squared)); mask; mask &= mask - 1) {
+            i32 lane = std::countr_zero(As<u32>(mask));
+            WideDistance child { .index = node.children[lane], .distance_squared = lanes[lane] };
+
+            if (!(node.leaf_mask & (1 << lane))) {
+                queue.Push(child);
+            } else if (closest.Size() < k) {
+                closest.Push(child);
+            } else if (child.distance_squared < closest.Top().distance_squared) {
+                closest.ReplaceTop(child);
+            }
+        }
+    }
+
+    i64 first = out.Size();
+    out.ResizeUninitialised(first + closest.Size());
+    for (i64 i = out.Size() - 1; i >= first; i--) {
+        out[i] = Handle { closest.Pop().index };
+    }
+}
+
+template <typename V>
+Optional<DynamicBvh::RayHit> WideBvh<V>::RayCastClosest(Vector3 origin, Vector3 direction, f32 max_t) const {
+    if (Empty()) {
+        return NullOpt;
+    }
+
+    Vector3 inv_direction = 1.f / direction;
+
+    struct Frame {
+        i32 node;
+        f32 t;
+    };
+
+    Optional<RayHit> closest;
+    Array<Frame> stack;
+    stack.PushBack({ .node = 0, .t = 0.f });
+
+    while (stack.Size()) {
+        Frame frame = stack.PopBack();
+        // max_t may have shrunk since the node was pushed
+        if (frame.t > max_t) {
+            continue;
+        }
+
+        Node const& node = nodes_[frame.node];
+        V t_enter;
+        i32 mask = MoveMask(node.child_bounds.RayIntersection(origin, inv_direction, V::Splat(max_t), t_enter));
+        if (!mask) {
+            continue;
+        }
+
+        alignas(32) f32 ts[WIDTH];
+        t_enter.Store(ts);
+
+        for (i32 leaves = mask & node.leaf_mask; leaves; leaves &= leaves - 1) {
+            i32 lane = std::countr_zero(As<u32>(leaves));
+            if (ts[lane] <= max_t) {
+                closest = RayHit { .handle = Handle { node.children[lane] }, .t = ts[lane] };
+                max_t = ts[lane];
+            }
+        }
+
+        // farthest first so the nearest child is on top
+        Frame children[WIDTH];
+        i32 num = 0;
+        for (i32 inner = mask & ~node.leaf_mask; inner; inner &= inner - 1) {
+            i32 lane = std::countr_zero(As<u32>(inner));
+            if (ts[lane] > max_t) {
+                continue;
+            }
+
+            Frame child { .node = node.children[lane], .t = ts[lane] };
+            i32 i = num++;
+            for (; i > 0 && children[i - 1].t < child.t; i--) {
+                children[i] = children[i - 1];
+            }
+            children[i] = child;
+        }
+        for (i32 i = 0; i < num; i++) {
+            stack.PushBack(children[i]);
+        }
+    }
+
+    return closest;
+}
+
+template struct WideBvh<f32x4>;
+template struct WideBvh<f32x8>;
+
+}
@@ -4,25 +4,6 @@
 
 namespace Playground {
 
-namespace Hash {
-    template <>
-    u64 HashValue(TypelessComponentId id)
-    {
-        return id.id;
-    }
-}
-
-namespace Hash {
-    template <>
-    u64 HashValue(TypedComponentId id)
-    {
-        static_assert(sizeof(id.type) <= 4);
-        static_assert(sizeof(id.id) <= 4);
-        return (As<u64>(id.id.id) << 32) | As<u64>(id.type);
-    }
-}
-
-
 bool TypelessComponentId::operator==(TypelessComponentId other) const
 {
     return id == other.id;
@@ -40,6 +21,28 @@ EntityId Entities::Spawn()
 
 void Entities::Destroy(EntityId id)
 {
+    Entity& entity = entities_[id];
+
+    if (entity.transform_) {
+        _ClearOwner(entity.transform_);
+    }
+
+    i32 node_index = entity.components_list_head_index;
+    while (node_index != EntityComponentListNode::EMPTY_NODE_INDEX) {
+        EntityComponentListNode& node = component_list_nodes_[node_index];
+        for (i32 i = 0; i < EntityComponentListNode::NODE_COMPONENTS_NUM; i++) {
+            if (node.node_ids[i].type != InvalidComponentT) {
+                _ClearOwner(node.node_ids[i]);
+            }
+        }
+
+        i32 next_node_index = node.next_node_index;
+        // allocation expects recycled nodes to be empty
+        node.Clear();
+        component_list_nodes_.Free(node_index);
+        node_index = next_node_index;
+    }
+
     entities_.Remove(id);
 }
 
@@ -47,9 +50,9 @@ void Entities::AttachComponent(EntityId entity, TypedComponentId ctyped)
 {
     plgr_assert(ctyped.type != InvalidComponentT);
     plgr_assert(!GetOwner(ctyped));
-    if (ctyped.type == ComponentId<0>::ComponentTypeId) {
+    if (ctyped.type == TransformComponentT) {
         plgr_assert(!entities_[entity].transform_);
-        entities_[entity].transform_ = ComponentId<0>::From(ctyped.id);
+        entities_[entity].transform_ = TransformId::From(ctyped.id);
     } else {
         i32 node_index = entities_[entity].components_list_head_index;
         if(node_index == EntityComponentListNode::EMPTY_NODE_INDEX) {
@@ -81,7 +84,7 @@ void Entities::AttachComponent(EntityId entity, TypedComponentId ctyped)
         plgr_assert(attached);
     }
 
-    component_owner_.Insert(ctyped, entity);
+    _SetOwner(ctyped, entity);
 }
 
 bool EntityComponentListNode::Empty() const
@@ -95,11 +98,20 @@ bool EntityComponentListNode::Empty() const
     return true;
 }
 
+void EntityComponentListNode::Clear()
+{
+    for (i32 i = 0; i < EntityComponentListNode::NODE_COMPONENTS_NUM; i++) {
+        node_ids[i] = {};
+    }
+
+    next_node_index = EMPTY_NODE_INDEX;
+}
+
 void Entities::DetachComponent(EntityId entity, TypedComponentId ctyped)
 {
     plgr_assert(ctyped.type != InvalidComponentT);
     plgr_assert(GetOwner(ctyped));
-    if (ctyped.type == ComponentId<0>::ComponentTypeId) {
+    if (ctyped.type == TransformComponentT) {
         plgr_assert(entities_[entity].transform_);
         entities_[entity].transform_ = {};
     } else {
@@ -117,6 +129,7 @@ void Entities::DetachComponent(EntityId entity, TypedComponentId ctyped)
             }
             if(detached && node.Empty()) {
                 entities_[entity].components_list_head_index = node.next_node_index;
+                node.Clear();
                 component_list_nodes_.Free(node_index);
             }
         }
@@ -138,6 +151,7 @@ void Entities::DetachComponent(EntityId entity, TypedComponentId ctyped)
 
             if (detached && node.Empty()) {
                 component_list_nodes_[prev_node_index].next_node_index = next_node_index;
+                node.Clear();
                 component_list_nodes_.Free(node_index);
             }
 
@@ -148,13 +162,16 @@ void Entities::DetachComponent(EntityId entity, TypedComponentId ctyped)
         plgr_assert(detached);
     }
 
-    component_owner_.Remove(ctyped);
+    _ClearOwner(ctyped);
 }
 
 Optional<TypelessComponentId> Entities::GetAnyComponentOfType(EntityId entity, ComponentTypeId ctype)
 {
     plgr_assert(ctype != InvalidComponentT);
-    if (ctype == ComponentId<0>::ComponentTypeId) {
+    if (ctype == TransformComponentT) {
+        if (!entities_[entity].transform_) {
+            return NullOpt;
+        }
         return As<TypelessComponentId>(entities_[entity].transform_);
     } else {
         i32 node_index = entities_[entity].components_list_head_index;
@@ -173,17 +190,39 @@ Optional<TypelessComponentId> Entities::GetAnyComponentOfType(EntityId entity, C
     return NullOpt;
 }
 
-template<typename T>
-Optional<T> UnpackPointer(Optional<T*> o) {
-    if(!o) {
+Optional<EntityId> Entities::GetOwner(TypedComponentId ctyped)
+{
+    if (ctyped.type < 0 || ctyped.type >= component_owners_.Size()) {
         return NullOpt;
     }
-    return **o;
+
+    Array<ComponentOwnerTable::Entry>& entries = component_owners_[ctyped.type].entries_;
+    i32 index = As<i32>(ctyped.id.id & Handle32::MAX_INDEX);
+
+    if (index >= entries.Size() || entries[index].component != ctyped.id.id) {
+        return NullOpt;
+    }
+
+    return entries[index].owner;
 }
 
-Optional<EntityId> Entities::GetOwner(TypedComponentId ctyped)
+void Entities::_SetOwner(TypedComponentId ctyped, EntityId entity)
+{
+    component_owners_.ExpandToIndex(ctyped.type);
+    Array<ComponentOwnerTable::Entry>& entries = component_owners_[ctyped.type].entries_;
+    i32 index = As<i32>(ctyped.id.id & Handle32::MAX_INDEX);
+
+    entries.ExpandToIndex(index);
+    entries[index] = { .component = ctyped.id.id, .owner = entity };
+}
+
+void Entities::_ClearOwner(TypedComponentId ctyped)
 {
-    return UnpackPointer(component_owner_.Find(ctyped));
+    i32 index = As<i32>(ctyped.id.id & Handle32::MAX_INDEX);
+    ComponentOwnerTable::Entry& entry = component_owners_[ctyped.type].entries_[index];
+
+    plgr_assert(entry.component == ctyped.id.id);
+    entry = {};
 }
 
 }
\ No newline at end of file
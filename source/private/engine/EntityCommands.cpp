@@ -0,0 +1,208 @@
+#include "Pch.h"
+#include "EntityCommands.h"
+#include "Jobs.h"
+#include "algorithms.h"
+
+namespace Playground {
+
+namespace {
+// by scope, then by sequence within a scope, stable
+template <typename T>
+void SortByRecording(Array<T>& items)
+{
+    Slice<T> slice { .data = items.Data(), .num = items.Size() };
+    RadixSortBy(slice, [](T const& item) { return item.key.sequence; });
+    RadixSortBy(slice, [](T const& item) { return item.key.scope; });
+}
+}
+
+DeferredEntityId EntityCommandBuffer::Spawn()
+{
+    spawns_.PushBack(_NextKey());
+    return { .buffer = buffer_index_, .index = As<i32>(spawns_.Size() - 1) };
+}
+
+void EntityCommandBuffer::Destroy(EntityId entity)
+{
+    _Record(EntityCommand::Type::Destroy, entity, -1, {});
+}
+
+void EntityCommandBuffer::Destroy(DeferredEntityId entity)
+{
+    plgr_assert(entity.buffer == buffer_index_);
+    _Record(EntityCommand::Type::Destroy, {}, entity.index, {});
+}
+
+void EntityCommandBuffer::AttachComponent(EntityId entity, TypedComponentId component)
+{
+    _Record(EntityCommand::Type::Attach, entity, -1, component);
+}
+
+void EntityCommandBuffer::AttachComponent(DeferredEntityId entity, TypedComponentId component)
+{
+    plgr_assert(entity.buffer == buffer_index_);
+    _Record(EntityCommand::Type::Attach, {}, entity.index, component);
+}
+
+void EntityCommandBuffer::DetachComponent(EntityId entity, TypedComponentId component)
+{
+    _Record(EntityCommand::Type::Detach, entity, -1, component);
+}
+
+void EntityCommandBuffer::DetachComponent(DeferredEntityId entity, TypedComponentId component)
+{
+    plgr_assert(entity.buffer == buffer_index_);
+    _Record(EntityCommand::Type::Detach, {}, entity.index, component);
+}
+
+EntityCommandBuffer::ScopeState EntityCommandBuffer::BeginScope(u64 scope)
+{
+    ScopeState previous { .scope = scope_, .sequence = sequence_ };
+    scope_ = scope;
+    sequence_ = 0;
+    return previous;
+}
+
+void EntityCommandBuffer::EndScope(ScopeState previous)
+{
+    scope_ = previous.scope;
+    sequence_ = previous.sequence;
+}
+
+bool EntityCommandBuffer::Empty() const
+{
+    return spawns_.Size() == 0 && commands_.Size() == 0;
+}
+
+void EntityCommandBuffer::Clear()
+{
+    sequence_ = 0;
+    spawns_.Clear();
+    commands_.Clear();
+}
+
+EntityCommandKey EntityCommandBuffer::_NextKey()
+{
+    return { .scope = scope_, .sequence = sequence_++ };
+}
+
+void EntityCommandBuffer::_Record(EntityCommand::Type type, EntityId entity, i32 deferred_index, TypedComponentId component)
+{
+    plgr_assert(entity || (0 <= deferred_index && deferred_index < spawns_.Size()));
+    commands_.PushBack({ .type = type, .entity = entity, .deferred_index = deferred_index, .component = component, .key = _NextKey() });
+}
+
+EntityCommands::EntityCommands(i32 buffers_num)
+{
+    plgr_assert(buffers_num > 0);
+
+    for (i32 i = 0; i < buffers_num; i++) {
+        Box<EntityCommandBuffer> buffer { new EntityCommandBuffer {} };
+        buffer->buffer_index_ = i;
+        buffers_.PushBackRvalueRef(std::move(buffer));
+    }
+    spawned_.Resize(buffers_num);
+}
+
+EntityCommandBuffer& EntityCommands::Local()
+{
+    return At(JobSystem::GetWorkerIndex());
+}
+
+EntityCommandBuffer& EntityCommands::At(i32 buffer_index)
+{
+    return *buffers_[buffer_index];
+}
+
+i32 EntityCommands::BuffersNum() const
+{
+    return As<i32>(buffers_.Size());
+}
+
+void EntityCommands::Playback(Entities& entities)
+{
+    struct Spawned {
+        EntityCommandKey key;
+        i32 buffer;
+        i32 index;
+    };
+
+    struct Entry {
+        EntityCommand::Type type;
+        EntityId entity;
+        i32 buffer;
+        i32 command;
+        EntityCommandKey key;
+    };
+
+    i64 spawns_num = 0;
+    i64 commands_num = 0;
+
+    for (Box<EntityCommandBuffer>& buffer : buffers_) {
+        spawns_num += buffer->spawns_.Size();
+        commands_num += buffer->commands_.Size();
+    }
+
+    // ids are handed out in recording order, not buffer order
+    Array<Spawned> spawns;
+    spawns.Reserve(spawns_num);
+    for (i32 b = 0, B = BuffersNum(); b < B; b++) {
+        Array<EntityCommandKey>& keys = buffers_[b]->spawns_;
+        spawned_[b].Clear();
+        spawned_[b].ResizeUninitialised(keys.Size());
+        for (i32 i = 0, N = As<i32>(keys.Size()); i < N; i++) {
+            spawns.PushBack({ .key = keys[i], .buffer = b, .index = i });
+        }
+    }
+    SortByRecording(spawns);
+
+    entities.entities_.Reserve(entities.entities_.Size() + spawns_num);
+    for (Spawned const& spawn : spawns) {
+        spawned_[spawn.buffer][spawn.index] = entities.Spawn();
+    }
+
+    Array<Entry> entries;
+    entries.Reserve(commands_num);
+
+    for (i32 b = 0, B = BuffersNum(); b < B; b++) {
+        Array<EntityCommand>& commands = buffers_[b]->commands_;
+        for (i32 c = 0, C = As<i32>(commands.Size()); c < C; c++) {
+            EntityId entity = commands[c].deferred_index >= 0 ? spawned_[b][commands[c].deferred_index] : commands[c].entity;
+            entries.PushBack({ .type = commands[c].type, .entity = entity, .buffer = b, .command = c, .key = commands[c].key });
+        }
+    }
+    SortByRecording(entries);
+
+    // batches by command type, entity order within a batch
+    // the sort is stable, so recording order still breaks ties
+    RadixSortBy(Slice<Entry> { .data = entries.Data(), .num = entries.Size() }, [](Entry const& entry) {
+        return (u64(entry.type) << 32) | u32(entry.entity.GetIndex());
+    });
+
+    for (Entry const& entry : entries) {
+        EntityCommand const& command = buffers_[entry.buffer]->commands_[entry.command];
+
+        switch (entry.type) {
+        case EntityCommand::Type::Detach:
+            entities.DetachComponent(entry.entity, command.component);
+            break;
+        case EntityCommand::Type::Attach:
+            entities.AttachComponent(entry.entity, command.component);
+            break;
+        case EntityCommand::Type::Destroy:
+            entities.Destroy(entry.entity);
+            break;
+        }
+    }
+
+    for (Box<EntityCommandBuffer>& buffer : buffers_) {
+        buffer->Clear();
+    }
+}
+
+EntityId EntityCommands::Resolve(DeferredEntityId entity) const
+{
+    return spawned_[entity.buffer][entity.index];
+}
+
+}
@@ -0,0 +1,165 @@
+#include "Pch.h"
+#include "Systems.h"
+
+namespace Playground {
+
+SystemAccess& SystemAccess::Read(ComponentTypeId type)
+{
+    plgr_assert(type != InvalidComponentT);
+    if (!reads_.Contains(type)) {
+        reads_.PushBack(type);
+    }
+    return *this;
+}
+
+SystemAccess& SystemAccess::Write(ComponentTypeId type)
+{
+    plgr_assert(type != InvalidComponentT);
+    if (!writes_.Contains(type)) {
+        writes_.PushBack(type);
+    }
+    return *this;
+}
+
+SystemAccess& SystemAccess::Exclusive()
+{
+    exclusive_ = true;
+    return *this;
+}
+
+bool SystemAccess::ConflictsWith(SystemAccess const& other) const
+{
+    if (exclusive_ || other.exclusive_) {
+        return true;
+    }
+
+    for (i64 i = 0, N = writes_.Size(); i < N; i++) {
+        if (other.reads_.Contains(writes_[i]) || other.writes_.Contains(writes_[i])) {
+            return true;
+        }
+    }
+
+    for (i64 i = 0, N = reads_.Size(); i < N; i++) {
+        if (other.writes_.Contains(reads_[i])) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+ISystem::~ISystem()
+{
+}
+
+i32 SystemScheduler::AddSystem(const char* name, SystemAccess access, Box<ISystem> system)
+{
+    plgr_assert(running_jobs_ == nullptr);
+
+    Box<Node> node { new Node {} };
+    node->name = name;
+    node->system = std::move(system);
+    node->access = std::move(access);
+
+    nodes_.PushBackRvalueRef(std::move(node));
+    graph_dirty_ = true;
+
+    return As<i32>(nodes_.Size() - 1);
+}
+
+i32 SystemScheduler::SystemsNum() const
+{
+    return As<i32>(nodes_.Size());
+}
+
+void SystemScheduler::BuildGraph()
+{
+    for (Box<Node>& node : nodes_) {
+        node->dependents.Clear();
+        node->dependencies_num = 0;
+    }
+
+    // O(n^2) in systems, which stay in the tens
+    for (i32 j = 0, N = SystemsNum(); j < N; j++) {
+        for (i32 i = 0; i < j; i++) {
+            if (nodes_[i]->access.ConflictsWith(nodes_[j]->access)) {
+                nodes_[i]->dependents.PushBack(j);
+                nodes_[j]->dependencies_num++;
+            }
+        }
+    }
+
+    graph_dirty_ = false;
+}
+
+void SystemScheduler::Run(JobSystem* jobs)
+{
+    if (graph_dirty_) {
+        BuildGraph();
+    }
+
+    if (!jobs) {
+        for (i32 i = 0, N = SystemsNum(); i < N; i++) {
+            _RunSystem(i, nullptr);
+        }
+        return;
+    }
+
+    plgr_assert(running_jobs_ == nullptr);
+    plgr_assert(!commands_ || commands_->BuffersNum() >= jobs->WorkersNum());
+    running_jobs_ = jobs;
+
+    for (Box<Node>& node : nodes_) {
+        node->pending_dependencies.store(node->dependencies_num, std::memory_order_relaxed);
+    }
+
+    // roots go out in registration order
+    for (i32 i = 0, N = SystemsNum(); i < N; i++) {
+        if (nodes_[i]->dependencies_num == 0) {
+            _Submit(i);
+        }
+    }
+
+    jobs->Wait(running_counter_);
+    running_jobs_ = nullptr;
+}
+
+void SystemScheduler::_RunSystem(i32 index, JobSystem* jobs)
+{
+    SystemContext context { .jobs_ = jobs, .commands_ = commands_, .system_index_ = index };
+    if (!commands_) {
+        nodes_[index]->system->Run(context);
+        return;
+    }
+
+    // the worker may be in the middle of another system's chunk, waiting on it
+    EntityCommandBuffer& buffer = commands_->Local();
+    EntityCommandBuffer::ScopeState previous = buffer.BeginScope(context._Scope(0));
+    nodes_[index]->system->Run(context);
+    buffer.EndScope(previous);
+}
+
+void SystemScheduler::_RunNode(i32 index)
+{
+    Node& node = *nodes_[index];
+
+    _RunSystem(index, running_jobs_);
+
+    // dependents are submitted before this job retires, so the frame counter can't hit zero early
+    for (i32 dependent : node.dependents) {
+        if (nodes_[dependent]->pending_dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            _Submit(dependent);
+        }
+    }
+}
+
+void SystemScheduler::_Submit(i32 index)
+{
+    JobFunction run = [](void* data, i64 begin, i64) {
+        static_cast<SystemScheduler*>(data)->_RunNode(As<i32>(begin));
+    };
+
+    running_jobs_->Submit({ .function = run, .data = this, .begin = index, .end = index + 1 }, running_counter_);
+}
+
+}
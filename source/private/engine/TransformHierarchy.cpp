@@ -0,0 +1,395 @@
+#include "Pch.h"
+#include "TransformHierarchy.h"
+
+namespace Playground {
+
+TransformId TransformHierarchy::Add(Transform local, TransformId parent)
+{
+    i32 index = freelist_.Allocate();
+    indirection_.ExpandToIndex(index);
+    generation_.ExpandToIndex(index);
+    generation_[index] = Max(As<i8>(1), generation_[index]);
+
+    i32 flat_index = As<i32>(Size());
+    indirection_[index] = flat_index;
+    rev_indirection_.PushBack(index);
+
+    // appending keeps the parent in front
+    parents_.PushBack(parent ? GetFlatIndex(parent) : NO_PARENT);
+    first_child_.PushBack(-1);
+    next_sibling_.PushBack(-1);
+    prev_sibling_.PushBack(-1);
+    _Link(flat_index, parents_[flat_index]);
+    locals_.PushBack(local);
+    worlds_.PushBack(local);
+    dirty_.PushBack(0);
+    world_changed_.PushBack(0);
+    _MarkDirty(flat_index);
+
+    return TransformId::Make(index, generation_[index]);
+}
+
+void TransformHierarchy::Remove(TransformId id)
+{
+    i32 flat_index = GetFlatIndex(id);
+    i32 parent = parents_[flat_index];
+
+    _Unlink(flat_index);
+    for (i32 child = first_child_[flat_index]; child != -1;) {
+        i32 next = next_sibling_[child];
+        parents_[child] = parent;
+        locals_[child] = locals_[flat_index].Combine(locals_[child]);
+        _Link(child, parent);
+        _MarkDirty(child);
+        child = next;
+    }
+
+    // the last node moves into the hole, everything linking to it is pointed at its new index
+    i32 last_flat_index = As<i32>(Size() - 1);
+    if (flat_index != last_flat_index) {
+        for (i32 child = first_child_[last_flat_index]; child != -1; child = next_sibling_[child]) {
+            parents_[child] = flat_index;
+        }
+        if (prev_sibling_[last_flat_index] != -1) {
+            next_sibling_[prev_sibling_[last_flat_index]] = flat_index;
+        } else if (parents_[last_flat_index] != NO_PARENT) {
+            first_child_[parents_[last_flat_index]] = flat_index;
+        }
+        if (next_sibling_[last_flat_index] != -1) {
+            prev_sibling_[next_sibling_[last_flat_index]] = flat_index;
+        }
+    }
+
+    rev_indirection_.RemoveAtAndSwapWithLast(flat_index);
+    parents_.RemoveAtAndSwapWithLast(flat_index);
+    first_child_.RemoveAtAndSwapWithLast(flat_index);
+    next_sibling_.RemoveAtAndSwapWithLast(flat_index);
+    prev_sibling_.RemoveAtAndSwapWithLast(flat_index);
+    locals_.RemoveAtAndSwapWithLast(flat_index);
+    worlds_.RemoveAtAndSwapWithLast(flat_index);
+    dirty_.RemoveAtAndSwapWithLast(flat_index);
+    world_changed_.RemoveAtAndSwapWithLast(flat_index);
+
+    if (flat_index != last_flat_index) {
+        indirection_[rev_indirection_[flat_index]] = flat_index;
+        // the moved node may now sit in front of its parent
+        order_dirty_ = true;
+    }
+
+    _Release(id);
+}
+
+void TransformHierarchy::Remove(Slice<TransformId> ids)
+{
+    if (order_dirty_) {
+        Sort();
+    }
+
+    i32 N = As<i32>(Size());
+
+    Array<u8> removed;
+    removed.Resize(N);
+    for (i64 i = 0; i < ids.num; i++) {
+        i32 flat_index = GetFlatIndex(ids[i]);
+        plgr_assert(!removed[flat_index]);
+        removed[flat_index] = 1;
+    }
+
+    // parents come first, so a removed node's surviving ancestor and the transform up to it are known
+    // by the time its children are reached
+    Array<i32> kept_parent;
+    Array<Transform> to_kept_parent;
+    kept_parent.ResizeUninitialised(N);
+    to_kept_parent.ResizeUninitialised(N);
+
+    Array<i32> new_index;
+    new_index.ResizeUninitialised(N);
+    i32 kept = 0;
+
+    for (i32 i = 0; i < N; i++) {
+        i32 parent = parents_[i];
+        bool parent_removed = parent != NO_PARENT && removed[parent];
+
+        if (removed[i]) {
+            kept_parent[i] = parent_removed ? kept_parent[parent] : parent;
+            to_kept_parent[i] = parent_removed ? to_kept_parent[parent].Combine(locals_[i]) : locals_[i];
+            continue;
+        }
+
+        Transform local = locals_[i];
+        u8 dirty = dirty_[i];
+        if (parent_removed) {
+            local = to_kept_parent[parent].Combine(local);
+            parent = kept_parent[parent];
+            dirty = 1;
+            any_dirty_ = true;
+        }
+
+        // kept nodes only move towards the front and their parents were already moved
+        new_index[i] = kept;
+        rev_indirection_[kept] = rev_indirection_[i];
+        parents_[kept] = parent == NO_PARENT ? NO_PARENT : new_index[parent];
+        locals_[kept] = local;
+        worlds_[kept] = worlds_[i];
+        dirty_[kept] = dirty;
+        world_changed_[kept] = world_changed_[i];
+        kept++;
+    }
+
+    for (i64 i = 0; i < ids.num; i++) {
+        _Release(ids[i]);
+    }
+
+    rev_indirection_.Resize(kept);
+    parents_.Resize(kept);
+    locals_.Resize(kept);
+    worlds_.Resize(kept);
+    dirty_.Resize(kept);
+    world_changed_.Resize(kept);
+    for (i32 i = 0; i < kept; i++) {
+        indirection_[rev_indirection_[i]] = i;
+    }
+
+    _RebuildLinks();
+}
+
+void TransformHierarchy::SetParent(TransformId id, TransformId parent)
+{
+    i32 flat_index = GetFlatIndex(id);
+
+    _Unlink(flat_index);
+    if (!parent) {
+        parents_[flat_index] = NO_PARENT;
+    } else {
+        i32 parent_flat_index = GetFlatIndex(parent);
+        plgr_assert(!_IsAncestor(flat_index, parent_flat_index));
+        parents_[flat_index] = parent_flat_index;
+        if (parent_flat_index > flat_index) {
+            order_dirty_ = true;
+        }
+    }
+    _Link(flat_index, parents_[flat_index]);
+
+    _MarkDirty(flat_index);
+}
+
+Optional<TransformId> TransformHierarchy::GetParent(TransformId id) const
+{
+    i32 parent = parents_[GetFlatIndex(id)];
+    if (parent == NO_PARENT) {
+        return NullOpt;
+    }
+    return GetIdFromFlatIndex(parent);
+}
+
+void TransformHierarchy::SetLocal(TransformId id, Transform const& local)
+{
+    i32 flat_index = GetFlatIndex(id);
+    locals_[flat_index] = local;
+    _MarkDirty(flat_index);
+}
+
+Transform const& TransformHierarchy::GetLocal(TransformId id) const
+{
+    return locals_[GetFlatIndex(id)];
+}
+
+Transform const& TransformHierarchy::GetWorld(TransformId id) const
+{
+    return worlds_[GetFlatIndex(id)];
+}
+
+i32 TransformHierarchy::GetFlatIndex(TransformId id) const
+{
+    plgr_assert(id.GetGeneration() == generation_[id.GetIndex()]);
+    return indirection_[id.GetIndex()];
+}
+
+TransformId TransformHierarchy::GetIdFromFlatIndex(i32 flat_index) const
+{
+    i32 index = rev_indirection_[flat_index];
+    return TransformId::Make(index, generation_[index]);
+}
+
+i64 TransformHierarchy::Size() const
+{
+    return parents_.Size();
+}
+
+void TransformHierarchy::Sort()
+{
+    i32 N = As<i32>(Size());
+
+    // children grouped by parent (counting sort keeps sibling order)
+    Array<i32> child_offsets;
+    child_offsets.Resize(N + 1);
+    for (i32 i = 0; i < N; i++) {
+        if (parents_[i] != NO_PARENT) {
+            child_offsets[parents_[i] + 1]++;
+        }
+    }
+    for (i32 i = 0; i < N; i++) {
+        child_offsets[i + 1] += child_offsets[i];
+    }
+
+    Array<i32> children;
+    children.ResizeUninitialised(child_offsets[N]);
+    Array<i32> cursor = child_offsets;
+    for (i32 i = 0; i < N; i++) {
+        if (parents_[i] != NO_PARENT) {
+            children[cursor[parents_[i]]++] = i;
+        }
+    }
+
+    // depth first from every root, old flat index per new position
+    Array<i32> order;
+    order.Reserve(N);
+    Array<i32> stack;
+    for (i32 root = 0; root < N; root++) {
+        if (parents_[root] != NO_PARENT) {
+            continue;
+        }
+
+        stack.PushBack(root);
+        while (stack.Size()) {
+            i32 node = stack.PopBack();
+            order.PushBack(node);
+            for (i32 c = child_offsets[node + 1] - 1; c >= child_offsets[node]; c--) {
+                stack.PushBack(children[c]);
+            }
+        }
+    }
+    plgr_assert(order.Size() == N);
+
+    Array<i32> new_index;
+    new_index.ResizeUninitialised(N);
+    for (i32 i = 0; i < N; i++) {
+        new_index[order[i]] = i;
+    }
+
+    auto permute = [&order, N](auto& array) {
+        auto permuted = array;
+        for (i32 i = 0; i < N; i++) {
+            permuted[i] = array[order[i]];
+        }
+        array = std::move(permuted);
+    };
+
+    permute(rev_indirection_);
+    permute(parents_);
+    permute(locals_);
+    permute(worlds_);
+    permute(dirty_);
+    permute(world_changed_);
+
+    for (i32 i = 0; i < N; i++) {
+        if (parents_[i] != NO_PARENT) {
+            parents_[i] = new_index[parents_[i]];
+        }
+        indirection_[rev_indirection_[i]] = i;
+    }
+    _RebuildLinks();
+
+    order_dirty_ = false;
+}
+
+void TransformHierarchy::Propagate()
+{
+    if (order_dirty_) {
+        Sort();
+    }
+
+    if (!any_dirty_) {
+        if (world_changed_.Size()) {
+            memset(world_changed_.Data(), 0, world_changed_.Size());
+        }
+        return;
+    }
+
+    for (i32 i = 0, N = As<i32>(Size()); i < N; i++) {
+        i32 parent = parents_[i];
+        plgr_assert(parent < i);
+
+        bool changed = dirty_[i] || (parent != NO_PARENT && world_changed_[parent]);
+        world_changed_[i] = changed;
+        dirty_[i] = 0;
+
+        if (changed) {
+            worlds_[i] = parent == NO_PARENT ? locals_[i] : worlds_[parent].Combine(locals_[i]);
+        }
+    }
+
+    any_dirty_ = false;
+}
+
+bool TransformHierarchy::_IsAncestor(i32 ancestor, i32 flat_index) const
+{
+    for (i32 node = flat_index; node != NO_PARENT; node = parents_[node]) {
+        if (node == ancestor) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TransformHierarchy::_MarkDirty(i32 flat_index)
+{
+    dirty_[flat_index] = 1;
+    any_dirty_ = true;
+}
+
+void TransformHierarchy::_Link(i32 flat_index, i32 parent)
+{
+    prev_sibling_[flat_index] = -1;
+    next_sibling_[flat_index] = -1;
+    if (parent == NO_PARENT) {
+        return;
+    }
+
+    i32 next = first_child_[parent];
+    next_sibling_[flat_index] = next;
+    if (next != -1) {
+        prev_sibling_[next] = flat_index;
+    }
+    first_child_[parent] = flat_index;
+}
+
+void TransformHierarchy::_Unlink(i32 flat_index)
+{
+    i32 prev = prev_sibling_[flat_index];
+    i32 next = next_sibling_[flat_index];
+    if (prev != -1) {
+        next_sibling_[prev] = next;
+    } else if (parents_[flat_index] != NO_PARENT) {
+        first_child_[parents_[flat_index]] = next;
+    }
+    if (next != -1) {
+        prev_sibling_[next] = prev;
+    }
+    prev_sibling_[flat_index] = -1;
+    next_sibling_[flat_index] = -1;
+}
+
+void TransformHierarchy::_RebuildLinks()
+{
+    i32 N = As<i32>(Size());
+    first_child_.ResizeUninitialised(N);
+    next_sibling_.ResizeUninitialised(N);
+    prev_sibling_.ResizeUninitialised(N);
+    for (i32 i = 0; i < N; i++) {
+        first_child_[i] = -1;
+    }
+    // back to front, so every list ends up in flat order
+    for (i32 i = N - 1; i >= 0; i--) {
+        _Link(i, parents_[i]);
+    }
+}
+
+void TransformHierarchy::_Release(TransformId id)
+{
+    indirection_[id.GetIndex()] = -1;
+    generation_[id.GetIndex()] = As<i8>((generation_[id.GetIndex()] + 1) % (TransformId::MAX_GENERATION + 1));
+    freelist_.Free(id.GetIndex());
+}
+
+}